@@ -0,0 +1,205 @@
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include "compositor.h"
+
+Compositor::Compositor( SDL_Renderer *ren, int width, int height ){
+	mRenderer = ren;
+	mWidth = width;
+	mHeight = height;
+	mBackground.r = mBackground.g = mBackground.b = 0;
+	mBackground.a = 255;
+	mStats.composed = mStats.skipped = 0;
+	mStats.pixels = 0;
+
+	mComposite = NULL;
+	if( SDL_RenderTargetSupported( ren ) )
+		mComposite = SDL_CreateTexture( ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width, height );
+	if( mComposite == nullptr )
+		std::cout << "Compositor: no target textures, redrawing whole frames" << std::endl;
+
+	invalidateAll();
+}
+
+Compositor::~Compositor(){
+	clear();
+}
+
+void Compositor::clear(){
+	for( unsigned int i = 0; i < mLayers.size(); i++ ){
+		if( mLayers[i].cache ) SDL_DestroyTexture( mLayers[i].cache );
+		mLayers[i].cache = NULL;
+	}
+	if( mComposite ) SDL_DestroyTexture( mComposite );
+	mComposite = NULL;
+}
+
+int Compositor::addLayer( const layer_draw_t &draw, bool cached ){
+	Layer layer;
+	SDL_Rect screen = { 0, 0, mWidth, mHeight };
+
+	layer.draw = draw;
+	layer.cached = false;
+	layer.cache = NULL;
+
+	// caching needs somewhere to composite to as well
+	if( cached && mComposite ){
+		layer.cache = SDL_CreateTexture( mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, mWidth, mHeight );
+		if( layer.cache ){
+			SDL_SetTextureBlendMode( layer.cache, SDL_BLENDMODE_BLEND );
+			layer.cached = true;
+			layer.stale.push_back( screen );
+		}
+		else std::cout << "Compositor: layer cache failed, drawing it directly: " << SDL_GetError() << std::endl;
+	}
+
+	mLayers.push_back( layer );
+	invalidate( screen );
+	return mLayers.size() - 1;
+}
+
+void Compositor::setBackground( SDL_Color color ){
+	SDL_Rect screen = { 0, 0, mWidth, mHeight };
+	mBackground = color;
+	invalidate( screen );
+}
+
+bool Compositor::clipToScreen( SDL_Rect *rect ) const {
+	SDL_Rect screen = { 0, 0, mWidth, mHeight };
+	return SDL_IntersectRect( rect, &screen, rect ) == SDL_TRUE;
+}
+
+void Compositor::invalidate( const SDL_Rect &rect ){
+	SDL_Rect r = rect;
+	if( clipToScreen( &r ) ) mDirty.push_back( r );
+}
+
+void Compositor::invalidateLayer( int layer, const SDL_Rect &rect ){
+	SDL_Rect r = rect;
+	if( layer < 0 || layer >= (int)mLayers.size() || !clipToScreen( &r ) ) return;
+	if( mLayers[layer].cached ) mLayers[layer].stale.push_back( r );
+	mDirty.push_back( r );
+}
+
+void Compositor::invalidateAll(){
+	SDL_Rect screen = { 0, 0, mWidth, mHeight };
+	for( unsigned int i = 0; i < mLayers.size(); i++ ){
+		if( !mLayers[i].cached ) continue;
+		mLayers[i].stale.clear();
+		mLayers[i].stale.push_back( screen );
+	}
+	mDirty.clear();
+	mDirty.push_back( screen );
+}
+
+bool Compositor::dirty() const {
+	if( !mDirty.empty() ) return true;
+	for( unsigned int i = 0; i < mLayers.size(); i++ )
+		if( !mLayers[i].stale.empty() ) return true;
+	return false;
+}
+
+/**
+-=-=-=-=-=- mergeRects -=-=-=-=-=-
+Join rects whose union costs no more than drawing both, moving sprites leave two
+overlapping ones every frame
+**/
+void Compositor::mergeRects( std::vector<SDL_Rect> &rects ) const {
+	unsigned int i, j;
+	bool merged = true;
+
+	while( merged ){
+		merged = false;
+		for( i = 0; i < rects.size() && !merged; i++ ){
+			for( j = i + 1; j < rects.size() && !merged; j++ ){
+				SDL_Rect u;
+				SDL_UnionRect( &rects[i], &rects[j], &u );
+				if( (long)u.w * u.h <= (long)rects[i].w * rects[i].h + (long)rects[j].w * rects[j].h ){
+					rects[i] = u;
+					rects.erase( rects.begin() + j );
+					merged = true;
+				}
+			}
+		}
+	}
+
+	if( rects.size() > COMPOSITOR_MAX_RECTS ){
+		for( i = 1; i < rects.size(); i++ )
+			SDL_UnionRect( &rects[0], &rects[i], &rects[0] );
+		rects.resize( 1 );
+	}
+}
+
+void Compositor::fillRect( const SDL_Rect &rect, SDL_Color color ){
+	SDL_SetRenderDrawBlendMode( mRenderer, SDL_BLENDMODE_NONE );
+	SDL_SetRenderDrawColor( mRenderer, color.r, color.g, color.b, color.a );
+	SDL_RenderFillRect( mRenderer, &rect );
+}
+
+/**
+-=-=-=-=-=-=- compose -=-=-=-=-=-=-
+Stale cache areas first, then every dirty area of the composite from the layers bottom up
+**/
+bool Compositor::compose(){
+	unsigned int i, l;
+	SDL_Color transparent = { 0, 0, 0, 0 };
+
+	if( !dirty() ){
+		mStats.skipped++;
+		return false;
+	}
+
+	if( mComposite == NULL ){
+		SDL_Rect screen = { 0, 0, mWidth, mHeight };
+		SDL_RenderSetClipRect( mRenderer, NULL );
+		fillRect( screen, mBackground );
+		for( l = 0; l < mLayers.size(); l++ )
+			mLayers[l].draw( mRenderer );
+		SDL_RenderPresent( mRenderer );
+
+		mDirty.clear();
+		mStats.composed++;
+		mStats.pixels += (unsigned long)mWidth * mHeight;
+		return true;
+	}
+
+	for( l = 0; l < mLayers.size(); l++ ){
+		Layer &layer = mLayers[l];
+		if( layer.stale.empty() ) continue;
+
+		mergeRects( layer.stale );
+		SDL_SetRenderTarget( mRenderer, layer.cache );
+		for( i = 0; i < layer.stale.size(); i++ ){
+			SDL_RenderSetClipRect( mRenderer, &layer.stale[i] );
+			fillRect( layer.stale[i], transparent );
+			layer.draw( mRenderer );
+		}
+		layer.stale.clear();
+	}
+
+	mergeRects( mDirty );
+	SDL_SetRenderTarget( mRenderer, mComposite );
+	for( i = 0; i < mDirty.size(); i++ ){
+		const SDL_Rect &rect = mDirty[i];
+		SDL_RenderSetClipRect( mRenderer, &rect );
+		fillRect( rect, mBackground );
+		for( l = 0; l < mLayers.size(); l++ ){
+			if( mLayers[l].cached ) SDL_RenderCopy( mRenderer, mLayers[l].cache, &rect, &rect );
+			else mLayers[l].draw( mRenderer );
+		}
+		mStats.pixels += (unsigned long)rect.w * rect.h;
+	}
+	SDL_RenderSetClipRect( mRenderer, NULL );
+	SDL_SetRenderTarget( mRenderer, NULL );
+
+	SDL_RenderCopy( mRenderer, mComposite, NULL, NULL );
+	SDL_RenderPresent( mRenderer );
+
+	mDirty.clear();
+	mStats.composed++;
+	return true;
+}
+
+compositor_stats_t Compositor::stats() const {
+	return mStats;
+}
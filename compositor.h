@@ -0,0 +1,79 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <vector>
+#include <functional>
+#include "SDL2\SDL.h"
+
+/**
+-=-=-=-=-=- Compositor -=-=-=-=-=-
+Retained drawing for mostly static screens. The screen is a stack of layers, each with a
+draw function that renders the whole layer - the compositor sets a clip rect so only the
+part being refreshed actually costs anything.
+
+Cached layers are rendered into their own target texture and only drawn again where
+invalidateLayer() says their content changed. Uncached layers are drawn straight into the
+composite, for things that change every time they're shown anyway.
+
+compose() redraws just the screen areas invalidated since the last call into a composite
+texture, then shows it. With nothing invalidated it returns false without touching the
+renderer, so an idle loop can block on SDL_WaitEvent and use no CPU or GPU at all.
+The composite has to be copied to the window whole, SDL_RenderPresent can't present part
+of the window.
+
+Needs a renderer made with SDL_RENDERER_TARGETTEXTURE. Without target texture support
+every changed frame draws all layers straight to the window instead.
+**/
+
+const unsigned int COMPOSITOR_MAX_RECTS = 16;	// past this the dirty areas become one
+
+typedef std::function<void( SDL_Renderer *ren )> layer_draw_t;
+
+typedef struct {
+	unsigned int composed;		// frames drawn and presented
+	unsigned int skipped;		// compose() calls with nothing to do
+	unsigned long pixels;		// screen pixels recomposed, over all frames
+} compositor_stats_t;
+
+class Compositor {
+public:
+	Compositor( SDL_Renderer *ren, int width, int height );
+	~Compositor();
+	Compositor( const Compositor & ) = delete;		// owns the composite and layer textures
+	Compositor &operator=( const Compositor & ) = delete;
+
+	int addLayer( const layer_draw_t &draw, bool cached );	// on top of the others, returns its id
+
+	void invalidate( const SDL_Rect &rect );				// recompose this area from the layers
+	void invalidateLayer( int layer, const SDL_Rect &rect );	// the layer's content changed here
+	void invalidateAll();									// every layer, e.g. after SDL_RENDER_TARGETS_RESET
+
+	bool dirty() const;
+	bool compose();
+
+	void setBackground( SDL_Color color );
+	void clear();							// frees the textures, before their renderer goes
+	compositor_stats_t stats() const;
+
+private:
+	struct Layer {
+		layer_draw_t draw;
+		bool cached;
+		SDL_Texture *cache;
+		std::vector<SDL_Rect> stale;		// areas of the cache to draw again
+	};
+
+	bool clipToScreen( SDL_Rect *rect ) const;
+	void mergeRects( std::vector<SDL_Rect> &rects ) const;
+	void fillRect( const SDL_Rect &rect, SDL_Color color );
+
+	SDL_Renderer *mRenderer;
+	SDL_Texture *mComposite;				// NULL without target texture support
+	std::vector<Layer> mLayers;
+	std::vector<SDL_Rect> mDirty;
+	SDL_Color mBackground;
+	int mWidth, mHeight;
+	compositor_stats_t mStats;
+};
+
+#endif
@@ -0,0 +1,100 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "convolution.h"
+#include <math.h>
+#include <stdlib.h>
+
+///////////////////////////////
+////// CONVOLUTION.CPP ////////
+///////////////////////////////
+
+/**
+-=-=-=-=-=- makeConvKernel -=-=-=-=-=-
+Rank 1 test: take the column and the row through the largest weight, their outer product
+divided by that weight has to give back every other weight. The pivot's square root goes
+to each side so neither factor ends up tiny.
+**/
+bool makeConvKernel( const float *weights, unsigned int size, conv_kernel_t *kernel, float tolerance ){
+	if( size % 2 == 0 || size > CONV_MAX_SIZE ){
+		printf( "ERROR: Convolution kernels must be odd and at most %ux%u, got %ux%u!\n", CONV_MAX_SIZE, CONV_MAX_SIZE, size, size );
+		return false;
+	}
+
+	unsigned int i, j, pivotRow = 0, pivotColumn = 0;
+	float largest = 0.0f;
+
+	kernel->size = size;
+	for( i = 0; i < size * size; i++ ){
+		kernel->weights[i] = weights[i];
+		if( fabsf( weights[i] ) > largest ){
+			largest = fabsf( weights[i] );
+			pivotRow = i / size;
+			pivotColumn = i % size;
+		}
+	}
+
+	kernel->separable = largest > 0.0f;
+	if( !kernel->separable ) return true;
+
+	float pivot = weights[pivotRow * size + pivotColumn];
+	float root = sqrtf( largest );
+	for( i = 0; i < size; i++ ){
+		kernel->column[i] = weights[i * size + pivotColumn] / root;
+		kernel->row[i] = weights[pivotRow * size + i] * root / pivot;
+	}
+
+	for( i = 0; i < size && kernel->separable; i++ )
+		for( j = 0; j < size && kernel->separable; j++ )
+			if( fabsf( kernel->column[i] * kernel->row[j] - weights[i * size + j] ) > tolerance * largest )
+				kernel->separable = false;
+	return true;
+}
+
+bool makeConvKernelSymmetric( const float *halfWeights, unsigned int size, conv_kernel_t *kernel ){
+	float line[CONV_MAX_SIZE], weights[CONV_MAX_SIZE * CONV_MAX_SIZE];
+	int radius = size / 2;
+
+	if( size % 2 == 0 || size > CONV_MAX_SIZE ){
+		printf( "ERROR: Convolution kernels must be odd and at most %ux%u, got %ux%u!\n", CONV_MAX_SIZE, CONV_MAX_SIZE, size, size );
+		return false;
+	}
+	for( int i = 0; i < (int)size; i++ )
+		line[i] = halfWeights[abs( i - radius )];
+	for( unsigned int y = 0; y < size; y++ )
+		for( unsigned int x = 0; x < size; x++ )
+			weights[y * size + x] = line[y] * line[x];
+	return makeConvKernel( weights, size, kernel );
+}
+
+unsigned int convTaps( const conv_kernel_t &kernel ){
+	return kernel.separable ? 2 * kernel.size : kernel.size * kernel.size;
+}
+
+void printConvKernel( const char *name, const conv_kernel_t &kernel ){
+	if( kernel.separable )
+		printf( "SUCCESS: %s kernel %ux%u is separable, %u taps instead of %u...\n", name, kernel.size, kernel.size,
+				convTaps( kernel ), kernel.size * kernel.size );
+	else
+		printf( "SUCCESS: %s kernel %ux%u runs in one pass, %u taps...\n", name, kernel.size, kernel.size, convTaps( kernel ) );
+}
+
+// Texture v goes up the screen while kernels are written top row first, so vertical taps step down
+void setConvUniforms( GLuint program, const conv_kernel_t &kernel, conv_pass_t pass ){
+	glUniform1i( glGetUniformLocation( program, "size" ), kernel.size );
+	switch( pass ){
+		case CONV_PASS_HORIZONTAL:
+			glUniform2f( glGetUniformLocation( program, "direction" ), 1.0f, 0.0f );
+			glUniform1fv( glGetUniformLocation( program, "weights" ), kernel.size, kernel.row );
+			break;
+		case CONV_PASS_VERTICAL:
+			glUniform2f( glGetUniformLocation( program, "direction" ), 0.0f, -1.0f );
+			glUniform1fv( glGetUniformLocation( program, "weights" ), kernel.size, kernel.column );
+			break;
+		default:
+			glUniform2f( glGetUniformLocation( program, "direction" ), 0.0f, 0.0f );
+			glUniform1fv( glGetUniformLocation( program, "weights" ), kernel.size * kernel.size, kernel.weights );
+			break;
+	}
+}
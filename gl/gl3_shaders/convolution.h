@@ -0,0 +1,43 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+/////// CONVOLUTION HEADER ////////
+///////////////////////////////////
+
+// Square kernels for fconvolve.txt, which steps by whole texels of the texture it reads.
+// makeConvKernel() checks whether the kernel is an outer product of a column and a row
+// (rank 1). Those run as a horizontal pass with the row and a vertical pass with the
+// column, 2N taps per pixel instead of N*N - a 9x9 Gaussian costs 18 instead of 81.
+// Anything else runs as one pass over the whole kernel.
+
+const unsigned int CONV_MAX_SIZE = 9;		// must match MAX_SIZE in fconvolve.txt
+
+typedef enum {
+	CONV_PASS_FULL,				// every weight in one pass
+	CONV_PASS_HORIZONTAL,		// the row, separable kernels only
+	CONV_PASS_VERTICAL			// the column, separable kernels only
+} conv_pass_t;
+
+typedef struct {
+	unsigned int size;								// odd, up to CONV_MAX_SIZE
+	float weights[CONV_MAX_SIZE * CONV_MAX_SIZE];	// top-left to bottom-right
+	bool separable;
+	float row[CONV_MAX_SIZE];						// left to right
+	float column[CONV_MAX_SIZE];					// top to bottom, weights = column x row
+} conv_kernel_t;
+
+// false for even or oversized kernels. 'tolerance' is relative to the largest weight.
+bool makeConvKernel( const float *weights, unsigned int size, conv_kernel_t *kernel, float tolerance=1e-5f );
+// size x size from half of a symmetric 1D kernel, centre weight first like fblur used to have
+bool makeConvKernelSymmetric( const float *halfWeights, unsigned int size, conv_kernel_t *kernel );
+
+unsigned int convTaps( const conv_kernel_t &kernel );	// texture reads per pixel, all passes
+void printConvKernel( const char *name, const conv_kernel_t &kernel );
+
+// sets the uniforms of a program made from fconvolve.txt, which must be in use
+void setConvUniforms( GLuint program, const conv_kernel_t &kernel, conv_pass_t pass );
+
+#endif
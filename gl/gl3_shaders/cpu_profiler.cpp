@@ -0,0 +1,217 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "cpu_profiler.h"
+
+#ifdef CPU_PROFILER_ENABLED
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+//////////////////////////////////
+/////// CPU_PROFILER.CPP /////////
+//////////////////////////////////
+
+typedef struct {
+	const char *name;
+	Uint64 start;
+	Uint64 end;
+} cpu_event_t;
+
+typedef struct {
+	const char *name;				// guarded by the profiler lock, like alive
+	unsigned int id;
+	cpu_event_t events[CPU_PROFILER_EVENTS];
+	SDL_atomic_t written;			// total events, published after each event is filled in
+	std::vector<Uint64> open;		// starts of the zones this thread is inside, owner only
+	bool alive;						// false once the thread gave it back, the next new thread takes it
+} cpu_thread_t;
+
+typedef struct {
+	std::vector<cpu_thread_t*> threads;	// as many as ever ran at once, guarded by lock
+	SDL_mutex *lock;
+	SDL_SpinLock spin;					// creates lock
+	Uint64 origin;
+	Uint64 lastFrame;					// frame thread only
+	unsigned int histogram[CPU_PROFILER_BUCKETS];	// guarded by lock
+	unsigned int frames;
+} cpu_profiler_t;
+
+cpu_profiler_t gCpuProfiler;
+thread_local cpu_thread_t *tThread = NULL;
+
+void profilerInit(){
+	SDL_AtomicLock( &gCpuProfiler.spin );
+	if( !gCpuProfiler.lock ){
+		gCpuProfiler.lock = SDL_CreateMutex();
+		gCpuProfiler.origin = SDL_GetPerformanceCounter();
+	}
+	SDL_AtomicUnlock( &gCpuProfiler.spin );
+}
+
+/**
+-=-=-=-=-=- profilerThread -=-=-=-=-=-
+First zone or name on a thread takes a buffer, the one time the profiler locks for a thread.
+Buffers of finished threads come back, one of the same name first so a restarted encoder
+or worker carries on under its old id in the trace, its earlier events still in the ring.
+**/
+cpu_thread_t *profilerThread( const char *name ){
+	if( tThread ) return tThread;
+	profilerInit();
+	
+	SDL_LockMutex( gCpuProfiler.lock );
+	cpu_thread_t *thread = NULL;
+	for( unsigned int i = 0; i < gCpuProfiler.threads.size(); i++ ){
+		cpu_thread_t *candidate = gCpuProfiler.threads[i];
+		if( candidate->alive ) continue;
+		if( !thread ) thread = candidate;
+		if( strcmp( candidate->name, name ) == 0 ){
+			thread = candidate;
+			break;
+		}
+	}
+	if( !thread ){
+		thread = new cpu_thread_t;
+		thread->id = gCpuProfiler.threads.size() + 1;
+		SDL_AtomicSet( &thread->written, 0 );
+		gCpuProfiler.threads.push_back( thread );
+	}
+	thread->name = name;
+	thread->alive = true;
+	thread->open.clear();
+	SDL_UnlockMutex( gCpuProfiler.lock );
+	
+	tThread = thread;
+	return thread;
+}
+
+void cpuProfilerThread( const char *name ){
+	if( !tThread ){
+		profilerThread( name );
+		return;
+	}
+	SDL_LockMutex( gCpuProfiler.lock );
+	tThread->name = name;
+	SDL_UnlockMutex( gCpuProfiler.lock );
+}
+
+void cpuProfilerThreadEnd(){
+	if( !tThread ) return;
+	SDL_LockMutex( gCpuProfiler.lock );
+	tThread->alive = false;
+	SDL_UnlockMutex( gCpuProfiler.lock );
+	tThread = NULL;
+}
+
+void cpuZoneBegin(){
+	cpu_thread_t *thread = profilerThread( "thread" );
+	thread->open.push_back( SDL_GetPerformanceCounter() );
+}
+
+void cpuZoneEnd( const char *name ){
+	cpu_thread_t *thread = tThread;
+	if( !thread || thread->open.empty() ) return;
+	
+	int written = SDL_AtomicGet( &thread->written );
+	cpu_event_t &event = thread->events[written % CPU_PROFILER_EVENTS];
+	event.name = name;
+	event.start = thread->open.back();
+	event.end = SDL_GetPerformanceCounter();
+	thread->open.pop_back();
+	
+	SDL_AtomicSet( &thread->written, written + 1 );
+}
+
+void cpuProfilerFrame(){
+	Uint64 now = SDL_GetPerformanceCounter();
+	
+	if( gCpuProfiler.lastFrame ){
+		double ms = 1000.0 * ( now - gCpuProfiler.lastFrame ) / SDL_GetPerformanceFrequency();
+		unsigned int bucket = (unsigned int)ms;
+		if( bucket >= CPU_PROFILER_BUCKETS ) bucket = CPU_PROFILER_BUCKETS - 1;
+		
+		profilerInit();
+		SDL_LockMutex( gCpuProfiler.lock );
+		gCpuProfiler.histogram[bucket]++;
+		gCpuProfiler.frames++;
+		SDL_UnlockMutex( gCpuProfiler.lock );
+	}
+	gCpuProfiler.lastFrame = now;
+}
+
+// the frame thread keeps counting, print a copy
+void cpuProfilerPrintHistogram(){
+	unsigned int histogram[CPU_PROFILER_BUCKETS];
+	unsigned int frames, most = 1;
+	
+	profilerInit();
+	SDL_LockMutex( gCpuProfiler.lock );
+	memcpy( histogram, gCpuProfiler.histogram, sizeof( histogram ) );
+	frames = gCpuProfiler.frames;
+	SDL_UnlockMutex( gCpuProfiler.lock );
+	
+	for( unsigned int i = 0; i < CPU_PROFILER_BUCKETS; i++ )
+		if( histogram[i] > most ) most = histogram[i];
+	
+	printf( "CPU PROFILE: frame times over %u frames\n", frames );
+	for( unsigned int i = 0; i < CPU_PROFILER_BUCKETS; i++ ){
+		if( !histogram[i] ) continue;
+		std::string bar( 1 + 40 * histogram[i] / most, '#' );
+		printf( "  %2u%s ms %7u %s\n", i, i == CPU_PROFILER_BUCKETS - 1 ? "+" : " ", histogram[i], bar.c_str() );
+	}
+}
+
+bool cpuProfilerExportTrace( const char *path ){
+	FILE *file = fopen( path, "w" );
+	if( !file ){
+		printf( "ERROR: Could not open %s for the CPU trace!\n", path );
+		return false;
+	}
+	
+	double toMicro = 1000000.0 / SDL_GetPerformanceFrequency();
+	unsigned int count = 0;
+	bool first = true;
+	
+	// buffers are never freed, only the names need copying while the lock is held
+	std::vector<cpu_thread_t*> threads;
+	std::vector<const char*> names;
+	if( gCpuProfiler.lock ){
+		SDL_LockMutex( gCpuProfiler.lock );
+		threads = gCpuProfiler.threads;
+		for( unsigned int t = 0; t < threads.size(); t++ )
+			names.push_back( threads[t]->name );
+		SDL_UnlockMutex( gCpuProfiler.lock );
+	}
+	
+	fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+	for( unsigned int t = 0; t < threads.size(); t++ ){
+		cpu_thread_t *thread = threads[t];
+		
+		fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				 first ? "" : ",\n", thread->id, names[t] );
+		first = false;
+		
+		// the owner keeps writing while we read, stay clear of the slots it's about to reuse
+		int written = SDL_AtomicGet( &thread->written );
+		int oldest = written - (int)( CPU_PROFILER_EVENTS - CPU_PROFILER_EVENTS / 8 );
+		if( oldest < 0 ) oldest = 0;
+		
+		for( int i = oldest; i < written; i++ ){
+			const cpu_event_t &event = thread->events[i % CPU_PROFILER_EVENTS];
+			fprintf( file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					 event.name, thread->id,
+					 ( event.start - gCpuProfiler.origin ) * toMicro, ( event.end - event.start ) * toMicro );
+			count++;
+		}
+	}
+	fprintf( file, "\n]}\n" );
+	fclose( file );
+	
+	printf( "SUCCESS: Wrote %u CPU zones from %u threads to %s...\n", count, (unsigned int)threads.size(), path );
+	return true;
+}
+
+#endif
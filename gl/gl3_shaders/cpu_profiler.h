@@ -0,0 +1,60 @@
+#ifndef CPU_PROFILER_H
+#define CPU_PROFILER_H
+
+#include <SDL2/SDL.h>
+
+///////////////////////////////////
+////// CPU_PROFILER HEADER ////////
+///////////////////////////////////
+
+// Scoped CPU timing zones on SDL's performance counter. Every thread records into its own
+// ring of events with no locking; the rings are read when a Chrome trace is exported
+// (open the file in chrome://tracing or ui.perfetto.dev). Zone names must be string literals.
+// A thread that ends hands its ring back with CPU_PROFILER_THREAD_END(), the next thread
+// to start reuses it, so threads that come and go don't pile up rings.
+//
+// Use the macros only - without CPU_PROFILER defined they expand to nothing and none of this
+// is compiled in. The project defines it in its compiler options, drop it there for a release build.
+
+#ifdef CPU_PROFILER
+#define CPU_PROFILER_ENABLED
+
+const unsigned int CPU_PROFILER_EVENTS = 65536;		// per thread ring
+const unsigned int CPU_PROFILER_BUCKETS = 50;		// 1 ms frame time buckets, the last one catches the rest
+
+void cpuProfilerThread( const char *name );			// names the calling thread in the trace
+void cpuProfilerThreadEnd();						// last call on a thread that's about to exit
+void cpuProfilerFrame();							// marks the end of a frame for the histogram
+void cpuProfilerPrintHistogram();
+bool cpuProfilerExportTrace( const char *path );
+
+void cpuZoneBegin();
+void cpuZoneEnd( const char *name );
+
+class CpuZone {
+public:
+	CpuZone( const char *name ) : mName( name ) { cpuZoneBegin(); }
+	~CpuZone() { cpuZoneEnd( mName ); }
+private:
+	const char *mName;
+};
+
+#define CPU_ZONE_JOIN2( a, b ) a##b
+#define CPU_ZONE_JOIN( a, b ) CPU_ZONE_JOIN2( a, b )
+#define CPU_ZONE( name ) CpuZone CPU_ZONE_JOIN( cpuZone, __LINE__ )( name )
+#define CPU_PROFILER_THREAD( name ) cpuProfilerThread( name )
+#define CPU_PROFILER_THREAD_END() cpuProfilerThreadEnd()
+#define CPU_PROFILER_FRAME() cpuProfilerFrame()
+#define CPU_PROFILER_EXPORT( path ) ( cpuProfilerExportTrace( path ), cpuProfilerPrintHistogram() )
+
+#else
+
+#define CPU_ZONE( name ) ((void)0)
+#define CPU_PROFILER_THREAD( name ) ((void)0)
+#define CPU_PROFILER_THREAD_END() ((void)0)
+#define CPU_PROFILER_FRAME() ((void)0)
+#define CPU_PROFILER_EXPORT( path ) ((void)0)
+
+#endif
+
+#endif
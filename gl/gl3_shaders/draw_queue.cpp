@@ -0,0 +1,305 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "draw_queue.h"
+#include "gl_state.h"
+#include <algorithm>
+#include <string.h>
+#include <assert.h>
+
+////////////////////////////////
+/////// DRAW_QUEUE.CPP /////////
+////////////////////////////////
+
+const unsigned int KEY_DEPTH_MAX = 0xFFFFFF;
+
+uint64_t makeSortKey( unsigned int pass, bool transparent, unsigned int programId, unsigned int materialId, float depth ){
+	assert( programId < KEY_PROGRAM_IDS && materialId < KEY_MATERIAL_IDS );
+	if( depth < 0.0f ) depth = 0.0f;
+	if( depth > 1.0f ) depth = 1.0f;
+	uint64_t d = (uint64_t)( depth * KEY_DEPTH_MAX );
+	uint64_t key = (uint64_t)( pass & 0xF ) << 60;
+	
+	if( transparent ){
+		key |= (uint64_t)1 << 59;
+		key |= ( KEY_DEPTH_MAX - d ) << 35;			// farthest first
+		key |= (uint64_t)( programId & 0xFF ) << 27;
+		key |= (uint64_t)( materialId & 0xFFFF ) << 11;
+	}
+	else {
+		key |= (uint64_t)( programId & 0xFF ) << 51;
+		key |= (uint64_t)( materialId & 0xFFFF ) << 35;
+		key |= d << 11;								// nearest first
+	}
+	return key;
+}
+
+unsigned int sortKeyPass( uint64_t key ){
+	return (unsigned int)( key >> 60 );
+}
+
+bool sortKeyTransparent( uint64_t key ){
+	return ( key >> 59 ) & 1;
+}
+
+draw_command_t makeDrawCommand( unsigned int pass, GLuint program, GLuint vao, GLuint texture, GLsizei indexCount,
+								const glm::mat4 &model, bool transparent, float depth ){
+	draw_command_t cmd;
+	cmd.key = 0;
+	cmd.program = program;
+	cmd.vao = vao;
+	cmd.texture = texture;
+	cmd.indexCount = indexCount;
+	cmd.model = model;
+	cmd.normal = glm::transpose( glm::inverse( glm::mat3( model ) ) );
+	cmd.fullbright = false;
+	cmd.cullFace = true;
+	cmd.pass = pass;
+	cmd.transparent = transparent;
+	cmd.depth = depth;
+	return cmd;
+}
+
+frustum_t makeFrustum( const glm::mat4 &viewProj ){
+	frustum_t frustum;
+	glm::vec4 rows[4];
+	
+	for( int i = 0; i < 4; i++ )
+		rows[i] = glm::vec4( viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i] );
+	
+	// left, right, bottom, top, near, far
+	for( int i = 0; i < 3; i++ ){
+		frustum.planes[i * 2]     = rows[3] + rows[i];
+		frustum.planes[i * 2 + 1] = rows[3] - rows[i];
+	}
+	
+	for( int i = 0; i < 6; i++ )
+		frustum.planes[i] /= glm::length( glm::vec3( frustum.planes[i] ) );
+	return frustum;
+}
+
+bool sphereInFrustum( const frustum_t &frustum, const glm::vec3 &center, float radius ){
+	for( int i = 0; i < 6; i++ ){
+		const glm::vec4 &p = frustum.planes[i];
+		if( p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius ) return false;
+	}
+	return true;
+}
+
+void radixSortKeys( uint64_t *keys, uint32_t *values, uint64_t *tmpKeys, uint32_t *tmpValues, size_t count ){
+	size_t histograms[8][256];
+	size_t i;
+	unsigned int b;
+	
+	if( count < 2 ) return;
+	
+	// one read of the keys builds the histogram of every digit
+	memset( histograms, 0, sizeof( histograms ) );
+	for( i = 0; i < count; i++ ){
+		uint64_t k = keys[i];
+		for( b = 0; b < 8; b++ )
+			histograms[b][( k >> ( b * 8 ) ) & 0xFF]++;
+	}
+	
+	uint64_t *srcKeys = keys, *dstKeys = tmpKeys;
+	uint32_t *srcValues = values, *dstValues = tmpValues;
+	
+	for( b = 0; b < 8; b++ ){
+		unsigned int shift = b * 8;
+		size_t *hist = histograms[b];
+		
+		// every key has the same digit here (unused key bits, single pass...), nothing to do
+		if( hist[( srcKeys[0] >> shift ) & 0xFF] == count ) continue;
+		
+		// exclusive prefix sum gives each bucket's first slot
+		size_t offset = 0;
+		for( i = 0; i < 256; i++ ){
+			size_t n = hist[i];
+			hist[i] = offset;
+			offset += n;
+		}
+		
+		// stable scatter
+		for( i = 0; i < count; i++ ){
+			size_t slot = hist[( srcKeys[i] >> shift ) & 0xFF]++;
+			dstKeys[slot] = srcKeys[i];
+			dstValues[slot] = srcValues[i];
+		}
+		
+		std::swap( srcKeys, dstKeys );
+		std::swap( srcValues, dstValues );
+	}
+	
+	if( srcKeys != keys ){
+		memcpy( keys, srcKeys, count * sizeof( uint64_t ) );
+		memcpy( values, srcValues, count * sizeof( uint32_t ) );
+	}
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- DrawQueue -=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// a frame uses a handful of programs and textures, a linear search beats a map here
+static unsigned int denseId( std::vector<GLuint> &names, GLuint name ){
+	for( unsigned int i = 0; i < names.size(); i++ )
+		if( names[i] == name ) return i;
+	names.push_back( name );
+	return names.size() - 1;
+}
+
+DrawQueue::DrawQueue(){
+	mSorted = true;
+}
+
+void DrawQueue::clear(){
+	mCommands.clear();
+	mProgramIds.clear();
+	mMaterialIds.clear();
+	mSorted = true;
+}
+
+uint64_t DrawQueue::keyFor( const draw_command_t &cmd ){
+	return makeSortKey( cmd.pass, cmd.transparent, denseId( mProgramIds, cmd.program ), denseId( mMaterialIds, cmd.texture ), cmd.depth );
+}
+
+uint64_t DrawQueue::submit( const draw_command_t &cmd ){
+	mCommands.push_back( cmd );
+	mCommands.back().key = keyFor( cmd );
+	mSorted = false;
+	return mCommands.back().key;
+}
+
+// the other queue's ids are its own, so its commands get keys from this queue's
+void DrawQueue::append( const DrawQueue &other ){
+	if( other.mCommands.empty() ) return;
+	size_t first = mCommands.size();
+	mCommands.insert( mCommands.end(), other.mCommands.begin(), other.mCommands.end() );
+	for( size_t i = first; i < mCommands.size(); i++ )
+		mCommands[i].key = keyFor( mCommands[i] );
+	mSorted = false;
+}
+
+unsigned int DrawQueue::size() const {
+	return mCommands.size();
+}
+
+void DrawQueue::sort(){
+	size_t count = mCommands.size();
+	
+	mKeys.resize( count );
+	mOrder.resize( count );
+	mTmpKeys.resize( count );
+	mTmpOrder.resize( count );
+	
+	for( size_t i = 0; i < count; i++ ){
+		mKeys[i] = mCommands[i].key;
+		mOrder[i] = (uint32_t)i;
+	}
+	
+	if( count > 0 )
+		radixSortKeys( &mKeys[0], &mOrder[0], &mTmpKeys[0], &mTmpOrder[0], count );
+	mSorted = true;
+}
+
+void DrawQueue::execute( unsigned int pass, draw_subset_t subset, GLuint programOverride ){
+	if( !mSorted ) sort();
+	
+	// keys are sorted by pass first, then opaque before transparent, so the subset is one contiguous run
+	uint64_t first = (uint64_t)pass << 60;
+	if( subset == DRAW_TRANSPARENT ) first |= (uint64_t)1 << 59;
+	size_t i = std::lower_bound( mKeys.begin(), mKeys.end(), first ) - mKeys.begin();
+	
+	GLuint program = 0;
+	GLint modelLocation = -1, normalLocation = -1, fullbrightLocation = -1;
+	int fullbright = -1;
+	
+	for( ; i < mKeys.size() && sortKeyPass( mKeys[i] ) == pass; i++ ){
+		if( subset == DRAW_OPAQUE && sortKeyTransparent( mKeys[i] ) ) break;
+		const draw_command_t &cmd = mCommands[mOrder[i]];
+		GLuint cmdProgram = programOverride ? programOverride : cmd.program;
+		
+		if( cmdProgram != program ){
+			program = cmdProgram;
+			stateUseProgram( program );
+			modelLocation = glGetUniformLocation( program, "model" );
+			normalLocation = glGetUniformLocation( program, "normal_matrix" );
+			fullbrightLocation = glGetUniformLocation( program, "fullbright" );
+			fullbright = -1;
+		}
+		
+		glUniformMatrix4fv( modelLocation, 1, GL_FALSE, glm::value_ptr( cmd.model ) );
+		if( normalLocation >= 0 )
+			glUniformMatrix3fv( normalLocation, 1, GL_FALSE, glm::value_ptr( cmd.normal ) );
+		if( fullbrightLocation >= 0 && fullbright != (int)cmd.fullbright ){
+			fullbright = cmd.fullbright;
+			glUniform1i( fullbrightLocation, fullbright );
+		}
+		
+		if( cmd.cullFace ) stateEnable( GL_CULL_FACE );
+		else stateDisable( GL_CULL_FACE );
+		stateBindVertexArray( cmd.vao );
+		if( !programOverride ) stateBindTexture( 0, GL_TEXTURE_2D, cmd.texture );
+		glDrawElements( GL_TRIANGLES, cmd.indexCount, GL_UNSIGNED_INT, 0 );
+	}
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- Benchmark -=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void benchmarkDrawQueue( unsigned int commands, unsigned int frames ){
+	double freq = (double)SDL_GetPerformanceFrequency();
+	double submitTime = 0.0, radixTime = 0.0, stdTime = 0.0;
+	unsigned int seed = 12345;
+	bool ok = true;
+	
+	printf( "ATTEMPT: Draw queue benchmark, %u commands x %u frames...\n", commands, frames );
+	
+	DrawQueue queue;
+	std::vector<uint64_t> keys( commands ), tmpKeys( commands );
+	std::vector<uint32_t> values( commands ), tmpValues( commands );
+	std::vector< std::pair<uint64_t, uint32_t> > pairs( commands );
+	glm::mat4 model( 1.0f );
+	
+	for( unsigned int f = 0; f < frames; f++ ){
+		// record a frame of random draws, a fifth of them transparent
+		Uint64 start = SDL_GetPerformanceCounter();
+		queue.clear();
+		for( unsigned int i = 0; i < commands; i++ ){
+			seed = seed * 1103515245 + 12345;
+			unsigned int r = seed >> 8;
+			draw_command_t cmd = makeDrawCommand( r % DRAW_PASS_COUNT, 1 + r % 8, 1, 1 + ( r >> 4 ) % 64, 36,
+												  model, ( r >> 12 ) % 5 == 0, ( r & 0xFFFF ) / 65535.0f );
+			keys[i] = queue.submit( cmd );
+		}
+		submitTime += ( SDL_GetPerformanceCounter() - start ) / freq;
+		
+		start = SDL_GetPerformanceCounter();
+		queue.sort();
+		radixTime += ( SDL_GetPerformanceCounter() - start ) / freq;
+		
+		// comparison sort of the same key/index pairs
+		for( unsigned int i = 0; i < commands; i++ )
+			pairs[i] = std::make_pair( keys[i], i );
+		start = SDL_GetPerformanceCounter();
+		std::stable_sort( pairs.begin(), pairs.end() );
+		stdTime += ( SDL_GetPerformanceCounter() - start ) / freq;
+		
+		if( f == 0 ){
+			for( unsigned int i = 0; i < commands; i++ ){
+				values[i] = i;
+			}
+			radixSortKeys( &keys[0], &values[0], &tmpKeys[0], &tmpValues[0], commands );
+			for( unsigned int i = 0; i < commands; i++ )
+				if( keys[i] != pairs[i].first || values[i] != pairs[i].second ) ok = false;
+		}
+	}
+	
+	if( !ok ){
+		printf( "ERROR: Radix sort order differs from std::stable_sort!\n" );
+		return;
+	}
+	
+	printf( "SUCCESS: Draw queue benchmark - per frame: record %.3f ms, radix sort %.3f ms, std::stable_sort %.3f ms\n",
+			1000.0 * submitTime / frames, 1000.0 * radixTime / frames, 1000.0 * stdTime / frames );
+}
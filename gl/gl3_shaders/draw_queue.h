@@ -0,0 +1,95 @@
+#ifndef DRAW_QUEUE_H
+#define DRAW_QUEUE_H
+
+#include "gl_utils.h"
+#include <stdint.h>
+
+///////////////////////////////////
+/////// DRAW_QUEUE HEADER /////////
+///////////////////////////////////
+
+// Draws are recorded as commands with a 64-bit sort key, radix sorted, then submitted.
+//
+// key layout, most significant first:
+//   opaque:       pass:4 | 0 | program:8 | material:16 | depth:24         (front-to-back)
+//   transparent:  pass:4 | 1 | ~depth:24 | program:8  | material:16      (back-to-front)
+// the low 11 bits are unused.
+//
+// Program and material are not GL names but dense ids the queue hands out on submit(), in order
+// of first use, so at most 256 programs and 65536 materials per queue. Opaque draws are only
+// front-to-back within one program/material group; the groups themselves come in id order.
+
+typedef enum {
+	DRAW_PASS_SHADOW,
+	DRAW_PASS_SCENE,
+	DRAW_PASS_COUNT } draw_pass_t ;
+
+// which commands of a pass to submit, opaque ones sort before transparent ones
+typedef enum {
+	DRAW_ALL,
+	DRAW_OPAQUE,
+	DRAW_TRANSPARENT } draw_subset_t ;
+
+typedef struct {
+	uint64_t key;			// set by DrawQueue::submit()
+	GLuint program;
+	GLuint vao;
+	GLuint texture;
+	GLsizei indexCount;
+	glm::mat4 model;
+	glm::mat3 normal;
+	bool fullbright;
+	bool cullFace;
+	unsigned int pass;
+	bool transparent;
+	float depth;			// normalized 0..1
+} draw_command_t;
+
+const unsigned int KEY_PROGRAM_IDS = 256;
+const unsigned int KEY_MATERIAL_IDS = 65536;
+
+uint64_t makeSortKey( unsigned int pass, bool transparent, unsigned int programId, unsigned int materialId, float depth );	// depth normalized 0..1
+draw_command_t makeDrawCommand( unsigned int pass, GLuint program, GLuint vao, GLuint texture, GLsizei indexCount,
+								const glm::mat4 &model, bool transparent, float depth );
+unsigned int sortKeyPass( uint64_t key );
+bool sortKeyTransparent( uint64_t key );
+
+// view frustum culling, planes point inwards
+typedef struct {
+	glm::vec4 planes[6];
+} frustum_t;
+
+frustum_t makeFrustum( const glm::mat4 &viewProj );
+bool sphereInFrustum( const frustum_t &frustum, const glm::vec3 &center, float radius );
+
+// LSD radix sort of keys with their payload, 8 bits per pass. Result ends up in keys/values.
+void radixSortKeys( uint64_t *keys, uint32_t *values, uint64_t *tmpKeys, uint32_t *tmpValues, size_t count );
+
+class DrawQueue {
+public:
+	DrawQueue();
+	void clear();
+	uint64_t submit( const draw_command_t &cmd );	// returns the command's sort key
+	void append( const DrawQueue &other );	// e.g. a worker's buffer, order is kept until sort()
+	void sort();
+	// Submits one pass's commands in key order. A program other than 0 replaces every command's
+	// own, e.g. the depth-only one; it only gets the model matrix and no texture.
+	void execute( unsigned int pass, draw_subset_t subset=DRAW_ALL, GLuint program=0 );
+	unsigned int size() const;
+
+private:
+	uint64_t keyFor( const draw_command_t &cmd );
+
+	std::vector<draw_command_t> mCommands;
+	std::vector<GLuint> mProgramIds;		// GL name of each dense id, reset by clear()
+	std::vector<GLuint> mMaterialIds;
+	std::vector<uint64_t> mKeys;
+	std::vector<uint64_t> mTmpKeys;
+	std::vector<uint32_t> mOrder;
+	std::vector<uint32_t> mTmpOrder;
+	bool mSorted;
+};
+
+void benchmarkDrawQueue( unsigned int commands, unsigned int frames );	// prints submit/sort timings
+
+#endif
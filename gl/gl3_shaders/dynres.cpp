@@ -0,0 +1,86 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "dynres.h"
+#include <stdio.h>
+
+////////////////////////////
+/////// DYNRES.CPP /////////
+////////////////////////////
+
+const float DYNRES_SMOOTHING = 0.2f;		// weight of the newest frame in the running average
+const float DYNRES_OVER = 1.0f;				// fraction of the budget that triggers a drop
+const float DYNRES_FAR_OVER = 1.25f;		// ... a double drop
+const float DYNRES_UNDER = 0.75f;			// ... room to climb
+
+typedef struct {
+	dynres_config_t config;
+	float scale;
+	float average;
+	unsigned int wait;		// frames left before the next change
+} dynres_t;
+
+dynres_t gDynres = { { 14.0f, 0.5f, 1.0f, 0.05f, 12 }, 1.0f, 0.0f, 0 };
+
+dynres_config_t makeDynresConfig( float targetMs ){
+	dynres_config_t config;
+	config.targetMs = targetMs;
+	config.minScale = 0.5f;
+	config.maxScale = 1.0f;
+	config.step = 0.05f;
+	config.cooldown = 12;
+	return config;
+}
+
+void initDynamicResolution( const dynres_config_t &config ){
+	gDynres.config = config;
+	resetDynamicResolution();
+}
+
+void resetDynamicResolution(){
+	gDynres.scale = gDynres.config.maxScale;
+	gDynres.average = 0.0f;
+	gDynres.wait = gDynres.config.cooldown;
+}
+
+float dynamicResolutionScale(){
+	return gDynres.scale;
+}
+
+float updateDynamicResolution( float gpuMs ){
+	const dynres_config_t &c = gDynres.config;
+	
+	if( gDynres.average == 0.0f ) gDynres.average = gpuMs;
+	else gDynres.average += ( gpuMs - gDynres.average ) * DYNRES_SMOOTHING;
+	
+	if( gDynres.wait > 0 ){
+		gDynres.wait--;
+		return gDynres.scale;
+	}
+	
+	float scale = gDynres.scale;
+	if( gDynres.average > c.targetMs * DYNRES_FAR_OVER ) scale -= c.step * 2.0f;
+	else if( gDynres.average > c.targetMs * DYNRES_OVER ) scale -= c.step;
+	else if( gDynres.average < c.targetMs * DYNRES_UNDER ) scale += c.step;
+	
+	if( scale < c.minScale ) scale = c.minScale;
+	if( scale > c.maxScale ) scale = c.maxScale;
+	
+	if( scale != gDynres.scale ){
+		gDynres.scale = scale;
+		gDynres.wait = c.cooldown;
+		// frames at the old scale are still in the average, start over
+		gDynres.average = 0.0f;
+	}
+	return gDynres.scale;
+}
+
+void scaledRenderSize( unsigned int maxWidth, unsigned int maxHeight, float scale, unsigned int &width, unsigned int &height ){
+	width = ( (unsigned int)( maxWidth * scale ) + 7 ) & ~7u;
+	height = ( (unsigned int)( maxHeight * scale ) + 7 ) & ~7u;
+	if( width > maxWidth ) width = maxWidth;
+	if( height > maxHeight ) height = maxHeight;
+	if( width < 8 ) width = 8;
+	if( height < 8 ) height = 8;
+}
@@ -0,0 +1,29 @@
+#ifndef DYNRES_H
+#define DYNRES_H
+
+///////////////////////////////////
+///////// DYNRES HEADER ///////////
+///////////////////////////////////
+
+// Picks the internal render scale from measured GPU frame times. Over budget the scale
+// drops a step (two when far over), comfortably under it climbs back a step. After every
+// change it waits long enough for frames at the new scale to come back from the profiler.
+
+typedef struct {
+	float targetMs;			// GPU time per frame to stay under
+	float minScale;
+	float maxScale;
+	float step;				// scale change per adjustment
+	unsigned int cooldown;	// frames to wait after a change
+} dynres_config_t;
+
+dynres_config_t makeDynresConfig( float targetMs );
+void initDynamicResolution( const dynres_config_t &config );
+float updateDynamicResolution( float gpuMs );	// feed the newest GPU frame time once per frame, returns the scale
+float dynamicResolutionScale();
+void resetDynamicResolution();					// back to full scale
+
+// render size for a scale, in multiples of 8 pixels
+void scaledRenderSize( unsigned int maxWidth, unsigned int maxHeight, float scale, unsigned int &width, unsigned int &height );
+
+#endif
@@ -0,0 +1,452 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "frame_capture.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "cpu_profiler.h"
+#include <SDL2/SDL_image.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+
+//////////////////////////////////
+////// FRAME_CAPTURE.CPP /////////
+//////////////////////////////////
+
+typedef struct {
+	unsigned int index;				// in the capture, streams are written in this order
+	unsigned int width, height;
+	bool bottomUp;					// rows as glReadPixels returns them
+	std::vector<unsigned char> pixels;	// RGBA8, width * 4 bytes a row
+	std::vector<unsigned char> encoded;	// Y4M planes
+} capture_frame_t;
+
+typedef struct {
+	GLuint buffer;
+	size_t bytes;					// allocated
+	GLsync fence;					// in flight while set
+	unsigned int width, height;
+} capture_readback_t;
+
+typedef struct {
+	bool active;
+	capture_format_t format;
+	std::string prefix;
+	unsigned int fps;
+	unsigned int width, height;		// of the first frame
+	FILE *stream;					// raw and Y4M
+
+	capture_readback_t readbacks[CAPTURE_READBACKS];
+	unsigned int next;				// readback slot to issue next, the oldest one in flight
+
+	SDL_Thread *threads[CAPTURE_ENCODERS];
+	SDL_mutex *lock;				// guards the queue, the pool and the stats
+	SDL_cond *wake;					// a frame was queued, or quit
+	bool quit;
+	std::deque<capture_frame_t*> queue;
+	std::vector<capture_frame_t*> pool;		// frames to reuse, so steady capture allocates nothing
+
+	SDL_mutex *writeLock;			// the stream file and nextWrite
+	SDL_cond *written;
+	unsigned int nextWrite;
+
+	capture_stats_t stats;
+} capture_t;
+
+capture_t gCapture;
+
+const char *captureFormatName( capture_format_t format ){
+	switch( format ){
+		case CAPTURE_RAW: return "raw";
+		case CAPTURE_PNG: return "png";
+		case CAPTURE_Y4M: return "y4m";
+		default: return "unknown";
+	}
+}
+
+capture_format_t findCaptureFormat( const char *name ){
+	for( int i = 0; i < CAPTURE_FORMAT_COUNT; i++ )
+		if( strcmp( name, captureFormatName( (capture_format_t)i ) ) == 0 ) return (capture_format_t)i;
+	return CAPTURE_FORMAT_COUNT;
+}
+
+bool capturing(){
+	return gCapture.active;
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=- encoders -=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+void flipRows( capture_frame_t *frame ){
+	size_t pitch = frame->width * 4;
+	std::vector<unsigned char> row( pitch );
+	for( unsigned int y = 0; y < frame->height / 2; y++ ){
+		unsigned char *top = &frame->pixels[y * pitch];
+		unsigned char *bottom = &frame->pixels[( frame->height - 1 - y ) * pitch];
+		memcpy( &row[0], top, pitch );
+		memcpy( top, bottom, pitch );
+		memcpy( bottom, &row[0], pitch );
+	}
+	frame->bottomUp = false;
+}
+
+// BT.601 full range ("C420jpeg"), chroma from the average of each 2x2 block, 16.16 fixed point
+void encodeY4M( capture_frame_t *frame ){
+	unsigned int w = frame->width, h = frame->height;
+	unsigned int cw = ( w + 1 ) / 2, ch = ( h + 1 ) / 2;
+	frame->encoded.resize( w * h + 2 * cw * ch );
+	unsigned char *luma = &frame->encoded[0];
+	unsigned char *cb = luma + w * h;
+	unsigned char *cr = cb + cw * ch;
+	const unsigned char *rgba = &frame->pixels[0];
+
+	for( unsigned int i = 0; i < w * h; i++ ){
+		const unsigned char *p = rgba + i * 4;
+		luma[i] = (unsigned char)( ( 19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768 ) >> 16 );
+	}
+
+	for( unsigned int y = 0; y < ch; y++ ){
+		unsigned int y0 = y * 2, y1 = std::min( y0 + 1, h - 1 );
+		for( unsigned int x = 0; x < cw; x++ ){
+			unsigned int x0 = x * 2, x1 = std::min( x0 + 1, w - 1 );
+			int sum[3];
+			for( int c = 0; c < 3; c++ )
+				sum[c] = rgba[( y0 * w + x0 ) * 4 + c] + rgba[( y0 * w + x1 ) * 4 + c] +
+						 rgba[( y1 * w + x0 ) * 4 + c] + rgba[( y1 * w + x1 ) * 4 + c];
+			// the sums are 4x the average, hence the extra 2 bits of shift
+			cb[y * cw + x] = (unsigned char)std::min( std::max( ( -11059 * sum[0] - 21709 * sum[1] + 32768 * sum[2] + ( 128 << 18 ) + ( 1 << 17 ) ) >> 18, 0 ), 255 );
+			cr[y * cw + x] = (unsigned char)std::min( std::max( ( 32768 * sum[0] - 27439 * sum[1] - 5329 * sum[2] + ( 128 << 18 ) + ( 1 << 17 ) ) >> 18, 0 ), 255 );
+		}
+	}
+}
+
+// Streams take the frames in capture order, whichever encoder finished first
+bool writeInOrder( capture_frame_t *frame ){
+	SDL_LockMutex( gCapture.writeLock );
+	while( gCapture.nextWrite != frame->index )
+		SDL_CondWait( gCapture.written, gCapture.writeLock );
+
+	bool ok = true;
+	if( gCapture.format == CAPTURE_Y4M ){
+		if( frame->index == 0 )
+			fprintf( gCapture.stream, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", frame->width, frame->height, gCapture.fps );
+		fputs( "FRAME\n", gCapture.stream );
+		ok = fwrite( &frame->encoded[0], 1, frame->encoded.size(), gCapture.stream ) == frame->encoded.size();
+	}
+	else ok = fwrite( &frame->pixels[0], 1, frame->pixels.size(), gCapture.stream ) == frame->pixels.size();
+	if( !ok ) printf( "ERROR: Writing captured frame %u failed!\n", frame->index );
+
+	gCapture.nextWrite++;
+	SDL_CondBroadcast( gCapture.written );
+	SDL_UnlockMutex( gCapture.writeLock );
+	return ok;
+}
+
+// false when the frame didn't make it to disk
+bool encodeFrame( capture_frame_t *frame ){
+	CPU_ZONE( "encodeFrame" );
+	if( frame->bottomUp ) flipRows( frame );
+
+	if( gCapture.format == CAPTURE_PNG ){
+		char name[32];
+		snprintf( name, sizeof( name ), "_%05u.png", frame->index );
+		std::string path = gCapture.prefix + name;
+		SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormatFrom( &frame->pixels[0], frame->width, frame->height, 32,
+																   frame->width * 4, SDL_PIXELFORMAT_RGBA32 );
+		bool ok = surface && IMG_SavePNG( surface, path.c_str() ) == 0;
+		if( !ok ) printf( "ERROR: Could not save %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		if( surface ) SDL_FreeSurface( surface );
+		return ok;
+	}
+
+	if( gCapture.format == CAPTURE_Y4M ) encodeY4M( frame );
+	return writeInOrder( frame );
+}
+
+int captureEncoder( void * ){
+	CPU_PROFILER_THREAD( "capture" );
+
+	SDL_LockMutex( gCapture.lock );
+	for( ;; ){
+		while( gCapture.queue.empty() && !gCapture.quit )
+			SDL_CondWait( gCapture.wake, gCapture.lock );
+		if( gCapture.queue.empty() ) break;		// quitting, and nothing left to do
+
+		capture_frame_t *frame = gCapture.queue.front();
+		gCapture.queue.pop_front();
+		SDL_UnlockMutex( gCapture.lock );
+
+		bool written = encodeFrame( frame );
+
+		SDL_LockMutex( gCapture.lock );
+		gCapture.pool.push_back( frame );
+		if( written ) gCapture.stats.written++;
+	}
+	SDL_UnlockMutex( gCapture.lock );
+	CPU_PROFILER_THREAD_END();
+	return 0;
+}
+
+// A frame to fill, NULL when the encoders are CAPTURE_QUEUE frames behind
+capture_frame_t *takeFrame( unsigned int width, unsigned int height ){
+	capture_frame_t *frame = NULL;
+	bool stream = gCapture.format != CAPTURE_PNG;
+
+	SDL_LockMutex( gCapture.lock );
+	if( gCapture.width == 0 ){
+		gCapture.width = width;
+		gCapture.height = height;
+	}
+	if( gCapture.queue.size() >= CAPTURE_QUEUE || ( stream && ( width != gCapture.width || height != gCapture.height ) ) )
+		gCapture.stats.dropped++;
+	else if( !gCapture.pool.empty() ){
+		frame = gCapture.pool.back();
+		gCapture.pool.pop_back();
+	}
+	else frame = new capture_frame_t;
+	SDL_UnlockMutex( gCapture.lock );
+
+	if( frame ){
+		frame->width = width;
+		frame->height = height;
+		frame->pixels.resize( width * height * 4 );
+	}
+	return frame;
+}
+
+void queueFrame( capture_frame_t *frame ){
+	SDL_LockMutex( gCapture.lock );
+	frame->index = gCapture.stats.captured++;
+	gCapture.queue.push_back( frame );
+	SDL_CondSignal( gCapture.wake );
+	SDL_UnlockMutex( gCapture.lock );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=- capture -=-=-=-=-=-=
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+bool startCapture( capture_format_t format, const char *prefix, unsigned int fps ){
+	if( gCapture.active ) stopCapture();
+
+	gCapture.format = format;
+	gCapture.prefix = prefix;
+	gCapture.fps = fps ? fps : 60;
+	gCapture.width = gCapture.height = 0;
+	gCapture.stream = NULL;
+	gCapture.next = 0;
+	gCapture.nextWrite = 0;
+	gCapture.quit = false;
+	memset( &gCapture.stats, 0, sizeof( gCapture.stats ) );
+	for( unsigned int i = 0; i < CAPTURE_READBACKS; i++ ){
+		gCapture.readbacks[i].buffer = 0;
+		gCapture.readbacks[i].bytes = 0;
+		gCapture.readbacks[i].fence = 0;
+	}
+
+	if( format == CAPTURE_RAW || format == CAPTURE_Y4M ){
+		std::string path = gCapture.prefix + ( format == CAPTURE_RAW ? ".rgba" : ".y4m" );
+		gCapture.stream = fopen( path.c_str(), "wb" );
+		if( gCapture.stream == NULL ){
+			printf( "ERROR: Could not open %s for the capture!\n", path.c_str() );
+			return false;
+		}
+	}
+
+	gCapture.lock = SDL_CreateMutex();
+	gCapture.writeLock = SDL_CreateMutex();
+	gCapture.wake = SDL_CreateCond();
+	gCapture.written = SDL_CreateCond();
+	for( unsigned int i = 0; i < CAPTURE_ENCODERS; i++ )
+		gCapture.threads[i] = SDL_CreateThread( captureEncoder, "capture", NULL );
+
+	if( !gCapture.lock || !gCapture.writeLock || !gCapture.wake || !gCapture.written || !gCapture.threads[0] ){
+		printf( "ERROR: Could not start the capture encoders! SDL Error: %s\n", SDL_GetError() );
+		gCapture.active = true;		// so stopCapture() cleans up what was made
+		stopCapture();
+		return false;
+	}
+
+	gCapture.active = true;
+	printf( "SUCCESS: Capturing %s frames to %s...\n", captureFormatName( format ), gCapture.prefix.c_str() );
+	return true;
+}
+
+// Map every finished readback, oldest first, and pass it on. 'wait' blocks on the ones
+// still in flight, for stopCapture().
+void collectReadbacks( bool wait ){
+	for( unsigned int i = 0; i < CAPTURE_READBACKS; i++ ){
+		capture_readback_t &readback = gCapture.readbacks[( gCapture.next + i ) % CAPTURE_READBACKS];
+		if( !readback.fence ) continue;
+
+		GLenum result = glClientWaitSync( readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		while( wait && result == GL_TIMEOUT_EXPIRED )
+			result = glClientWaitSync( readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 );	// 1 ms at a time
+		if( result == GL_TIMEOUT_EXPIRED ) break;		// the later ones are behind it
+
+		glDeleteSync( readback.fence );
+		readback.fence = 0;
+		if( result == GL_WAIT_FAILED ){
+			printf( "ERROR: Waiting for a capture readback failed!\n" );
+			continue;
+		}
+
+		capture_frame_t *frame = takeFrame( readback.width, readback.height );
+		if( frame == NULL ) continue;
+
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+		const void *pixels = glMapBufferRange( GL_PIXEL_PACK_BUFFER, 0, frame->pixels.size(), GL_MAP_READ_BIT );
+		if( pixels ){
+			memcpy( &frame->pixels[0], pixels, frame->pixels.size() );
+			glUnmapBuffer( GL_PIXEL_PACK_BUFFER );
+		}
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		frame->bottomUp = true;
+		if( pixels ) queueFrame( frame );
+		else {
+			printf( "ERROR: Mapping a capture readback failed!\n" );
+			SDL_LockMutex( gCapture.lock );
+			gCapture.pool.push_back( frame );
+			gCapture.stats.dropped++;
+			SDL_UnlockMutex( gCapture.lock );
+		}
+	}
+}
+
+void noteIssueTime( Uint64 start ){
+	float ms = (float)( 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency() );
+	SDL_LockMutex( gCapture.lock );
+	gCapture.stats.issueMs = ms;
+	gCapture.stats.worstIssueMs = std::max( gCapture.stats.worstIssueMs, ms );
+	SDL_UnlockMutex( gCapture.lock );
+}
+
+void captureReadback( unsigned int width, unsigned int height ){
+	CPU_ZONE( "captureReadback" );
+	if( !gCapture.active || width == 0 || height == 0 ) return;
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	collectReadbacks( false );
+
+	// every buffer is still in flight: skip this frame rather than wait for the GPU
+	capture_readback_t &readback = gCapture.readbacks[gCapture.next];
+	if( readback.fence ){
+		SDL_LockMutex( gCapture.lock );
+		gCapture.stats.dropped++;
+		SDL_UnlockMutex( gCapture.lock );
+		noteIssueTime( start );
+		return;
+	}
+
+	size_t bytes = (size_t)width * height * 4;
+	if( readback.buffer == 0 ) glGenBuffers( 1, &readback.buffer );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+	if( readback.bytes < bytes ){
+		glBufferData( GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ );
+		readback.bytes = bytes;
+		gpuMemoryUntrack( GPU_MEM_BUFFER, readback.buffer );
+		gpuMemoryTrack( GPU_MEM_BUFFER, readback.buffer, "capture", "readback", bytes );
+	}
+
+	// rows of 4 byte pixels are always 4 byte aligned, the default pack alignment
+	stateBindFramebuffer( GL_READ_FRAMEBUFFER, 0 );
+	glReadBuffer( GL_BACK );
+	glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	readback.fence = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	readback.width = width;
+	readback.height = height;
+	gCapture.next = ( gCapture.next + 1 ) % CAPTURE_READBACKS;
+	noteIssueTime( start );
+}
+
+void captureImage( const void *pixels, unsigned int width, unsigned int height, unsigned int pitch ){
+	CPU_ZONE( "captureImage" );
+	if( !gCapture.active ) return;
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	capture_frame_t *frame = takeFrame( width, height );
+	if( frame ){
+		for( unsigned int y = 0; y < height; y++ )
+			memcpy( &frame->pixels[y * width * 4], (const unsigned char*)pixels + y * pitch, width * 4 );
+		frame->bottomUp = false;
+		queueFrame( frame );
+	}
+	noteIssueTime( start );
+}
+
+void stopCapture(){
+	if( !gCapture.active ) return;
+
+	// finish what the GPU still has, only GL captures made any buffers
+	bool readbacks = false;
+	for( unsigned int i = 0; i < CAPTURE_READBACKS; i++ )
+		readbacks = readbacks || gCapture.readbacks[i].buffer;
+	if( readbacks ){
+		collectReadbacks( true );
+		for( unsigned int i = 0; i < CAPTURE_READBACKS; i++ ){
+			capture_readback_t &readback = gCapture.readbacks[i];
+			if( readback.buffer == 0 ) continue;
+			gpuMemoryUntrack( GPU_MEM_BUFFER, readback.buffer );
+			glDeleteBuffers( 1, &readback.buffer );
+			readback.buffer = 0;
+			readback.bytes = 0;
+		}
+	}
+
+	// the encoders empty the queue before they quit
+	if( gCapture.lock ){
+		SDL_LockMutex( gCapture.lock );
+		gCapture.quit = true;
+		SDL_CondBroadcast( gCapture.wake );
+		SDL_UnlockMutex( gCapture.lock );
+	}
+	for( unsigned int i = 0; i < CAPTURE_ENCODERS; i++ ){
+		if( gCapture.threads[i] ) SDL_WaitThread( gCapture.threads[i], NULL );
+		gCapture.threads[i] = NULL;
+	}
+
+	for( unsigned int i = 0; i < gCapture.queue.size(); i++ )
+		delete gCapture.queue[i];
+	for( unsigned int i = 0; i < gCapture.pool.size(); i++ )
+		delete gCapture.pool[i];
+	gCapture.queue.clear();
+	gCapture.pool.clear();
+
+	if( gCapture.stream ) fclose( gCapture.stream );
+	if( gCapture.written ) SDL_DestroyCond( gCapture.written );
+	if( gCapture.wake ) SDL_DestroyCond( gCapture.wake );
+	if( gCapture.writeLock ) SDL_DestroyMutex( gCapture.writeLock );
+	if( gCapture.lock ) SDL_DestroyMutex( gCapture.lock );
+	gCapture.stream = NULL;
+	gCapture.written = gCapture.wake = NULL;
+	gCapture.writeLock = gCapture.lock = NULL;
+
+	gCapture.active = false;
+	printCaptureStats();
+}
+
+capture_stats_t captureStats(){
+	capture_stats_t stats;
+	if( gCapture.lock ) SDL_LockMutex( gCapture.lock );
+	stats = gCapture.stats;
+	if( gCapture.lock ) SDL_UnlockMutex( gCapture.lock );
+	return stats;
+}
+
+void printCaptureStats(){
+	capture_stats_t stats = captureStats();
+	printf( "CAPTURE: %u frames captured, %u written, %u dropped, %.3f ms on the render thread (worst %.3f ms)\n",
+			stats.captured, stats.written, stats.dropped, stats.issueMs, stats.worstIssueMs );
+	if( gCapture.format == CAPTURE_RAW && gCapture.width )
+		printf( "CAPTURE: play with ffplay -f rawvideo -pixel_format rgba -video_size %ux%u -framerate %u %s.rgba\n",
+				gCapture.width, gCapture.height, gCapture.fps, gCapture.prefix.c_str() );
+}
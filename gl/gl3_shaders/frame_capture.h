@@ -0,0 +1,61 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+////// FRAME_CAPTURE HEADER ///////
+///////////////////////////////////
+
+// Records rendered frames without stalling the renderer.
+//
+// captureReadback() starts a glReadPixels of the back buffer into one of CAPTURE_READBACKS
+// pixel buffers and fences it. The copy runs on the GPU, the pixels are only mapped once
+// the fence has passed, a few frames later, so neither call waits. captureImage() takes
+// frames that are in memory already, e.g. from the software rasterizer with no GL at all.
+//
+// Frames then go to CAPTURE_ENCODERS threads of their own:
+//   CAPTURE_RAW	<prefix>.rgba, RGBA8 frames back to back, top row first
+//   CAPTURE_PNG	<prefix>_00000.png and so on
+//   CAPTURE_Y4M	<prefix>.y4m, 4:2:0 full range, plays in mpv/ffplay, feeds ffmpeg
+// Raw and Y4M keep the size of the first frame, frames of another size are dropped.
+//
+// Nothing waits on a full pipeline, a frame that finds every readback still in flight or
+// CAPTURE_QUEUE frames waiting to be encoded is dropped and counted instead. The render
+// thread only pays for issuing the readback and one memcpy per frame.
+//
+// captureReadback() and stopCapture() after it must be called from the thread owning the
+// GL context.
+
+const unsigned int CAPTURE_READBACKS = 4;	// frames a readback may take
+const unsigned int CAPTURE_QUEUE = 8;		// frames waiting for an encoder
+const unsigned int CAPTURE_ENCODERS = 2;
+
+typedef enum {
+	CAPTURE_RAW,
+	CAPTURE_PNG,
+	CAPTURE_Y4M,
+	CAPTURE_FORMAT_COUNT
+} capture_format_t;
+
+typedef struct {
+	unsigned int captured;		// handed to the encoders
+	unsigned int written;
+	unsigned int dropped;		// pipeline full, or the size changed
+	float issueMs;				// render thread time in the last captureReadback/captureImage
+	float worstIssueMs;
+} capture_stats_t;
+
+bool startCapture( capture_format_t format, const char *prefix, unsigned int fps );
+void stopCapture();				// finishes the readbacks in flight and everything queued
+bool capturing();
+
+void captureReadback( unsigned int width, unsigned int height );	// back buffer, before the swap
+void captureImage( const void *pixels, unsigned int width, unsigned int height, unsigned int pitch );	// RGBA8, top row first
+
+const char *captureFormatName( capture_format_t format );
+capture_format_t findCaptureFormat( const char *name );		// CAPTURE_FORMAT_COUNT if there's none
+capture_stats_t captureStats();
+void printCaptureStats();
+
+#endif
@@ -0,0 +1,269 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "gl_state.h"
+
+////////////////////////////////
+/////// GL_STATE.CPP ///////////
+////////////////////////////////
+
+const GLuint STATE_UNKNOWN = 0xFFFFFFFF;
+
+// texture targets the renderer binds, one slot each per unit
+const unsigned int STATE_TEXTURE_TARGETS = 4;
+const GLenum STATE_TARGETS[STATE_TEXTURE_TARGETS] = { GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BUFFER };
+
+// capabilities tracked by stateEnable/stateDisable
+const unsigned int STATE_CAPS = 4;
+const GLenum STATE_CAP_NAMES[STATE_CAPS] = { GL_DEPTH_TEST, GL_CULL_FACE, GL_BLEND, GL_STENCIL_TEST };
+
+struct gl_state_t {
+	GLuint program;
+	GLuint vao;
+	GLuint drawFBO;
+	GLuint readFBO;
+	GLuint activeUnit;
+	GLuint textures[STATE_TEXTURE_UNITS][STATE_TEXTURE_TARGETS];
+	GLuint caps[STATE_CAPS];		// 0 / 1 / STATE_UNKNOWN
+	GLenum blendSrc;
+	GLenum blendDst;
+	GLenum blendSrcAlpha;
+	GLenum blendDstAlpha;
+	GLuint depthFunc;
+	GLuint depthMask;
+	GLint viewport[4];
+	bool viewportKnown;
+	gl_state_stats_t stats;
+	bool ready;						// false until the first call sets everything to unknown
+};
+
+gl_state_t gState;						// the main context's, wherever it's current
+thread_local gl_state_t *tState = NULL;	// another context's, when this thread made one current
+
+void stateClear( gl_state_t &s ){
+	unsigned int i, j;
+	
+	s.program = STATE_UNKNOWN;
+	s.vao = STATE_UNKNOWN;
+	s.drawFBO = STATE_UNKNOWN;
+	s.readFBO = STATE_UNKNOWN;
+	s.activeUnit = STATE_UNKNOWN;
+	for( i = 0; i < STATE_TEXTURE_UNITS; i++ )
+		for( j = 0; j < STATE_TEXTURE_TARGETS; j++ )
+			s.textures[i][j] = STATE_UNKNOWN;
+	for( i = 0; i < STATE_CAPS; i++ )
+		s.caps[i] = STATE_UNKNOWN;
+	s.blendSrc = STATE_UNKNOWN;
+	s.blendDst = STATE_UNKNOWN;
+	s.blendSrcAlpha = STATE_UNKNOWN;
+	s.blendDstAlpha = STATE_UNKNOWN;
+	s.depthFunc = STATE_UNKNOWN;
+	s.depthMask = STATE_UNKNOWN;
+	s.viewportKnown = false;
+	
+	if( !s.ready ){
+		s.stats.issued = 0;
+		s.stats.skipped = 0;
+		s.ready = true;
+	}
+}
+
+// lazily set up the first time any call comes in
+inline gl_state_t &state(){
+	gl_state_t &s = tState ? *tState : gState;
+	if( !s.ready ) stateClear( s );
+	return s;
+}
+
+void stateInvalidate(){
+	stateClear( tState ? *tState : gState );
+}
+
+gl_state_t *stateCreate(){
+	gl_state_t *cache = new gl_state_t;
+	cache->ready = false;
+	return cache;
+}
+
+void stateDestroy( gl_state_t *cache ){
+	if( tState == cache ) tState = NULL;
+	delete cache;
+}
+
+void stateMakeCurrent( gl_state_t *cache ){
+	tState = cache;
+}
+
+// true (and counted) when the value has to go to GL
+inline bool stateChange( GLuint &cached, GLuint value ){
+	gl_state_t &s = state();
+	if( cached == value ){
+		s.stats.skipped++;
+		return false;
+	}
+	cached = value;
+	s.stats.issued++;
+	return true;
+}
+
+void stateUseProgram( GLuint program ){
+	if( stateChange( state().program, program ) )
+		glUseProgram( program );
+}
+
+void stateBindVertexArray( GLuint vao ){
+	if( stateChange( state().vao, vao ) )
+		glBindVertexArray( vao );
+}
+
+void stateBindFramebuffer( GLenum target, GLuint fbo ){
+	gl_state_t &s = state();
+	
+	if( target == GL_READ_FRAMEBUFFER ){
+		if( stateChange( s.readFBO, fbo ) ) glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+	}
+	else if( target == GL_DRAW_FRAMEBUFFER ){
+		if( stateChange( s.drawFBO, fbo ) ) glBindFramebuffer( GL_DRAW_FRAMEBUFFER, fbo );
+	}
+	else {
+		// GL_FRAMEBUFFER binds both at once
+		if( s.drawFBO == fbo && s.readFBO == fbo ){
+			s.stats.skipped++;
+			return;
+		}
+		s.drawFBO = fbo;
+		s.readFBO = fbo;
+		s.stats.issued++;
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+	}
+}
+
+unsigned int stateTargetIndex( GLenum target ){
+	for( unsigned int i = 0; i < STATE_TEXTURE_TARGETS; i++ )
+		if( STATE_TARGETS[i] == target ) return i;
+	return STATE_TEXTURE_TARGETS;
+}
+
+void stateBindTexture( unsigned int unit, GLenum target, GLuint texture ){
+	gl_state_t &s = state();
+	unsigned int t = stateTargetIndex( target );
+	
+	// untracked unit or target, pass straight through and forget the active unit
+	if( unit >= STATE_TEXTURE_UNITS || t == STATE_TEXTURE_TARGETS ){
+		glActiveTexture( GL_TEXTURE0 + unit );
+		glBindTexture( target, texture );
+		s.activeUnit = STATE_UNKNOWN;
+		s.stats.issued += 2;
+		return;
+	}
+	
+	if( s.textures[unit][t] == texture ){
+		s.stats.skipped++;
+		return;
+	}
+	
+	if( stateChange( s.activeUnit, unit ) )
+		glActiveTexture( GL_TEXTURE0 + unit );
+	
+	s.textures[unit][t] = texture;
+	s.stats.issued++;
+	glBindTexture( target, texture );
+}
+
+unsigned int stateCapIndex( GLenum cap ){
+	for( unsigned int i = 0; i < STATE_CAPS; i++ )
+		if( STATE_CAP_NAMES[i] == cap ) return i;
+	return STATE_CAPS;
+}
+
+void stateEnable( GLenum cap ){
+	unsigned int c = stateCapIndex( cap );
+	if( c == STATE_CAPS ){
+		glEnable( cap );
+		state().stats.issued++;
+	}
+	else if( stateChange( state().caps[c], 1 ) )
+		glEnable( cap );
+}
+
+void stateDisable( GLenum cap ){
+	unsigned int c = stateCapIndex( cap );
+	if( c == STATE_CAPS ){
+		glDisable( cap );
+		state().stats.issued++;
+	}
+	else if( stateChange( state().caps[c], 0 ) )
+		glDisable( cap );
+}
+
+void stateBlendFunc( GLenum sfactor, GLenum dfactor ){
+	stateBlendFuncSeparate( sfactor, dfactor, sfactor, dfactor );
+}
+
+void stateBlendFuncSeparate( GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha ){
+	gl_state_t &s = state();
+	if( s.blendSrc == srcRGB && s.blendDst == dstRGB && s.blendSrcAlpha == srcAlpha && s.blendDstAlpha == dstAlpha ){
+		s.stats.skipped++;
+		return;
+	}
+	s.blendSrc = srcRGB;
+	s.blendDst = dstRGB;
+	s.blendSrcAlpha = srcAlpha;
+	s.blendDstAlpha = dstAlpha;
+	s.stats.issued++;
+	glBlendFuncSeparate( srcRGB, dstRGB, srcAlpha, dstAlpha );
+}
+
+void stateDepthFunc( GLenum func ){
+	if( stateChange( state().depthFunc, func ) )
+		glDepthFunc( func );
+}
+
+// note glClear of the depth buffer obeys the mask too
+void stateDepthMask( GLboolean write ){
+	if( stateChange( state().depthMask, write ) )
+		glDepthMask( write );
+}
+
+void stateViewport( GLint x, GLint y, GLsizei width, GLsizei height ){
+	gl_state_t &s = state();
+	if( s.viewportKnown && s.viewport[0] == x && s.viewport[1] == y && s.viewport[2] == width && s.viewport[3] == height ){
+		s.stats.skipped++;
+		return;
+	}
+	s.viewport[0] = x;
+	s.viewport[1] = y;
+	s.viewport[2] = width;
+	s.viewport[3] = height;
+	s.viewportKnown = true;
+	s.stats.issued++;
+	glViewport( x, y, width, height );
+}
+
+void stateForgetTexture( GLuint texture ){
+	gl_state_t &s = state();
+	for( unsigned int i = 0; i < STATE_TEXTURE_UNITS; i++ )
+		for( unsigned int j = 0; j < STATE_TEXTURE_TARGETS; j++ )
+			if( s.textures[i][j] == texture ) s.textures[i][j] = 0;
+}
+
+void stateForgetFramebuffer( GLuint fbo ){
+	gl_state_t &s = state();
+	if( s.drawFBO == fbo ) s.drawFBO = 0;
+	if( s.readFBO == fbo ) s.readFBO = 0;
+}
+
+void stateForgetVertexArray( GLuint vao ){
+	gl_state_t &s = state();
+	if( s.vao == vao ) s.vao = 0;
+}
+
+gl_state_stats_t stateGetStats(){
+	return state().stats;
+}
+
+void stateResetStats(){
+	state().stats.issued = 0;
+	state().stats.skipped = 0;
+}
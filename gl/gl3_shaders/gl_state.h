@@ -0,0 +1,55 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+//////// GL_STATE HEADER //////////
+///////////////////////////////////
+
+// Thin cache over the GL binds and toggles the renderer uses. Each call compares against
+// the last value set through the cache and skips the driver call when nothing changes.
+// Everything that binds these objects should go through here, or call stateInvalidate()
+// afterwards so the cache stops trusting what it remembers.
+//
+// Bindings belong to a GL context, so each context needs a cache of its own. The default
+// one follows the main context from thread to thread. A thread that makes another context
+// current, like each --batch render thread does, hands that context's cache to stateMakeCurrent()
+// and every call on that thread goes through it until it hands over NULL again.
+
+const unsigned int STATE_TEXTURE_UNITS = 16;
+
+struct gl_state_t;
+
+typedef struct {
+	unsigned int issued;		// calls forwarded to GL
+	unsigned int skipped;		// redundant calls dropped
+} gl_state_stats_t;
+
+void stateInvalidate();								// forget everything, next call of each kind goes to GL
+
+void stateUseProgram( GLuint program );
+void stateBindVertexArray( GLuint vao );
+void stateBindFramebuffer( GLenum target, GLuint fbo );
+void stateBindTexture( unsigned int unit, GLenum target, GLuint texture );
+void stateEnable( GLenum cap );
+void stateDisable( GLenum cap );
+void stateBlendFunc( GLenum sfactor, GLenum dfactor );
+void stateBlendFuncSeparate( GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha );
+void stateDepthFunc( GLenum func );
+void stateDepthMask( GLboolean write );
+void stateViewport( GLint x, GLint y, GLsizei width, GLsizei height );
+
+// objects being deleted, GL unbinds them itself so the cache has to follow
+void stateForgetTexture( GLuint texture );
+void stateForgetFramebuffer( GLuint fbo );
+void stateForgetVertexArray( GLuint vao );
+
+gl_state_t *stateCreate();
+void stateDestroy( gl_state_t *cache );
+void stateMakeCurrent( gl_state_t *cache );			// this thread only, NULL for the default cache
+
+gl_state_stats_t stateGetStats();					// totals since the last reset
+void stateResetStats();
+
+#endif
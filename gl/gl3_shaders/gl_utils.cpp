@@ -3,6 +3,9 @@
 #define GLEW_STATIC
 
 #include "gl_utils.h"
+#include "gl_state.h"
+#include "cpu_profiler.h"
+#include "gpu_memory.h"
 
 ////////////////////////////////
 /////// GL_UTILS.CPP ///////////
@@ -66,7 +69,8 @@ void printShaderLog( GLuint shader ){
     }
 }
 
-GLuint loadShaderFromFile( std::string path, GLenum shaderType ){
+GLuint loadShaderFromFile( std::string path, GLenum shaderType, const std::string &defines ){
+	CPU_ZONE( "loadShaderFromFile" );
 	GLuint shaderID = 0;
 	std::string shaderString;
 	std::ifstream sourceFile( path.c_str() );
@@ -80,12 +84,23 @@ GLuint loadShaderFromFile( std::string path, GLenum shaderType ){
 		
 	if( shaderType == GL_GEOMETRY_SHADER )
 		sType = "geom";
+		
+	if( shaderType == GL_COMPUTE_SHADER )
+		sType = "comp";
 	
 	if( sourceFile ){
 		// read the source file as one whole string
 		printf( "ATTEMPT: Reading shader source: %s\n", path.c_str() );
 		shaderString.assign( std::istreambuf_iterator<char>( sourceFile ), std::istreambuf_iterator<char>() );
 		
+		// #version has to stay first, the defines go on the line after it
+		if( !defines.empty() ){
+			size_t line = shaderString.find( "#version" );
+			line = line == std::string::npos ? 0 : shaderString.find( '\n', line );
+			line = line == std::string::npos ? shaderString.size() : line + 1;
+			shaderString.insert( line, defines );
+		}
+		
 		// create a shader ID
 		shaderID = glCreateShader( shaderType );
 		
@@ -119,13 +134,15 @@ void setColor( GLint &location, GLfloat r, GLfloat g, GLfloat b ){
 	glUniform4f( location, r, g, b, 1.0f );	
 }
 
-bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std::string geoSource ){
+bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std::string geoSource, const std::string &defines ){
+		CPU_ZONE( "loadProgram" );
+		
 		// create a program
 		id = glCreateProgram();
 		printf( "SUCCESS: Shader program created...\n", (unsigned int)id );
 		
 		// load vertex shader from file
-		GLuint vertexShader = loadShaderFromFile( vertSource, GL_VERTEX_SHADER );
+		GLuint vertexShader = loadShaderFromFile( vertSource, GL_VERTEX_SHADER, defines );
 		if( vertexShader == 0 ){
 			glDeleteProgram( id );
 			id = 0;
@@ -136,7 +153,7 @@ bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std
 		glAttachShader( id, vertexShader );
 		
 		// create fragment shader
-		GLuint fragmentShader = loadShaderFromFile( fragSource, GL_FRAGMENT_SHADER );
+		GLuint fragmentShader = loadShaderFromFile( fragSource, GL_FRAGMENT_SHADER, defines );
 		if( fragmentShader == 0 ){
 			glDeleteShader( vertexShader );
 			glDeleteProgram( id );
@@ -150,7 +167,7 @@ bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std
 		// load geometry shader from file
 		GLuint geometryShader;
 		if( !geoSource.empty() ){
-			geometryShader = loadShaderFromFile( geoSource, GL_GEOMETRY_SHADER );
+			geometryShader = loadShaderFromFile( geoSource, GL_GEOMETRY_SHADER, defines );
 			if( geometryShader == 0 ){
 				glDeleteShader( fragmentShader );
 				glDeleteProgram( id );
@@ -191,7 +208,47 @@ bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std
     return true;
 }
 
+bool loadComputeProgram( GLuint &id, std::string compSource ){
+	CPU_ZONE( "loadComputeProgram" );
+	
+	// create a program
+	id = glCreateProgram();
+	printf( "SUCCESS: Compute program created...\n" );
+	
+	// load compute shader from file
+	GLuint computeShader = loadShaderFromFile( compSource, GL_COMPUTE_SHADER );
+	if( computeShader == 0 ){
+		glDeleteProgram( id );
+		id = 0;
+		return false;
+	}
+	
+	// attach compute shader to program, it is the only stage
+	glAttachShader( id, computeShader );
+	
+	printf( "ATTEMPT: Link GL compute program...\n" );
+	glLinkProgram( id );
+	
+	// error check
+	GLint programSuccess = GL_TRUE;
+	glGetProgramiv( id, GL_LINK_STATUS, &programSuccess );
+	if( programSuccess != GL_TRUE ){
+		printf( "ERROR: Failed to link compute program %d!\n", id );
+		printProgramLog( id );
+		glDeleteShader( computeShader );
+		glDeleteProgram( id );
+		id = 0;
+		return false;
+	}
+	
+	printf( "SUCCESS: Compute program %d created...\n", id );
+	
+	glDeleteShader( computeShader );
+	return true;
+}
+
 GLuint loadTexFromFile( const char *filename, unsigned int width, unsigned int height, bool gammaCorrection=false, bool filtering=true ){
+	CPU_ZONE( "loadTexFromFile" );
 	GLuint tempID;
 	
 	// set our filename from the given parameter, and concat it at the end of the application path on disk
@@ -211,7 +268,7 @@ GLuint loadTexFromFile( const char *filename, unsigned int width, unsigned int h
 		printf( "SUCCESS: Loaded texture: %s\n", imageName.c_str() );
 		
 		glGenTextures( 1, &tempID );
-		glBindTexture( GL_TEXTURE_2D, tempID );
+		stateBindTexture( 0, GL_TEXTURE_2D, tempID );
 		
 		int mode = GL_RGBA;
 		int internalformat;
@@ -252,12 +309,19 @@ GLuint loadTexFromFile( const char *filename, unsigned int width, unsigned int h
 			return 0;
 		}
 		
+		gpuMemoryTrack( GPU_MEM_TEXTURE, tempID, "textures", imageName, textureBytes( internalformat, width, height, 1, filtering ) );
 		if( tex ) SDL_FreeSurface( tex );
 	}
 
 	return tempID;
 }
 
+void setTexFiltering( GLuint texture, bool filtering ){
+	stateBindTexture( 0, GL_TEXTURE_2D, texture );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filtering ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtering ? GL_LINEAR : GL_NEAREST );
+}
+
 
 
 
@@ -27,21 +27,21 @@ void handleKeys(
 	int x, 
 	int y );					// Input handler
 void update( float delta );		// Per frame update
-void renderQuad();				// Renders a flat quad to fill the screen
-void render();					// Renders quad to the screen
 void close();					// Frees media and shuts down SDL
 void shaderSendMatrix( unsigned int location, glm::mat4 &matrix );
 void setMat4(unsigned int &ID, const std::string &name, const glm::mat4 &mat);
 void shaderSendMatrix( unsigned int location, glm::mat3 &matrix );
-void setViewport();
 glm::mat3 getNormalMatrix( glm::mat4 inMatrix );
 
 // shader stuff
 void printProgramLog( GLuint program );
 void printShaderLog( GLuint shader );
-GLuint loadShaderFromFile( std::string path, GLenum shaderType );
-bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std::string geoSource="" );
+// 'defines' (e.g. "#define OIT\n") goes right after the #version line, for variants of one source
+GLuint loadShaderFromFile( std::string path, GLenum shaderType, const std::string &defines="" );
+bool loadProgram(GLuint &id, std::string vertSource, std::string fragSource, std::string geoSource="", const std::string &defines="" );
+bool loadComputeProgram( GLuint &id, std::string compSource );
 void setColor( GLint &location, GLfloat r, GLfloat g, GLfloat b );
 GLuint loadTexFromFile( const char *filename, unsigned int width, unsigned int height, bool gammaCorrection, bool filtering );
+void setTexFiltering( GLuint texture, bool filtering );	// switch a texture loaded with filtering to nearest and back
 
 #endif
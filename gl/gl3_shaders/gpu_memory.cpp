@@ -0,0 +1,180 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "gpu_memory.h"
+#include <algorithm>
+#include <map>
+
+//////////////////////////////////
+/////// GPU_MEMORY.CPP ///////////
+//////////////////////////////////
+
+typedef struct {
+	std::string subsystem;
+	std::string label;
+	size_t bytes;
+} gpu_allocation_t;
+
+typedef struct {
+	SDL_SpinLock lock;		// GL objects are made on the render thread, reports can come from anywhere
+	std::map< std::pair<int, GLuint>, gpu_allocation_t > allocations;
+	size_t total;
+} gpu_memory_t;
+
+gpu_memory_t gMemory;
+
+const char *GPU_MEM_KIND_NAMES[GPU_MEM_KIND_COUNT] = { "texture", "renderbuffer", "buffer" };
+
+unsigned int textureFormatBytes( GLenum format ){
+	switch( format ){
+		case GL_R8:					return 1;
+		case GL_RG8:
+		case GL_R16F:
+		case GL_DEPTH_COMPONENT16:	return 2;
+		case GL_RGB:
+		case GL_RGB8:
+		case GL_SRGB:
+		case GL_SRGB8:				return 3;
+		case GL_RGBA:
+		case GL_RGBA8:
+		case GL_SRGB_ALPHA:
+		case GL_SRGB8_ALPHA8:
+		case GL_RGB10_A2:
+		case GL_R11F_G11F_B10F:
+		case GL_RG16F:
+		case GL_R32F:
+		case GL_DEPTH_COMPONENT:	// drivers store unsized depth as 24 bits, padded
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:
+		case GL_DEPTH24_STENCIL8:	return 4;
+		case GL_RGB16F:				return 6;
+		case GL_RGBA16F:
+		case GL_RG32F:				return 8;
+		case GL_RGB32F:				return 12;
+		case GL_RGBA32F:			return 16;
+	}
+	return 4;
+}
+
+const char *textureFormatName( GLenum format ){
+	switch( format ){
+		case GL_R8:					return "R8";
+		case GL_RG8:				return "RG8";
+		case GL_R16F:				return "R16F";
+		case GL_RGB:				return "RGB";
+		case GL_RGB8:				return "RGB8";
+		case GL_SRGB:				return "SRGB";
+		case GL_SRGB8:				return "SRGB8";
+		case GL_RGBA:				return "RGBA";
+		case GL_RGBA8:				return "RGBA8";
+		case GL_SRGB_ALPHA:			return "SRGB_ALPHA";
+		case GL_SRGB8_ALPHA8:		return "SRGB8_ALPHA8";
+		case GL_RGB10_A2:			return "RGB10_A2";
+		case GL_R11F_G11F_B10F:		return "R11F_G11F_B10F";
+		case GL_RG16F:				return "RG16F";
+		case GL_R32F:				return "R32F";
+		case GL_RGB16F:				return "RGB16F";
+		case GL_RGBA16F:			return "RGBA16F";
+		case GL_RG32F:				return "RG32F";
+		case GL_RGB32F:				return "RGB32F";
+		case GL_RGBA32F:			return "RGBA32F";
+		case GL_DEPTH_COMPONENT:	return "DEPTH";
+		case GL_DEPTH_COMPONENT16:	return "DEPTH16";
+		case GL_DEPTH_COMPONENT24:	return "DEPTH24";
+		case GL_DEPTH_COMPONENT32F:	return "DEPTH32F";
+		case GL_DEPTH24_STENCIL8:	return "DEPTH24_STENCIL8";
+	}
+	return "?";
+}
+
+size_t textureBytes( GLenum format, unsigned int width, unsigned int height, unsigned int layers, bool mipmaps ){
+	size_t bytes = (size_t)width * height * layers * textureFormatBytes( format );
+	
+	// a full mip chain adds a third
+	if( mipmaps ) bytes += bytes / 3;
+	return bytes;
+}
+
+void gpuMemoryTrack( gpu_mem_kind_t kind, GLuint name, const char *subsystem, const std::string &label, size_t bytes ){
+	if( name == 0 ) return;
+	
+	gpu_allocation_t alloc;
+	alloc.subsystem = subsystem;
+	alloc.label = label;
+	alloc.bytes = bytes;
+	
+	SDL_AtomicLock( &gMemory.lock );
+	std::pair<int, GLuint> key( kind, name );
+	std::map< std::pair<int, GLuint>, gpu_allocation_t >::iterator it = gMemory.allocations.find( key );
+	if( it != gMemory.allocations.end() ) gMemory.total -= it->second.bytes;
+	gMemory.allocations[key] = alloc;
+	gMemory.total += bytes;
+	SDL_AtomicUnlock( &gMemory.lock );
+}
+
+void gpuMemoryUntrack( gpu_mem_kind_t kind, GLuint name ){
+	SDL_AtomicLock( &gMemory.lock );
+	std::map< std::pair<int, GLuint>, gpu_allocation_t >::iterator it = gMemory.allocations.find( std::pair<int, GLuint>( kind, name ) );
+	if( it != gMemory.allocations.end() ){
+		gMemory.total -= it->second.bytes;
+		gMemory.allocations.erase( it );
+	}
+	SDL_AtomicUnlock( &gMemory.lock );
+}
+
+size_t gpuMemoryTotal(){
+	SDL_AtomicLock( &gMemory.lock );
+	size_t total = gMemory.total;
+	SDL_AtomicUnlock( &gMemory.lock );
+	return total;
+}
+
+bool largerGroup( const gpu_mem_group_t &a, const gpu_mem_group_t &b ){
+	return a.bytes > b.bytes;
+}
+
+std::vector<gpu_mem_group_t> gpuMemoryGroups(){
+	std::map<std::string, gpu_mem_group_t> groups;
+	
+	SDL_AtomicLock( &gMemory.lock );
+	std::map< std::pair<int, GLuint>, gpu_allocation_t >::iterator it;
+	for( it = gMemory.allocations.begin(); it != gMemory.allocations.end(); ++it ){
+		gpu_mem_group_t &group = groups[it->second.subsystem];
+		group.subsystem = it->second.subsystem;
+		group.allocations++;
+		group.bytes += it->second.bytes;
+	}
+	SDL_AtomicUnlock( &gMemory.lock );
+	
+	std::vector<gpu_mem_group_t> result;
+	std::map<std::string, gpu_mem_group_t>::iterator g;
+	for( g = groups.begin(); g != groups.end(); ++g )
+		result.push_back( g->second );
+	std::sort( result.begin(), result.end(), largerGroup );
+	return result;
+}
+
+void gpuMemoryReport(){
+	const float MB = 1024.0f * 1024.0f;
+	std::vector<gpu_mem_group_t> groups = gpuMemoryGroups();
+	
+	// copy the allocations out so printing doesn't hold the lock
+	SDL_AtomicLock( &gMemory.lock );
+	std::map< std::pair<int, GLuint>, gpu_allocation_t > allocations = gMemory.allocations;
+	size_t total = gMemory.total;
+	SDL_AtomicUnlock( &gMemory.lock );
+	
+	printf( "GPU MEMORY: %.2f MB in %u allocations\n", total / MB, (unsigned int)allocations.size() );
+	for( unsigned int i = 0; i < groups.size(); i++ ){
+		printf( "  %-16s %8.2f MB  %5.1f%%  (%u)\n", groups[i].subsystem.c_str(), groups[i].bytes / MB,
+				total ? 100.0f * groups[i].bytes / total : 0.0f, groups[i].allocations );
+		
+		std::map< std::pair<int, GLuint>, gpu_allocation_t >::iterator it;
+		for( it = allocations.begin(); it != allocations.end(); ++it ){
+			if( it->second.subsystem != groups[i].subsystem ) continue;
+			printf( "    %-12s %4u  %8.2f MB  %s\n", GPU_MEM_KIND_NAMES[it->first.first], it->first.second,
+					it->second.bytes / MB, it->second.label.c_str() );
+		}
+	}
+}
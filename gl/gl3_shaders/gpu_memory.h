@@ -0,0 +1,40 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+////// GPU_MEMORY HEADER //////////
+///////////////////////////////////
+
+// Book-keeping of every texture, renderbuffer and buffer we allocate, with an estimate of
+// its size, so we can see where GPU memory goes. Sizes are what the formats need, the
+// driver may pad them. Each allocation belongs to a subsystem ("render graph", "textures"...)
+// and the report sums them per subsystem.
+
+typedef enum {
+	GPU_MEM_TEXTURE,
+	GPU_MEM_RENDERBUFFER,
+	GPU_MEM_BUFFER,
+	GPU_MEM_KIND_COUNT
+} gpu_mem_kind_t;
+
+typedef struct {
+	std::string subsystem;
+	unsigned int allocations;
+	size_t bytes;
+} gpu_mem_group_t;
+
+unsigned int textureFormatBytes( GLenum format );	// bytes per pixel, sized or unsized internal format
+const char *textureFormatName( GLenum format );
+size_t textureBytes( GLenum format, unsigned int width, unsigned int height, unsigned int layers=1, bool mipmaps=false );
+
+// tracking the same object again replaces its entry, e.g. after a glTexImage2D resize
+void gpuMemoryTrack( gpu_mem_kind_t kind, GLuint name, const char *subsystem, const std::string &label, size_t bytes );
+void gpuMemoryUntrack( gpu_mem_kind_t kind, GLuint name );	// call before deleting the object
+
+size_t gpuMemoryTotal();
+std::vector<gpu_mem_group_t> gpuMemoryGroups();		// largest subsystem first
+void gpuMemoryReport();								// prints the groups and their allocations
+
+#endif
@@ -0,0 +1,267 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <map>
+
+//////////////////////////////////
+/////// GPU_PROFILER.CPP /////////
+//////////////////////////////////
+
+typedef struct {
+	unsigned int id;		// index into gProfiler.scopes
+	unsigned int begin;		// query indices within the frame's set
+	unsigned int end;
+} gpu_record_t;
+
+typedef struct {
+	GLuint queries[GPU_PROFILER_MAX_SCOPES * 2];
+	std::vector<gpu_record_t> records;
+	unsigned int used;		// queries issued
+	bool pending;			// issued, not read back yet
+} gpu_frame_t;
+
+typedef struct {
+	std::string name;
+	unsigned int depth;
+	std::vector<float> history;	// ring of GPU_PROFILER_HISTORY samples
+	unsigned int next;
+	double frameTotal;			// summed while reading one frame back
+} gpu_scope_t;
+
+struct gpu_profiler_t {
+	bool available;
+	gpu_frame_t frames[GPU_PROFILER_FRAMES];
+	unsigned int frame;
+	std::vector<unsigned int> stack;	// open records of the current frame
+	std::vector<gpu_scope_t> scopes;
+	std::map<std::string, unsigned int> ids;
+	unsigned int dropped;				// frames whose results weren't ready when their slot came round again
+	unsigned int sinceprint;
+};
+
+gpu_profiler_t gProfiler;						// used while no renderer installed its own
+thread_local gpu_profiler_t *tProfiler = NULL;	// queries of the context current on this thread
+
+inline gpu_profiler_t &currentGpuProfiler(){
+	return tProfiler ? *tProfiler : gProfiler;
+}
+
+gpu_profiler_t *gpuProfilerCreate(){
+	return new gpu_profiler_t();
+}
+
+void gpuProfilerDestroy( gpu_profiler_t *profiler ){
+	if( tProfiler == profiler ) tProfiler = NULL;
+	delete profiler;
+}
+
+void gpuProfilerMakeCurrent( gpu_profiler_t *profiler ){
+	tProfiler = profiler;
+}
+
+bool initGpuProfiler(){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !GLEW_VERSION_3_3 && !GLEW_ARB_timer_query ){
+		printf( "WARNING: Timer queries unavailable, GPU profiling disabled...\n" );
+		profiler.available = false;
+		return false;
+	}
+	
+	for( unsigned int i = 0; i < GPU_PROFILER_FRAMES; i++ ){
+		glGenQueries( GPU_PROFILER_MAX_SCOPES * 2, profiler.frames[i].queries );
+		profiler.frames[i].used = 0;
+		profiler.frames[i].pending = false;
+	}
+	profiler.frame = 0;
+	profiler.dropped = 0;
+	profiler.sinceprint = 0;
+	profiler.available = true;
+	
+	printf( "SUCCESS: GPU profiler started, %u frames of queries...\n", GPU_PROFILER_FRAMES );
+	return true;
+}
+
+void closeGpuProfiler(){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !profiler.available ) return;
+	for( unsigned int i = 0; i < GPU_PROFILER_FRAMES; i++ )
+		glDeleteQueries( GPU_PROFILER_MAX_SCOPES * 2, profiler.frames[i].queries );
+	profiler.available = false;
+}
+
+unsigned int scopeId( const char *name, unsigned int depth ){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	std::map<std::string, unsigned int>::iterator it = profiler.ids.find( name );
+	if( it != profiler.ids.end() ) return it->second;
+	
+	gpu_scope_t scope;
+	scope.name = name;
+	scope.depth = depth;
+	scope.next = 0;
+	scope.frameTotal = 0.0;
+	profiler.scopes.push_back( scope );
+	profiler.ids[name] = profiler.scopes.size() - 1;
+	return profiler.scopes.size() - 1;
+}
+
+// Collect a finished frame, or give up on it if the GPU isn't done yet
+void readFrame( gpu_frame_t &frame ){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !frame.pending ) return;
+	frame.pending = false;
+	if( frame.used == 0 ) return;
+	
+	// queries complete in order, if the last one is ready so is everything before it
+	GLint ready = 0;
+	glGetQueryObjectiv( frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &ready );
+	if( !ready ){
+		profiler.dropped++;
+		return;
+	}
+	
+	std::vector<GLuint64> times( frame.used );
+	for( unsigned int i = 0; i < frame.used; i++ )
+		glGetQueryObjectui64v( frame.queries[i], GL_QUERY_RESULT, &times[i] );
+	
+	std::vector<bool> seen( profiler.scopes.size(), false );
+	for( unsigned int i = 0; i < frame.records.size(); i++ ){
+		const gpu_record_t &r = frame.records[i];
+		if( !seen[r.id] ) profiler.scopes[r.id].frameTotal = 0.0;
+		seen[r.id] = true;
+		profiler.scopes[r.id].frameTotal += ( times[r.end] - times[r.begin] ) / 1000000.0;
+	}
+	
+	for( unsigned int id = 0; id < seen.size(); id++ ){
+		if( !seen[id] ) continue;
+		gpu_scope_t &scope = profiler.scopes[id];
+		if( scope.history.size() < GPU_PROFILER_HISTORY ) scope.history.push_back( scope.frameTotal );
+		else scope.history[scope.next] = scope.frameTotal;
+		scope.next = ( scope.next + 1 ) % GPU_PROFILER_HISTORY;
+	}
+}
+
+void gpuProfilerBeginFrame(){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !profiler.available ) return;
+	
+	// this slot was last used GPU_PROFILER_FRAMES frames ago
+	gpu_frame_t &frame = profiler.frames[profiler.frame % GPU_PROFILER_FRAMES];
+	readFrame( frame );
+	
+	frame.used = 0;
+	frame.records.clear();
+	profiler.stack.clear();
+	
+	gpuScopeBegin( "frame" );
+}
+
+void gpuProfilerEndFrame( bool print ){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !profiler.available ) return;
+	
+	while( !profiler.stack.empty() )
+		gpuScopeEnd();
+	
+	profiler.frames[profiler.frame % GPU_PROFILER_FRAMES].pending = true;
+	profiler.frame++;
+	
+	if( print && ++profiler.sinceprint >= GPU_PROFILER_PRINT_FRAMES ){
+		profiler.sinceprint = 0;
+		gpuProfilerPrint();
+	}
+}
+
+void gpuScopeBegin( const char *name ){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !profiler.available ) return;
+	gpu_frame_t &frame = profiler.frames[profiler.frame % GPU_PROFILER_FRAMES];
+	
+	// out of queries, the scope goes untimed (and so do its children, their end query would be missing)
+	if( frame.used + 2 > GPU_PROFILER_MAX_SCOPES * 2 ){
+		profiler.stack.push_back( (unsigned int)-1 );
+		return;
+	}
+	
+	gpu_record_t record;
+	record.id = scopeId( name, profiler.stack.size() );
+	record.begin = frame.used++;
+	record.end = frame.used++;		// reserved, issued by gpuScopeEnd()
+	glQueryCounter( frame.queries[record.begin], GL_TIMESTAMP );
+	
+	profiler.stack.push_back( frame.records.size() );
+	frame.records.push_back( record );
+}
+
+void gpuScopeEnd(){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	if( !profiler.available || profiler.stack.empty() ) return;
+	gpu_frame_t &frame = profiler.frames[profiler.frame % GPU_PROFILER_FRAMES];
+	
+	unsigned int index = profiler.stack.back();
+	profiler.stack.pop_back();
+	if( index == (unsigned int)-1 ) return;
+	
+	glQueryCounter( frame.queries[frame.records[index].end], GL_TIMESTAMP );
+}
+
+gpu_scope_stats_t makeStats( const gpu_scope_t &scope ){
+	gpu_scope_stats_t stats;
+	std::vector<float> sorted( scope.history );
+	
+	stats.name = scope.name;
+	stats.depth = scope.depth;
+	stats.samples = sorted.size();
+	stats.average = stats.p50 = stats.p95 = stats.p99 = 0.0f;
+	if( sorted.empty() ) return stats;
+	
+	std::sort( sorted.begin(), sorted.end() );
+	double sum = 0.0;
+	for( unsigned int i = 0; i < sorted.size(); i++ ) sum += sorted[i];
+	
+	stats.average = sum / sorted.size();
+	stats.p50 = sorted[( sorted.size() - 1 ) * 50 / 100];
+	stats.p95 = sorted[( sorted.size() - 1 ) * 95 / 100];
+	stats.p99 = sorted[( sorted.size() - 1 ) * 99 / 100];
+	return stats;
+}
+
+bool gpuProfilerStats( const char *name, gpu_scope_stats_t &stats ){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	std::map<std::string, unsigned int>::iterator it = profiler.ids.find( name );
+	if( it == profiler.ids.end() || profiler.scopes[it->second].history.empty() ) return false;
+	stats = makeStats( profiler.scopes[it->second] );
+	return true;
+}
+
+bool gpuProfilerLatest( const char *name, float &ms ){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	std::map<std::string, unsigned int>::iterator it = profiler.ids.find( name );
+	if( it == profiler.ids.end() || profiler.scopes[it->second].history.empty() ) return false;
+	
+	const gpu_scope_t &scope = profiler.scopes[it->second];
+	ms = scope.history[( scope.next + GPU_PROFILER_HISTORY - 1 ) % GPU_PROFILER_HISTORY];
+	return true;
+}
+
+std::vector<gpu_scope_stats_t> gpuProfilerAllStats(){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	std::vector<gpu_scope_stats_t> all;
+	for( unsigned int i = 0; i < profiler.scopes.size(); i++ )
+		if( !profiler.scopes[i].history.empty() ) all.push_back( makeStats( profiler.scopes[i] ) );
+	return all;
+}
+
+void gpuProfilerPrint(){
+	gpu_profiler_t &profiler = currentGpuProfiler();
+	std::vector<gpu_scope_stats_t> all = gpuProfilerAllStats();
+	
+	printf( "GPU PROFILE: last %u frames, %u dropped so far (ms)\n", GPU_PROFILER_HISTORY, profiler.dropped );
+	printf( "  %-24s %8s %8s %8s %8s\n", "scope", "avg", "p50", "p95", "p99" );
+	for( unsigned int i = 0; i < all.size(); i++ ){
+		std::string name = std::string( all[i].depth * 2, ' ' ) + all[i].name;
+		printf( "  %-24s %8.3f %8.3f %8.3f %8.3f\n", name.c_str(), all[i].average, all[i].p50, all[i].p95, all[i].p99 );
+	}
+}
@@ -0,0 +1,56 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+////// GPU_PROFILER HEADER ////////
+///////////////////////////////////
+
+// GPU time per named scope, from GL_TIMESTAMP queries. Each frame records into its own set
+// of query objects and results are read GPU_PROFILER_FRAMES frames later, once the GPU is
+// done with them - the CPU never waits on a query. Scopes may nest; scopes that share a
+// name within a frame are summed (every "blur" pass counts towards "blur").
+
+const unsigned int GPU_PROFILER_FRAMES = 4;			// frames in flight before readback
+const unsigned int GPU_PROFILER_MAX_SCOPES = 64;	// per frame
+const unsigned int GPU_PROFILER_HISTORY = 120;		// samples kept per scope
+const unsigned int GPU_PROFILER_PRINT_FRAMES = 300;	// print interval when printing is on
+
+typedef struct {
+	std::string name;
+	unsigned int depth;		// nesting level, 0 = the whole frame
+	unsigned int samples;	// frames in the history
+	float average;			// milliseconds
+	float p50;
+	float p95;
+	float p99;
+} gpu_scope_stats_t;
+
+// Query objects belong to a context, so does the history read from them. Each renderer
+// installs its own profiler with gpuProfilerMakeCurrent(), GpuScope then times into it.
+struct gpu_profiler_t;
+gpu_profiler_t *gpuProfilerCreate();
+void gpuProfilerDestroy( gpu_profiler_t *profiler );		// after closeGpuProfiler()
+void gpuProfilerMakeCurrent( gpu_profiler_t *profiler );	// this thread only, NULL for the default
+
+bool initGpuProfiler();				// false if timer queries are unavailable, everything else becomes a no-op
+void closeGpuProfiler();
+void gpuProfilerBeginFrame();		// opens the "frame" scope
+void gpuProfilerEndFrame( bool print );
+void gpuScopeBegin( const char *name );
+void gpuScopeEnd();
+
+bool gpuProfilerStats( const char *name, gpu_scope_stats_t &stats );	// false until the scope has samples
+bool gpuProfilerLatest( const char *name, float &ms );					// newest sample, GPU_PROFILER_FRAMES old
+std::vector<gpu_scope_stats_t> gpuProfilerAllStats();
+void gpuProfilerPrint();
+
+// times the enclosing block
+class GpuScope {
+public:
+	GpuScope( const char *name ) { gpuScopeBegin( name ); }
+	~GpuScope() { gpuScopeEnd(); }
+};
+
+#endif
@@ -0,0 +1,599 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "image_filters.h"
+#include "jobs.h"
+#include "cpu_profiler.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// the AVX2 rows are compiled for AVX2 on their own and only called when the CPU has it
+#if defined( __GNUC__ )
+#define FILTER_AVX2 __attribute__(( target( "avx2" ) ))
+#else
+#define FILTER_AVX2
+#endif
+
+//////////////////////////////////
+////// IMAGE_FILTERS.CPP /////////
+//////////////////////////////////
+
+// the shaders' constants
+const float GRAY_WEIGHTS[3] = { 0.2126f, 0.7152f, 0.0722f };
+const float QUANTIZE_LEVELS = 4.0f;
+const float KERNEL_BLUR[9] = {
+	1.0f / 16, 2.0f / 16, 1.0f / 16,
+	2.0f / 16, 4.0f / 16, 2.0f / 16,
+	1.0f / 16, 2.0f / 16, 1.0f / 16
+};
+const float KERNEL_SHARPEN[9] = {
+	-1.0f, -1.0f, -1.0f,
+	-1.0f,  9.0f, -1.0f,
+	-1.0f, -1.0f, -1.0f
+};
+const float GAUSS_WEIGHTS[5] = { 0.2270270270f, 0.1945945946f, 0.1216216216f, 0.0540540541f, 0.0162162162f };
+
+const unsigned int FILTER_PAD = 4;			// repeated edge pixels either side of a row, the gaussian's reach
+const unsigned int FILTER_BAND_ROWS = 32;	// rows per job
+const float INV_255 = 1.0f / 255.0f;
+
+const unsigned int FILTER_BENCH_RUNS = 10;
+
+// One implementation of each row operation per path. Rows are float RGBA, 'padded' ones
+// have FILTER_PAD repeated pixels before and after the width.
+typedef struct {
+	void (*load)( const image_t &image, unsigned int y, float *row );		// row points past the left padding
+	void (*store)( const float *row, const image_t &image, unsigned int y );
+	void (*grayscale)( float *row, unsigned int width );
+	void (*quantize)( float *row, unsigned int width );
+	void (*kernel)( const float *rows[3], const float *kernel, float *out, unsigned int width );
+	void (*gaussH)( const float *padded, float *out, unsigned int width );
+	void (*gaussV)( const float *rows[9], float *out, unsigned int width );	// rows -4 to +4
+} filter_rows_t;
+
+typedef struct {
+	bool ready;
+	bool avx2Available;
+	bool avx2;
+	std::vector< std::vector<float> > scratch;	// per job worker
+	std::vector<float> between;					// the gaussian's horizontal pass, whole image
+} image_filters_t;
+
+image_filters_t gFilters;
+
+image_t makeImage( void *pixels, unsigned int width, unsigned int height, image_format_t format, size_t pitch ){
+	image_t image;
+	image.pixels = pixels;
+	image.width = width;
+	image.height = height;
+	image.format = format;
+	image.pitch = pitch ? pitch : width * ( format == IMAGE_RGBA8 ? 4 : 4 * sizeof( float ) );
+	return image;
+}
+
+const char *imageFilterName( image_filter_t filter ){
+	switch( filter ){
+		case IMAGE_FILTER_GRAYSCALE: return "grayscale";
+		case IMAGE_FILTER_QUANTIZE: return "quantize";
+		case IMAGE_FILTER_BLUR: return "blur";
+		case IMAGE_FILTER_SHARPEN: return "sharpen";
+		case IMAGE_FILTER_GAUSSIAN: return "gaussian";
+		default: return "unknown";
+	}
+}
+
+image_filter_t findImageFilter( const char *name ){
+	for( int i = 0; i < IMAGE_FILTER_COUNT; i++ )
+		if( strcmp( name, imageFilterName( (image_filter_t)i ) ) == 0 ) return (image_filter_t)i;
+	return IMAGE_FILTER_COUNT;
+}
+
+void initImageFilters(){
+	if( gFilters.ready ) return;
+	gFilters.avx2Available = SDL_HasAVX2() == SDL_TRUE;
+	gFilters.avx2 = gFilters.avx2Available;
+	gFilters.ready = true;
+}
+
+void setImageFilterSimd( bool enable ){
+	initImageFilters();
+	gFilters.avx2 = enable && gFilters.avx2Available;
+}
+
+bool imageFilterSimd(){
+	initImageFilters();
+	return gFilters.avx2;
+}
+
+inline const uint8_t *imageRow( const image_t &image, unsigned int y ){
+	return (const uint8_t*)image.pixels + y * image.pitch;
+}
+
+void padRow( float *row, unsigned int width ){
+	for( unsigned int i = 1; i <= FILTER_PAD; i++ ){
+		memcpy( row - i * 4, row, 4 * sizeof( float ) );
+		memcpy( row + ( width - 1 + i ) * 4, row + ( width - 1 ) * 4, 4 * sizeof( float ) );
+	}
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=- plain rows -=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Written like the shaders, the AVX2 rows below add in the same order
+
+void loadRowPlain( const image_t &image, unsigned int y, float *row ){
+	const uint8_t *src = imageRow( image, y );
+	if( image.format == IMAGE_RGBA32F ) memcpy( row, src, image.width * 4 * sizeof( float ) );
+	else for( unsigned int i = 0; i < image.width * 4; i++ ) row[i] = src[i] * INV_255;
+}
+
+// like a unorm8 render target: clamped, rounded to nearest
+inline uint8_t packUnorm8( float value ){
+	return (uint8_t)( std::min( std::max( value, 0.0f ), 1.0f ) * 255.0f + 0.5f );
+}
+
+void storeRowPlain( const float *row, const image_t &image, unsigned int y ){
+	uint8_t *dst = (uint8_t*)imageRow( image, y );
+	if( image.format == IMAGE_RGBA32F ) memcpy( dst, row, image.width * 4 * sizeof( float ) );
+	else for( unsigned int i = 0; i < image.width * 4; i++ ) dst[i] = packUnorm8( row[i] );
+}
+
+inline void grayscalePixel( float *p ){
+	float average = GRAY_WEIGHTS[0] * p[0] + GRAY_WEIGHTS[1] * p[1] + GRAY_WEIGHTS[2] * p[2];
+	p[0] = p[1] = p[2] = average;
+	p[3] = 1.0f;
+}
+
+void grayscaleRowPlain( float *row, unsigned int width ){
+	for( unsigned int x = 0; x < width; x++ ) grayscalePixel( row + x * 4 );
+}
+
+// int() in GLSL truncates towards zero
+inline void quantizePixel( float *p ){
+	for( int c = 0; c < 3; c++ ) p[c] = truncf( p[c] * QUANTIZE_LEVELS ) / QUANTIZE_LEVELS;
+	p[3] = 1.0f;
+}
+
+void quantizeRowPlain( float *row, unsigned int width ){
+	for( unsigned int x = 0; x < width; x++ ) quantizePixel( row + x * 4 );
+}
+
+inline void kernelPixel( const float *rows[3], const float *kernel, float *out, unsigned int x ){
+	for( int c = 0; c < 3; c++ ){
+		float sum = 0.0f;
+		for( int i = 0; i < 9; i++ ) sum = sum + rows[i / 3][( (int)x + i % 3 - 1 ) * 4 + c] * kernel[i];
+		out[x * 4 + c] = sum;
+	}
+	out[x * 4 + 3] = 1.0f;
+}
+
+void kernelRowPlain( const float *rows[3], const float *kernel, float *out, unsigned int width ){
+	for( unsigned int x = 0; x < width; x++ ) kernelPixel( rows, kernel, out, x );
+}
+
+inline void gaussHPixel( const float *padded, float *out, unsigned int x ){
+	const float *p = padded + x * 4;
+	for( int c = 0; c < 3; c++ ){
+		float sum = p[c] * GAUSS_WEIGHTS[0];
+		for( int i = 1; i < 5; i++ ){
+			sum = sum + p[i * 4 + c] * GAUSS_WEIGHTS[i];
+			sum = sum + p[-i * 4 + c] * GAUSS_WEIGHTS[i];
+		}
+		out[x * 4 + c] = sum;
+	}
+	out[x * 4 + 3] = 1.0f;
+}
+
+void gaussHRowPlain( const float *padded, float *out, unsigned int width ){
+	for( unsigned int x = 0; x < width; x++ ) gaussHPixel( padded, out, x );
+}
+
+inline void gaussVPixel( const float *rows[9], float *out, unsigned int x ){
+	for( int c = 0; c < 3; c++ ){
+		unsigned int o = x * 4 + c;
+		float sum = rows[4][o] * GAUSS_WEIGHTS[0];
+		for( int i = 1; i < 5; i++ ){
+			sum = sum + rows[4 + i][o] * GAUSS_WEIGHTS[i];
+			sum = sum + rows[4 - i][o] * GAUSS_WEIGHTS[i];
+		}
+		out[o] = sum;
+	}
+	out[x * 4 + 3] = 1.0f;
+}
+
+void gaussVRowPlain( const float *rows[9], float *out, unsigned int width ){
+	for( unsigned int x = 0; x < width; x++ ) gaussVPixel( rows, out, x );
+}
+
+const filter_rows_t FILTER_ROWS_PLAIN = {
+	loadRowPlain, storeRowPlain, grayscaleRowPlain, quantizeRowPlain, kernelRowPlain, gaussHRowPlain, gaussVRowPlain
+};
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=- AVX2 rows -=-=-=-=-=-=
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Two RGBA pixels per register, an odd last pixel goes through the plain code
+
+FILTER_AVX2 inline __m256 withAlphaOne( __m256 v ){
+	return _mm256_blend_ps( v, _mm256_set1_ps( 1.0f ), 0x88 );
+}
+
+FILTER_AVX2 void loadRowAvx2( const image_t &image, unsigned int y, float *row ){
+	const uint8_t *src = imageRow( image, y );
+	if( image.format == IMAGE_RGBA32F ){
+		memcpy( row, src, image.width * 4 * sizeof( float ) );
+		return;
+	}
+
+	const __m256 scale = _mm256_set1_ps( INV_255 );
+	unsigned int x = 0;
+	for( ; x + 2 <= image.width; x += 2 ){
+		__m256i texels = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)( src + x * 4 ) ) );
+		_mm256_storeu_ps( row + x * 4, _mm256_mul_ps( _mm256_cvtepi32_ps( texels ), scale ) );
+	}
+	for( unsigned int i = x * 4; i < image.width * 4; i++ ) row[i] = src[i] * INV_255;
+}
+
+FILTER_AVX2 void storeRowAvx2( const float *row, const image_t &image, unsigned int y ){
+	uint8_t *dst = (uint8_t*)imageRow( image, y );
+	if( image.format == IMAGE_RGBA32F ){
+		memcpy( dst, row, image.width * 4 * sizeof( float ) );
+		return;
+	}
+
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps( 1.0f );
+	const __m256 scale = _mm256_set1_ps( 255.0f ), half = _mm256_set1_ps( 0.5f );
+	// the packs work inside 128 bit lanes, this puts pixels 0 1 2 3 back in order
+	const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+	unsigned int x = 0;
+	for( ; x + 4 <= image.width; x += 4 ){
+		__m256 a = _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( row + x * 4 ), zero ), one );
+		__m256 b = _mm256_min_ps( _mm256_max_ps( _mm256_loadu_ps( row + x * 4 + 8 ), zero ), one );
+		__m256i ia = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( a, scale ), half ) );
+		__m256i ib = _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( b, scale ), half ) );
+		__m256i words = _mm256_packus_epi32( ia, ib );
+		__m256i bytes = _mm256_packus_epi16( words, words );
+		bytes = _mm256_permutevar8x32_epi32( bytes, order );
+		_mm_storeu_si128( (__m128i*)( dst + x * 4 ), _mm256_castsi256_si128( bytes ) );
+	}
+	for( unsigned int i = x * 4; i < image.width * 4; i++ ) dst[i] = packUnorm8( row[i] );
+}
+
+FILTER_AVX2 void grayscaleRowAvx2( float *row, unsigned int width ){
+	const __m256 weights = _mm256_setr_ps( GRAY_WEIGHTS[0], GRAY_WEIGHTS[1], GRAY_WEIGHTS[2], 0.0f,
+										   GRAY_WEIGHTS[0], GRAY_WEIGHTS[1], GRAY_WEIGHTS[2], 0.0f );
+	unsigned int x = 0;
+	for( ; x + 2 <= width; x += 2 ){
+		__m256 v = _mm256_mul_ps( _mm256_loadu_ps( row + x * 4 ), weights );
+		v = _mm256_hadd_ps( v, v );		// r+g, b+0 per pixel
+		v = _mm256_hadd_ps( v, v );		// the sum in all four
+		_mm256_storeu_ps( row + x * 4, withAlphaOne( v ) );
+	}
+	if( x < width ) grayscalePixel( row + x * 4 );
+}
+
+FILTER_AVX2 void quantizeRowAvx2( float *row, unsigned int width ){
+	const __m256 levels = _mm256_set1_ps( QUANTIZE_LEVELS );
+	unsigned int x = 0;
+	for( ; x + 2 <= width; x += 2 ){
+		__m256 v = _mm256_round_ps( _mm256_mul_ps( _mm256_loadu_ps( row + x * 4 ), levels ), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC );
+		_mm256_storeu_ps( row + x * 4, withAlphaOne( _mm256_div_ps( v, levels ) ) );
+	}
+	if( x < width ) quantizePixel( row + x * 4 );
+}
+
+FILTER_AVX2 void kernelRowAvx2( const float *rows[3], const float *kernel, float *out, unsigned int width ){
+	__m256 k[9];
+	for( int i = 0; i < 9; i++ ) k[i] = _mm256_set1_ps( kernel[i] );
+
+	unsigned int x = 0;
+	for( ; x + 2 <= width; x += 2 ){
+		__m256 sum = _mm256_setzero_ps();
+		for( int i = 0; i < 9; i++ )
+			sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_loadu_ps( rows[i / 3] + ( (int)x + i % 3 - 1 ) * 4 ), k[i] ) );
+		_mm256_storeu_ps( out + x * 4, withAlphaOne( sum ) );
+	}
+	if( x < width ) kernelPixel( rows, kernel, out, x );
+}
+
+FILTER_AVX2 void gaussHRowAvx2( const float *padded, float *out, unsigned int width ){
+	__m256 w[5];
+	for( int i = 0; i < 5; i++ ) w[i] = _mm256_set1_ps( GAUSS_WEIGHTS[i] );
+
+	unsigned int x = 0;
+	for( ; x + 2 <= width; x += 2 ){
+		const float *p = padded + x * 4;
+		__m256 sum = _mm256_mul_ps( _mm256_loadu_ps( p ), w[0] );
+		for( int i = 1; i < 5; i++ ){
+			sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_loadu_ps( p + i * 4 ), w[i] ) );
+			sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_loadu_ps( p - i * 4 ), w[i] ) );
+		}
+		_mm256_storeu_ps( out + x * 4, withAlphaOne( sum ) );
+	}
+	if( x < width ) gaussHPixel( padded, out, x );
+}
+
+FILTER_AVX2 void gaussVRowAvx2( const float *rows[9], float *out, unsigned int width ){
+	__m256 w[5];
+	for( int i = 0; i < 5; i++ ) w[i] = _mm256_set1_ps( GAUSS_WEIGHTS[i] );
+
+	unsigned int x = 0;
+	for( ; x + 2 <= width; x += 2 ){
+		unsigned int o = x * 4;
+		__m256 sum = _mm256_mul_ps( _mm256_loadu_ps( rows[4] + o ), w[0] );
+		for( int i = 1; i < 5; i++ ){
+			sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_loadu_ps( rows[4 + i] + o ), w[i] ) );
+			sum = _mm256_add_ps( sum, _mm256_mul_ps( _mm256_loadu_ps( rows[4 - i] + o ), w[i] ) );
+		}
+		_mm256_storeu_ps( out + o, withAlphaOne( sum ) );
+	}
+	if( x < width ) gaussVPixel( rows, out, x );
+}
+
+const filter_rows_t FILTER_ROWS_AVX2 = {
+	loadRowAvx2, storeRowAvx2, grayscaleRowAvx2, quantizeRowAvx2, kernelRowAvx2, gaussHRowAvx2, gaussVRowAvx2
+};
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=- bands -=-=-=-=-=-=-=
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+void filterPointBand( const filter_rows_t &ops, image_filter_t filter, const image_t &src, const image_t &dst,
+					  unsigned int begin, unsigned int end, float *row ){
+	for( unsigned int y = begin; y < end; y++ ){
+		ops.load( src, y, row );
+		if( filter == IMAGE_FILTER_GRAYSCALE ) ops.grayscale( row, src.width );
+		else ops.quantize( row, src.width );
+		ops.store( row, dst, y );
+	}
+}
+
+// Three padded rows in a ring, each source row is converted once per band
+void filterKernelBand( const filter_rows_t &ops, const float *kernel, const image_t &src, const image_t &dst,
+					   unsigned int begin, unsigned int end, float *scratch ){
+	unsigned int rowFloats = ( src.width + 2 * FILTER_PAD ) * 4;
+	float *ring[3], *out = scratch + 3 * rowFloats;
+	int last = src.height - 1;
+
+	for( int i = 0; i < 3; i++ ){
+		ring[i] = scratch + i * rowFloats + FILTER_PAD * 4;
+		ops.load( src, std::min( std::max( (int)begin + i - 1, 0 ), last ), ring[i] );
+		padRow( ring[i], src.width );
+	}
+
+	for( unsigned int y = begin; y < end; y++ ){
+		const float *rows[3] = { ring[0], ring[1], ring[2] };
+		ops.kernel( rows, kernel, out, src.width );
+		ops.store( out, dst, y );
+
+		if( y + 1 < end ){
+			float *oldest = ring[0];
+			ring[0] = ring[1];
+			ring[1] = ring[2];
+			ring[2] = oldest;
+			ops.load( src, std::min( (int)y + 2, last ), ring[2] );
+			padRow( ring[2], src.width );
+		}
+	}
+}
+
+void filterGaussHBand( const filter_rows_t &ops, const image_t &src, unsigned int begin, unsigned int end, float *scratch ){
+	float *row = scratch + FILTER_PAD * 4;
+	for( unsigned int y = begin; y < end; y++ ){
+		ops.load( src, y, row );
+		padRow( row, src.width );
+		ops.gaussH( row, &gFilters.between[(size_t)y * src.width * 4], src.width );
+	}
+}
+
+void filterGaussVBand( const filter_rows_t &ops, const image_t &dst, unsigned int begin, unsigned int end, float *out ){
+	int last = dst.height - 1;
+	for( unsigned int y = begin; y < end; y++ ){
+		const float *rows[9];
+		for( int i = 0; i < 9; i++ )
+			rows[i] = &gFilters.between[(size_t)std::min( std::max( (int)y + i - 4, 0 ), last ) * dst.width * 4];
+		ops.gaussV( rows, out, dst.width );
+		ops.store( out, dst, y );
+	}
+}
+
+bool applyImageFilter( image_filter_t filter, const image_t &src, const image_t &dst ){
+	CPU_ZONE( "image filter" );
+	initImageFilters();
+
+	if( filter >= IMAGE_FILTER_COUNT || !src.pixels || !dst.pixels || src.width == 0 || src.height == 0 ){
+		printf( "ERROR: Bad image filter call!\n" );
+		return false;
+	}
+	if( src.width != dst.width || src.height != dst.height ){
+		printf( "ERROR: Image filter %s needs equal sizes, got %ux%u and %ux%u!\n", imageFilterName( filter ),
+				src.width, src.height, dst.width, dst.height );
+		return false;
+	}
+	bool pointFilter = filter == IMAGE_FILTER_GRAYSCALE || filter == IMAGE_FILTER_QUANTIZE;
+	if( !pointFilter && src.pixels == dst.pixels ){
+		printf( "ERROR: Image filter %s can't run in place!\n", imageFilterName( filter ) );
+		return false;
+	}
+
+	const filter_rows_t &ops = gFilters.avx2 ? FILTER_ROWS_AVX2 : FILTER_ROWS_PLAIN;
+
+	// three padded rows and an output row per worker, sized before any job runs
+	size_t scratchFloats = 4 * ( src.width + 2 * FILTER_PAD ) * 4;
+	if( gFilters.scratch.size() < jobWorkerCount() ) gFilters.scratch.resize( jobWorkerCount() );
+	for( unsigned int i = 0; i < gFilters.scratch.size(); i++ )
+		if( gFilters.scratch[i].size() < scratchFloats ) gFilters.scratch[i].resize( scratchFloats );
+
+	switch( filter ){
+		case IMAGE_FILTER_GRAYSCALE:
+		case IMAGE_FILTER_QUANTIZE:
+			parallelFor( src.height, FILTER_BAND_ROWS, [&]( unsigned int begin, unsigned int end, unsigned int worker ){
+				filterPointBand( ops, filter, src, dst, begin, end, &gFilters.scratch[worker][0] );
+			} );
+			break;
+
+		case IMAGE_FILTER_BLUR:
+		case IMAGE_FILTER_SHARPEN: {
+			const float *kernel = filter == IMAGE_FILTER_BLUR ? KERNEL_BLUR : KERNEL_SHARPEN;
+			parallelFor( src.height, FILTER_BAND_ROWS, [&]( unsigned int begin, unsigned int end, unsigned int worker ){
+				filterKernelBand( ops, kernel, src, dst, begin, end, &gFilters.scratch[worker][0] );
+			} );
+			break;
+		}
+
+		// the vertical pass reads rows from neighbouring bands, so the horizontal pass goes first
+		case IMAGE_FILTER_GAUSSIAN:
+			gFilters.between.resize( (size_t)src.width * src.height * 4 );
+			parallelFor( src.height, FILTER_BAND_ROWS, [&]( unsigned int begin, unsigned int end, unsigned int worker ){
+				filterGaussHBand( ops, src, begin, end, &gFilters.scratch[worker][0] );
+			} );
+			parallelFor( dst.height, FILTER_BAND_ROWS, [&]( unsigned int begin, unsigned int end, unsigned int worker ){
+				filterGaussVBand( ops, dst, begin, end, &gFilters.scratch[worker][0] );
+			} );
+			break;
+
+		default:
+			break;
+	}
+	return true;
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=- verification -=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// One pixel straight from the shader source: clamped texel fetches, no rows or bands
+void shaderPixel( image_filter_t filter, const image_t &src, int x, int y, float *out ){
+	auto texel = [&]( int tx, int ty, int c ){
+		tx = std::min( std::max( tx, 0 ), (int)src.width - 1 );
+		ty = std::min( std::max( ty, 0 ), (int)src.height - 1 );
+		return imageRow( src, ty )[tx * 4 + c] * INV_255;
+	};
+
+	for( int c = 0; c < 3; c++ ){
+		float color = texel( x, y, c );
+		switch( filter ){
+			case IMAGE_FILTER_GRAYSCALE:
+				out[c] = GRAY_WEIGHTS[0] * texel( x, y, 0 ) + GRAY_WEIGHTS[1] * texel( x, y, 1 ) + GRAY_WEIGHTS[2] * texel( x, y, 2 );
+				break;
+			case IMAGE_FILTER_QUANTIZE:
+				out[c] = (int)( color * QUANTIZE_LEVELS ) / QUANTIZE_LEVELS;
+				break;
+			case IMAGE_FILTER_BLUR:
+			case IMAGE_FILTER_SHARPEN:
+				out[c] = 0.0f;
+				for( int i = 0; i < 9; i++ )
+					out[c] += texel( x + i % 3 - 1, y + i / 3 - 1, c ) * ( filter == IMAGE_FILTER_BLUR ? KERNEL_BLUR : KERNEL_SHARPEN )[i];
+				break;
+			case IMAGE_FILTER_GAUSSIAN:
+				out[c] = 0.0f;
+				for( int j = -4; j <= 4; j++ ){
+					float across = 0.0f;
+					for( int i = -4; i <= 4; i++ ) across += texel( x + i, y + j, c ) * GAUSS_WEIGHTS[abs( i )];
+					out[c] += across * GAUSS_WEIGHTS[abs( j )];
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	out[3] = 1.0f;
+}
+
+// largest difference from the shader on every 8th row and the last, in 255ths
+int compareWithShader( image_filter_t filter, const image_t &src, const image_t &dst ){
+	int worst = 0;
+	for( unsigned int y = 0; y < src.height; y++ ){
+		if( y % 8 != 0 && y != src.height - 1 ) continue;
+		const uint8_t *row = imageRow( dst, y );
+		for( unsigned int x = 0; x < src.width; x++ ){
+			float expected[4];
+			shaderPixel( filter, src, x, y, expected );
+			for( int c = 0; c < 4; c++ )
+				worst = std::max( worst, abs( (int)row[x * 4 + c] - (int)packUnorm8( expected[c] ) ) );
+		}
+	}
+	return worst;
+}
+
+float largestDifference( const std::vector<float> &a, const std::vector<float> &b ){
+	float worst = 0.0f;
+	for( size_t i = 0; i < a.size(); i++ ) worst = std::max( worst, fabsf( a[i] - b[i] ) );
+	return worst;
+}
+
+double filterMPixPerSecond( image_filter_t filter, const image_t &src, const image_t &dst ){
+	Uint64 start = SDL_GetPerformanceCounter();
+	for( unsigned int i = 0; i < FILTER_BENCH_RUNS; i++ ) applyImageFilter( filter, src, dst );
+	double seconds = (double)( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency();
+	return (double)src.width * src.height * FILTER_BENCH_RUNS / seconds / 1000000.0;
+}
+
+/**
+-=-=-=-=-=- verifyImageFilters -=-=-=-=-=-
+Every filter on a noisy gradient, RGBA8 compared with the shader math and RGBA float
+compared between the paths, then both paths timed
+**/
+bool verifyImageFilters( unsigned int width, unsigned int height ){
+	initImageFilters();
+	bool avx2 = gFilters.avx2;
+	bool passed = true;
+
+	std::vector<uint8_t> bytes( (size_t)width * height * 4 ), bytesOut( bytes.size() );
+	std::vector<float> floats( bytes.size() ), floatsPlain( bytes.size() ), floatsAvx2( bytes.size() );
+	uint32_t seed = 12345;
+	for( size_t i = 0; i < bytes.size(); i++ ){
+		seed = seed * 1664525u + 1013904223u;
+		unsigned int x = ( i / 4 ) % width, y = ( i / 4 ) / width;
+		int value = (int)( ( x * 255 ) / width + ( y * 255 ) / height ) / 2 + (int)( seed >> 27 ) - 16;
+		bytes[i] = (uint8_t)std::min( std::max( value, 0 ), 255 );
+		// past 0 to 1, like a float render target can hold
+		floats[i] = bytes[i] * ( 1.5f / 255.0f ) - 0.25f;
+	}
+
+	image_t src8 = makeImage( &bytes[0], width, height, IMAGE_RGBA8 );
+	image_t dst8 = makeImage( &bytesOut[0], width, height, IMAGE_RGBA8 );
+	image_t srcF = makeImage( &floats[0], width, height, IMAGE_RGBA32F );
+	image_t plainF = makeImage( &floatsPlain[0], width, height, IMAGE_RGBA32F );
+	image_t avx2F = makeImage( &floatsAvx2[0], width, height, IMAGE_RGBA32F );
+
+	printf( "ATTEMPT: Checking image filters at %ux%u on %u threads, AVX2 %s...\n", width, height,
+			jobWorkerCount(), gFilters.avx2Available ? "available" : "not available" );
+
+	for( int f = 0; f < IMAGE_FILTER_COUNT; f++ ){
+		image_filter_t filter = (image_filter_t)f;
+
+		setImageFilterSimd( false );
+		applyImageFilter( filter, src8, dst8 );
+		int plainError = compareWithShader( filter, src8, dst8 );
+		applyImageFilter( filter, srcF, plainF );
+		double plainRate = filterMPixPerSecond( filter, src8, dst8 );
+
+		int avx2Error = 0;
+		float floatError = 0.0f;
+		double avx2Rate = 0.0;
+		if( gFilters.avx2Available ){
+			setImageFilterSimd( true );
+			applyImageFilter( filter, src8, dst8 );
+			avx2Error = compareWithShader( filter, src8, dst8 );
+			applyImageFilter( filter, srcF, avx2F );
+			floatError = largestDifference( floatsPlain, floatsAvx2 );
+			avx2Rate = filterMPixPerSecond( filter, src8, dst8 );
+		}
+
+		bool ok = plainError <= 1 && avx2Error <= 1 && floatError <= 1e-5f;
+		passed = passed && ok;
+		printf( "%s: %-9s  plain %7.1f MPix/s  AVX2 %7.1f MPix/s  off by %d/%d 255ths, float %g\n", ok ? "SUCCESS" : "ERROR",
+				imageFilterName( filter ), plainRate, avx2Rate, plainError, avx2Error, floatError );
+	}
+
+	setImageFilterSimd( avx2 );
+	return passed;
+}
@@ -0,0 +1,61 @@
+#ifndef IMAGE_FILTERS_H
+#define IMAGE_FILTERS_H
+
+#include <SDL2/SDL.h>
+#include <stddef.h>
+
+///////////////////////////////////
+////// IMAGE_FILTERS HEADER ///////
+///////////////////////////////////
+
+// The post effects of the shader folder on the CPU, for images that never see a GPU:
+//   grayscale  grayscale.txt		luminance, alpha 1
+//   quantize   fscreen.txt			4 levels per channel
+//   blur       POST_KERNELS		3x3 binomial (fconvolve.txt, cpost.txt)
+//   sharpen    POST_KERNELS		3x3, 9 in the middle
+//   gaussian   bloom blur			9 taps across, then 9 down (fconvolve.txt)
+// Edges repeat like GL_CLAMP_TO_EDGE, taps are one pixel apart as in the shaders. Inputs
+// are RGBA8 or float RGBA, and the output can be either. Filters work in float and round
+// like a unorm8 render target does, so the results match the shaders to one step in 255.
+//
+// Images are cut into bands of rows that run on the job threads. Each row goes through
+// AVX2 code when the CPU has it (checked once with SDL_HasAVX2), else through plain C++.
+// setImageFilterSimd( false ) forces the plain path, verifyImageFilters() compares the two.
+
+typedef enum {
+	IMAGE_RGBA8,
+	IMAGE_RGBA32F
+} image_format_t;
+
+typedef struct {
+	void *pixels;
+	unsigned int width, height;
+	size_t pitch;				// bytes per row
+	image_format_t format;
+} image_t;
+
+typedef enum {
+	IMAGE_FILTER_GRAYSCALE,
+	IMAGE_FILTER_QUANTIZE,
+	IMAGE_FILTER_BLUR,
+	IMAGE_FILTER_SHARPEN,
+	IMAGE_FILTER_GAUSSIAN,
+	IMAGE_FILTER_COUNT
+} image_filter_t;
+
+image_t makeImage( void *pixels, unsigned int width, unsigned int height, image_format_t format, size_t pitch=0 );	// 0 = rows packed
+
+// src and dst must be the same size, only the per pixel filters may run in place.
+// Not reentrant, filter from one thread at a time.
+bool applyImageFilter( image_filter_t filter, const image_t &src, const image_t &dst );
+
+const char *imageFilterName( image_filter_t filter );
+image_filter_t findImageFilter( const char *name );		// IMAGE_FILTER_COUNT if there's none
+
+void setImageFilterSimd( bool enable );		// ignored without AVX2
+bool imageFilterSimd();
+
+// every filter on a generated image, both paths compared and timed
+bool verifyImageFilters( unsigned int width, unsigned int height );
+
+#endif
@@ -0,0 +1,158 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "jobs.h"
+#include "cpu_profiler.h"
+#include <stdio.h>
+#include <vector>
+
+//////////////////////////
+/////// JOBS.CPP /////////
+//////////////////////////
+
+typedef struct {
+	std::vector<SDL_Thread*> threads;
+	SDL_mutex *lock;			// guards everything below except 'next'
+	SDL_mutex *submit;			// one parallelFor at a time
+	SDL_cond *wake;				// a new job was posted, or quit
+	SDL_cond *done;				// the last worker finished the job
+	unsigned int generation;	// bumped for every job
+	unsigned int active;		// workers still inside the current job
+	bool quit;
+	
+	const job_range_t *job;
+	unsigned int count;
+	unsigned int grain;
+	SDL_atomic_t next;			// first item of the next unclaimed chunk
+} job_system_t;
+
+job_system_t gJobs;
+
+void runChunks( unsigned int worker ){
+	for( ;; ){
+		unsigned int begin = (unsigned int)SDL_AtomicAdd( &gJobs.next, gJobs.grain );
+		if( begin >= gJobs.count ) break;
+		unsigned int end = begin + gJobs.grain;
+		if( end > gJobs.count ) end = gJobs.count;
+		CPU_ZONE( "job" );
+		(*gJobs.job)( begin, end, worker );
+	}
+}
+
+int jobWorker( void *data ){
+	unsigned int worker = (unsigned int)(size_t)data;
+	unsigned int seen = 0;
+	
+	CPU_PROFILER_THREAD( "worker" );
+	SDL_LockMutex( gJobs.lock );
+	for( ;; ){
+		while( !gJobs.quit && gJobs.generation == seen )
+			SDL_CondWait( gJobs.wake, gJobs.lock );
+		if( gJobs.quit ) break;
+		seen = gJobs.generation;
+		
+		SDL_UnlockMutex( gJobs.lock );
+		runChunks( worker );
+		SDL_LockMutex( gJobs.lock );
+		
+		if( --gJobs.active == 0 ) SDL_CondSignal( gJobs.done );
+	}
+	SDL_UnlockMutex( gJobs.lock );
+	CPU_PROFILER_THREAD_END();
+	return 0;
+}
+
+bool initJobs( unsigned int threads ){
+	if( gJobs.lock ) return true;
+	
+	if( threads == 0 ){
+		int cores = SDL_GetCPUCount();
+		threads = cores > 1 ? cores - 1 : 0;
+	}
+	if( threads > JOBS_MAX_THREADS ) threads = JOBS_MAX_THREADS;
+	
+	gJobs.lock = SDL_CreateMutex();
+	gJobs.submit = SDL_CreateMutex();
+	gJobs.wake = SDL_CreateCond();
+	gJobs.done = SDL_CreateCond();
+	gJobs.generation = 0;
+	gJobs.active = 0;
+	gJobs.quit = false;
+	
+	if( !gJobs.lock || !gJobs.submit || !gJobs.wake || !gJobs.done ){
+		printf( "ERROR: Could not create job system locks! SDL Error: %s\n", SDL_GetError() );
+		closeJobs();
+		return false;
+	}
+	
+	for( unsigned int i = 0; i < threads; i++ ){
+		SDL_Thread *thread = SDL_CreateThread( jobWorker, "worker", (void*)(size_t)( i + 1 ) );
+		if( thread == NULL ){
+			printf( "WARNING: Could only start %u of %u worker threads! SDL Error: %s\n", i, threads, SDL_GetError() );
+			break;
+		}
+		gJobs.threads.push_back( thread );
+	}
+	
+	printf( "SUCCESS: Job system started with %u worker threads...\n", (unsigned int)gJobs.threads.size() );
+	return true;
+}
+
+void closeJobs(){
+	if( gJobs.lock ){
+		SDL_LockMutex( gJobs.lock );
+		gJobs.quit = true;
+		SDL_CondBroadcast( gJobs.wake );
+		SDL_UnlockMutex( gJobs.lock );
+	}
+	
+	for( unsigned int i = 0; i < gJobs.threads.size(); i++ )
+		SDL_WaitThread( gJobs.threads[i], NULL );
+	gJobs.threads.clear();
+	
+	if( gJobs.done ) SDL_DestroyCond( gJobs.done );
+	if( gJobs.wake ) SDL_DestroyCond( gJobs.wake );
+	if( gJobs.submit ) SDL_DestroyMutex( gJobs.submit );
+	if( gJobs.lock ) SDL_DestroyMutex( gJobs.lock );
+	gJobs.done = gJobs.wake = NULL;
+	gJobs.submit = gJobs.lock = NULL;
+}
+
+unsigned int jobWorkerCount(){
+	return gJobs.threads.size() + 1;
+}
+
+void parallelFor( unsigned int count, unsigned int grain, const job_range_t &job ){
+	if( count == 0 ) return;
+	if( grain == 0 ) grain = 1;
+	
+	// not worth waking anyone up
+	if( gJobs.threads.empty() || count <= grain ){
+		for( unsigned int begin = 0; begin < count; begin += grain )
+			job( begin, begin + grain < count ? begin + grain : count, 0 );
+		return;
+	}
+	
+	SDL_LockMutex( gJobs.submit );
+	
+	SDL_LockMutex( gJobs.lock );
+	gJobs.job = &job;
+	gJobs.count = count;
+	gJobs.grain = grain;
+	SDL_AtomicSet( &gJobs.next, 0 );
+	gJobs.active = gJobs.threads.size();
+	gJobs.generation++;
+	SDL_CondBroadcast( gJobs.wake );
+	SDL_UnlockMutex( gJobs.lock );
+	
+	// the calling thread works too, instead of just waiting
+	runChunks( 0 );
+	
+	SDL_LockMutex( gJobs.lock );
+	while( gJobs.active > 0 )
+		SDL_CondWait( gJobs.done, gJobs.lock );
+	SDL_UnlockMutex( gJobs.lock );
+	
+	SDL_UnlockMutex( gJobs.submit );
+}
@@ -0,0 +1,26 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <SDL2/SDL.h>
+#include <functional>
+
+///////////////////////////////////
+/////////// JOBS HEADER ///////////
+///////////////////////////////////
+
+// Small worker pool over SDL threads. parallelFor() splits [0, count) into chunks of
+// 'grain' items that the workers and the calling thread pull until none are left, and
+// returns once all of them are done. The worker index handed to the job (0 is the calling
+// thread) lets each thread write to its own buffer without locking.
+// No GL calls from jobs - the context belongs to the thread that made it current.
+
+typedef std::function<void( unsigned int begin, unsigned int end, unsigned int worker )> job_range_t;
+
+const unsigned int JOBS_MAX_THREADS = 15;
+
+bool initJobs( unsigned int threads=0 );	// 0 = one per core, besides the calling thread
+void closeJobs();
+unsigned int jobWorkerCount();				// worker indices in use, calling thread included
+void parallelFor( unsigned int count, unsigned int grain, const job_range_t &job );
+
+#endif
@@ -0,0 +1,380 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "light_clusters.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "jobs.h"
+#include "cpu_profiler.h"
+#include <algorithm>
+#include <stdint.h>
+
+//////////////////////////////////
+////// LIGHT_CLUSTERS.CPP ////////
+//////////////////////////////////
+
+typedef enum {
+	CLUSTER_BUFFER_LIGHTS,
+	CLUSTER_BUFFER_GRID,
+	CLUSTER_BUFFER_INDICES,
+	CLUSTER_BUFFER_COUNT
+} cluster_buffer_t;
+
+// clusters a light touches, inclusive
+typedef struct {
+	unsigned int x0, x1, y0, y1, z0, z1;
+	bool visible;
+} cluster_range_t;
+
+struct light_clusters_t {
+	bool ready;
+	std::vector<point_light_t> lights;
+	std::vector<glm::vec4> lightTexels;			// what goes to lightData, 2 per light
+	std::vector<glm::vec4> viewLights;			// view space center, radius
+	std::vector<cluster_range_t> ranges;		// per light
+	std::vector< std::vector<uint32_t> > slices;	// lights touching each depth slice
+	std::vector< std::vector<uint32_t> > lists;	// per cluster, capacity kept between frames
+	std::vector<glm::vec3> boundsMin;			// view space box of each cluster
+	std::vector<glm::vec3> boundsMax;
+	glm::mat4 boundsProj;						// what the boxes were built for
+	float boundsFar;
+	std::vector<uint32_t> grid;					// first, count per cluster
+	std::vector<uint32_t> indices;
+	GLuint buffers[CLUSTER_BUFFER_COUNT];
+	GLuint textures[CLUSTER_BUFFER_COUNT];
+	float nearPlane;
+	float sliceScale;
+	light_cluster_stats_t stats;
+};
+
+light_clusters_t gClusters;							// used while no renderer installed its own
+thread_local light_clusters_t *tClusters = NULL;	// the calling thread's, job workers never see it
+
+inline light_clusters_t &currentLightClusters(){
+	return tClusters ? *tClusters : gClusters;
+}
+
+light_clusters_t *lightClustersCreate(){
+	return new light_clusters_t();
+}
+
+void lightClustersDestroy( light_clusters_t *clusters ){
+	if( tClusters == clusters ) tClusters = NULL;
+	delete clusters;
+}
+
+void lightClustersMakeCurrent( light_clusters_t *clusters ){
+	tClusters = clusters;
+}
+
+const GLenum CLUSTER_BUFFER_FORMATS[CLUSTER_BUFFER_COUNT] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+const size_t CLUSTER_BUFFER_SIZES[CLUSTER_BUFFER_COUNT] = {
+	CLUSTER_MAX_LIGHTS * 2 * sizeof( glm::vec4 ),
+	CLUSTER_COUNT * 2 * sizeof( uint32_t ),
+	CLUSTER_MAX_INDICES * sizeof( uint32_t )
+};
+const char *CLUSTER_BUFFER_NAMES[CLUSTER_BUFFER_COUNT] = { "light data", "cluster grid", "light indices" };
+
+bool initLightClusters(){
+	light_clusters_t &clusters = currentLightClusters();
+	clusters.ready = false;
+
+	// texture buffers are core since 3.1
+	if( !GLEW_VERSION_3_1 && !GLEW_ARB_texture_buffer_object ){
+		printf( "WARNING: Texture buffers unavailable, clustered lights disabled...\n" );
+		return false;
+	}
+
+	glGenBuffers( CLUSTER_BUFFER_COUNT, clusters.buffers );
+	glGenTextures( CLUSTER_BUFFER_COUNT, clusters.textures );
+	for( unsigned int i = 0; i < CLUSTER_BUFFER_COUNT; i++ ){
+		glBindBuffer( GL_TEXTURE_BUFFER, clusters.buffers[i] );
+		glBufferData( GL_TEXTURE_BUFFER, CLUSTER_BUFFER_SIZES[i], NULL, GL_STREAM_DRAW );
+		stateBindTexture( 0, GL_TEXTURE_BUFFER, clusters.textures[i] );
+		glTexBuffer( GL_TEXTURE_BUFFER, CLUSTER_BUFFER_FORMATS[i], clusters.buffers[i] );
+		gpuMemoryTrack( GPU_MEM_BUFFER, clusters.buffers[i], "lights", CLUSTER_BUFFER_NAMES[i], CLUSTER_BUFFER_SIZES[i] );
+	}
+	glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+
+	clusters.lists.resize( CLUSTER_COUNT );
+	clusters.slices.resize( CLUSTER_Z );
+	clusters.boundsMin.resize( CLUSTER_COUNT );
+	clusters.boundsMax.resize( CLUSTER_COUNT );
+	clusters.boundsFar = 0.0f;
+	clusters.grid.assign( CLUSTER_COUNT * 2, 0 );
+	clusters.nearPlane = 1.0f;
+	clusters.sliceScale = 1.0f;
+	clusters.stats = light_cluster_stats_t();
+	clusters.ready = true;
+
+	printf( "SUCCESS: Clustered lights ready, %u x %u x %u clusters...\n", CLUSTER_X, CLUSTER_Y, CLUSTER_Z );
+	return true;
+}
+
+void closeLightClusters(){
+	light_clusters_t &clusters = currentLightClusters();
+	if( !clusters.ready ) return;
+
+	for( unsigned int i = 0; i < CLUSTER_BUFFER_COUNT; i++ ){
+		stateForgetTexture( clusters.textures[i] );
+		gpuMemoryUntrack( GPU_MEM_BUFFER, clusters.buffers[i] );
+	}
+	glDeleteTextures( CLUSTER_BUFFER_COUNT, clusters.textures );
+	glDeleteBuffers( CLUSTER_BUFFER_COUNT, clusters.buffers );
+	clusters.ready = false;
+}
+
+// 0..1
+float clusterRandom( unsigned int &seed ){
+	seed = seed * 1103515245 + 12345;
+	return ( ( seed >> 8 ) & 0xFFFF ) / 65535.0f;
+}
+
+void setClusterLights( unsigned int count, const glm::vec3 &boxMin, const glm::vec3 &boxMax ){
+	light_clusters_t &clusters = currentLightClusters();
+	unsigned int seed = 2024;
+	count = std::min( count, CLUSTER_MAX_LIGHTS );
+
+	clusters.lights.resize( count );
+	for( unsigned int i = 0; i < count; i++ ){
+		point_light_t &light = clusters.lights[i];
+		light.position = glm::vec3( boxMin.x + clusterRandom( seed ) * ( boxMax.x - boxMin.x ),
+									boxMin.y + clusterRandom( seed ) * ( boxMax.y - boxMin.y ),
+									boxMin.z + clusterRandom( seed ) * ( boxMax.z - boxMin.z ) );
+		light.radius = 4.0f + clusterRandom( seed ) * 6.0f;
+
+		// saturated colors, one channel kept low
+		glm::vec3 color( clusterRandom( seed ), clusterRandom( seed ), clusterRandom( seed ) );
+		color[i % 3] *= 0.2f;
+		light.color = color * 2.0f;
+		light.phase = clusterRandom( seed ) * 6.2831853f;
+	}
+
+	clusters.lightTexels.resize( count * 2 );
+	clusters.viewLights.resize( count );
+	clusters.ranges.resize( count );
+}
+
+unsigned int clusterLightCount(){
+	return currentLightClusters().lights.size();
+}
+
+// slice holding a view space distance, may be out of range
+inline int clusterSlice( const light_clusters_t &clusters, float depth ){
+	return (int)floorf( logf( depth / clusters.nearPlane ) * clusters.sliceScale );
+}
+
+inline unsigned int clampCluster( int v, unsigned int size ){
+	return v < 0 ? 0 : ( v >= (int)size ? size - 1 : (unsigned int)v );
+}
+
+// Clusters covered by the light's sphere: depth slices from its near and far extent, tiles from
+// the screen rectangle of its bounding box. Conservative, the shader still tests the radius.
+// Runs on the job workers, so the clusters are handed in rather than looked up.
+cluster_range_t clusterRange( const light_clusters_t &clusters, const glm::vec3 &center, float radius, const glm::mat4 &proj, float nearPlane, float farPlane ){
+	cluster_range_t range;
+	range.visible = false;
+
+	float zNear = -center.z - radius;
+	float zFar = -center.z + radius;
+	if( zFar < nearPlane || zNear > farPlane ) return range;
+
+	float x0 = -1.0f, y0 = -1.0f, x1 = 1.0f, y1 = 1.0f;
+
+	// crossing the near plane the box can't be projected, it covers the whole screen then
+	if( zNear > nearPlane ){
+		x0 = y0 = 1.0f;
+		x1 = y1 = -1.0f;
+		for( int i = 0; i < 8; i++ ){
+			glm::vec4 corner( center.x + ( i & 1 ? radius : -radius ),
+							  center.y + ( i & 2 ? radius : -radius ),
+							  center.z + ( i & 4 ? radius : -radius ), 1.0f );
+			glm::vec4 clip = proj * corner;
+			float nx = clip.x / clip.w, ny = clip.y / clip.w;
+			x0 = std::min( x0, nx );
+			x1 = std::max( x1, nx );
+			y0 = std::min( y0, ny );
+			y1 = std::max( y1, ny );
+		}
+		if( x0 > 1.0f || x1 < -1.0f || y0 > 1.0f || y1 < -1.0f ) return range;
+	}
+
+	range.x0 = clampCluster( (int)floorf( ( x0 * 0.5f + 0.5f ) * CLUSTER_X ), CLUSTER_X );
+	range.x1 = clampCluster( (int)floorf( ( x1 * 0.5f + 0.5f ) * CLUSTER_X ), CLUSTER_X );
+	range.y0 = clampCluster( (int)floorf( ( y0 * 0.5f + 0.5f ) * CLUSTER_Y ), CLUSTER_Y );
+	range.y1 = clampCluster( (int)floorf( ( y1 * 0.5f + 0.5f ) * CLUSTER_Y ), CLUSTER_Y );
+	range.z0 = clampCluster( clusterSlice( clusters, std::max( zNear, nearPlane ) ), CLUSTER_Z );
+	range.z1 = clampCluster( clusterSlice( clusters, std::min( zFar, farPlane ) ), CLUSTER_Z );
+	range.visible = true;
+	return range;
+}
+
+// View space boxes around each cluster, only redone when the projection or depth range changes
+void buildClusterBounds( light_clusters_t &clusters, const glm::mat4 &proj, float nearPlane, float farPlane ){
+	if( clusters.boundsProj == proj && clusters.boundsFar == farPlane && clusters.nearPlane == nearPlane ) return;
+	clusters.boundsProj = proj;
+	clusters.boundsFar = farPlane;
+	glm::mat4 invProj = glm::inverse( proj );
+	
+	for( unsigned int z = 0; z < CLUSTER_Z; z++ ){
+		float depths[2] = { nearPlane * expf( z / clusters.sliceScale ), nearPlane * expf( ( z + 1 ) / clusters.sliceScale ) };
+		for( unsigned int y = 0; y < CLUSTER_Y; y++ ){
+			for( unsigned int x = 0; x < CLUSTER_X; x++ ){
+				unsigned int c = x + y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y;
+				glm::vec3 lo( 1e30f, 1e30f, 1e30f ), hi( -1e30f, -1e30f, -1e30f );
+				
+				// the tile's corner rays, cut at both ends of the slice
+				for( int i = 0; i < 8; i++ ){
+					float nx = ( x + ( i & 1 ) ) * 2.0f / CLUSTER_X - 1.0f;
+					float ny = ( y + ( ( i >> 1 ) & 1 ) ) * 2.0f / CLUSTER_Y - 1.0f;
+					glm::vec4 ray = invProj * glm::vec4( nx, ny, -1.0f, 1.0f );
+					glm::vec3 p = glm::vec3( ray ) / ray.w;
+					p *= depths[i >> 2] / -p.z;
+					lo = glm::vec3( std::min( lo.x, p.x ), std::min( lo.y, p.y ), std::min( lo.z, p.z ) );
+					hi = glm::vec3( std::max( hi.x, p.x ), std::max( hi.y, p.y ), std::max( hi.z, p.z ) );
+				}
+				clusters.boundsMin[c] = lo;
+				clusters.boundsMax[c] = hi;
+			}
+		}
+	}
+}
+
+inline bool sphereTouchesCluster( const light_clusters_t &clusters, const glm::vec4 &sphere, unsigned int c ){
+	const glm::vec3 &lo = clusters.boundsMin[c], &hi = clusters.boundsMax[c];
+	float dx = std::max( std::max( lo.x - sphere.x, sphere.x - hi.x ), 0.0f );
+	float dy = std::max( std::max( lo.y - sphere.y, sphere.y - hi.y ), 0.0f );
+	float dz = std::max( std::max( lo.z - sphere.z, sphere.z - hi.z ), 0.0f );
+	return dx * dx + dy * dy + dz * dz < sphere.w * sphere.w;
+}
+
+void updateLightClusters( float time, const glm::mat4 &view, const glm::mat4 &proj, float nearPlane, float farPlane ){
+	light_clusters_t &clusters = currentLightClusters();
+	if( !clusters.ready ) return;
+	CPU_ZONE( "updateLightClusters" );
+	Uint64 start = SDL_GetPerformanceCounter();
+	unsigned int count = clusters.lights.size();
+
+	clusters.sliceScale = CLUSTER_Z / logf( farPlane / nearPlane );
+	buildClusterBounds( clusters, proj, nearPlane, farPlane );
+	clusters.nearPlane = nearPlane;
+
+	// ANIMATE AND BOUND:
+	// Bob the lights up and down, then find each one's cluster range in view space
+	parallelFor( count, 256, [&]( unsigned int begin, unsigned int end, unsigned int ){
+		for( unsigned int i = begin; i < end; i++ ){
+			const point_light_t &light = clusters.lights[i];
+			glm::vec3 pos = light.position + glm::vec3( 0.0f, sinf( time * 2.0f + light.phase ) * 1.5f, 0.0f );
+			clusters.lightTexels[i * 2] = glm::vec4( pos, light.radius );
+			clusters.lightTexels[i * 2 + 1] = glm::vec4( light.color, 0.0f );
+
+			glm::vec3 center = glm::vec3( view * glm::vec4( pos, 1.0f ) );
+			clusters.viewLights[i] = glm::vec4( center, light.radius );
+			clusters.ranges[i] = clusterRange( clusters, center, light.radius, proj, nearPlane, farPlane );
+		}
+	} );
+
+	// BIN:
+	// Lights per depth slice, so a row of clusters only looks at lights that can reach it
+	for( unsigned int z = 0; z < CLUSTER_Z; z++ )
+		clusters.slices[z].clear();
+	for( unsigned int i = 0; i < count; i++ ){
+		const cluster_range_t &r = clusters.ranges[i];
+		if( !r.visible ) continue;
+		for( unsigned int z = r.z0; z <= r.z1; z++ )
+			clusters.slices[z].push_back( i );
+	}
+
+	// ASSIGN:
+	// One job per row of tiles in a slice, so every cluster list has one writer. The screen
+	// rectangle narrows down the tiles, the sphere is then tested against each cluster's box.
+	// Lights are visited in order, the lists come out the same whatever the thread count.
+	parallelFor( CLUSTER_Y * CLUSTER_Z, 4, [&]( unsigned int begin, unsigned int end, unsigned int ){
+		for( unsigned int row = begin; row < end; row++ ){
+			unsigned int y = row % CLUSTER_Y, z = row / CLUSTER_Y;
+			std::vector<uint32_t> *lists = &clusters.lists[row * CLUSTER_X];
+			const std::vector<uint32_t> &slice = clusters.slices[z];
+			for( unsigned int x = 0; x < CLUSTER_X; x++ )
+				lists[x].clear();
+
+			for( unsigned int j = 0; j < slice.size(); j++ ){
+				unsigned int i = slice[j];
+				const cluster_range_t &r = clusters.ranges[i];
+				if( y < r.y0 || y > r.y1 ) continue;
+				for( unsigned int x = r.x0; x <= r.x1; x++ )
+					if( sphereTouchesCluster( clusters, clusters.viewLights[i], row * CLUSTER_X + x ) ) lists[x].push_back( i );
+			}
+		}
+	} );
+
+	// FLATTEN:
+	// Cluster lists back to back, grid holds where each one starts
+	light_cluster_stats_t &stats = clusters.stats;
+	unsigned int used = 0;
+	stats.lights = count;
+	stats.visible = 0;
+	stats.maxPerCluster = 0;
+	stats.overflow = false;
+	clusters.indices.clear();
+
+	for( unsigned int c = 0; c < CLUSTER_COUNT; c++ ){
+		const std::vector<uint32_t> &list = clusters.lists[c];
+		unsigned int n = list.size();
+		if( clusters.indices.size() + n > CLUSTER_MAX_INDICES ){
+			n = CLUSTER_MAX_INDICES - clusters.indices.size();
+			stats.overflow = true;
+		}
+		clusters.grid[c * 2] = clusters.indices.size();
+		clusters.grid[c * 2 + 1] = n;
+		clusters.indices.insert( clusters.indices.end(), list.begin(), list.begin() + n );
+
+		if( n ) used++;
+		stats.maxPerCluster = std::max( stats.maxPerCluster, n );
+	}
+	for( unsigned int i = 0; i < count; i++ )
+		if( clusters.ranges[i].visible ) stats.visible++;
+	stats.indices = clusters.indices.size();
+	stats.averagePerCluster = used ? (float)stats.indices / used : 0.0f;
+	stats.assignMs = (float)( 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency() );
+
+	// UPLOAD:
+	// Orphan and refill, the texture buffers stay attached to the same buffer names
+	const void *data[CLUSTER_BUFFER_COUNT] = {
+		count ? &clusters.lightTexels[0] : NULL, &clusters.grid[0], stats.indices ? &clusters.indices[0] : NULL
+	};
+	const size_t sizes[CLUSTER_BUFFER_COUNT] = {
+		count * 2 * sizeof( glm::vec4 ), CLUSTER_COUNT * 2 * sizeof( uint32_t ), stats.indices * sizeof( uint32_t )
+	};
+	for( unsigned int i = 0; i < CLUSTER_BUFFER_COUNT; i++ ){
+		if( sizes[i] == 0 ) continue;
+		glBindBuffer( GL_TEXTURE_BUFFER, clusters.buffers[i] );
+		glBufferData( GL_TEXTURE_BUFFER, CLUSTER_BUFFER_SIZES[i], NULL, GL_STREAM_DRAW );
+		glBufferSubData( GL_TEXTURE_BUFFER, 0, sizes[i], data[i] );
+	}
+	glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+}
+
+void setLightClusterSamplers( GLuint program ){
+	stateUseProgram( program );
+	glUniform1i( glGetUniformLocation( program, "lightData" ), LIGHT_CLUSTER_UNIT );
+	glUniform1i( glGetUniformLocation( program, "clusterGrid" ), LIGHT_CLUSTER_UNIT + 1 );
+	glUniform1i( glGetUniformLocation( program, "lightIndices" ), LIGHT_CLUSTER_UNIT + 2 );
+}
+
+void bindLightClusters( GLuint program, unsigned int renderWidth, unsigned int renderHeight ){
+	light_clusters_t &clusters = currentLightClusters();
+	bool enabled = clusters.ready && !clusters.lights.empty();
+	glUniform1i( glGetUniformLocation( program, "clusterLights" ), enabled );
+	if( !enabled ) return;
+
+	glUniform2f( glGetUniformLocation( program, "clusterScreen" ), (float)renderWidth, (float)renderHeight );
+	glUniform1f( glGetUniformLocation( program, "clusterNear" ), clusters.nearPlane );
+	glUniform1f( glGetUniformLocation( program, "clusterSliceScale" ), clusters.sliceScale );
+	for( unsigned int i = 0; i < CLUSTER_BUFFER_COUNT; i++ )
+		stateBindTexture( LIGHT_CLUSTER_UNIT + i, GL_TEXTURE_BUFFER, clusters.textures[i] );
+}
+
+light_cluster_stats_t lightClusterStats(){
+	return currentLightClusters().stats;
+}
@@ -0,0 +1,70 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+///// LIGHT_CLUSTERS HEADER ///////
+///////////////////////////////////
+
+// Many unshadowed point lights, culled per cluster. The view frustum is cut into a
+// CLUSTER_X x CLUSTER_Y grid of screen tiles and CLUSTER_Z depth slices (exponential, so
+// near slices are thin). Each frame the job threads work out which clusters every light's
+// sphere touches and build one flat list of light indices per cluster. The lists go to the
+// GPU in texture buffers, and fshader.txt only loops over the lights of its own cluster.
+//
+// texture buffers, bound from LIGHT_CLUSTER_UNIT up:
+//   lightData     RGBA32F  2 texels per light: position, radius / color, 0
+//   clusterGrid   RG32UI   per cluster: first index, count
+//   lightIndices  R32UI    the lists, back to back
+
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+const unsigned int CLUSTER_MAX_INDICES = CLUSTER_COUNT * 128;	// lists past this are cut short
+const unsigned int CLUSTER_MAX_LIGHTS = 4096;
+const unsigned int LIGHT_CLUSTER_UNIT = 4;		// first texture unit, three in use
+
+typedef struct {
+	glm::vec3 position;
+	float radius;			// no light past this distance
+	glm::vec3 color;
+	float phase;			// animation offset
+} point_light_t;
+
+typedef struct {
+	unsigned int lights;		// in the scene
+	unsigned int visible;		// touching at least one cluster
+	unsigned int indices;		// total over all cluster lists
+	unsigned int maxPerCluster;
+	float averagePerCluster;	// over clusters with any lights
+	bool overflow;				// CLUSTER_MAX_INDICES was hit
+	float assignMs;				// CPU time of the last assignment
+} light_cluster_stats_t;
+
+// Lights, lists and texture buffers per renderer. The calling thread's instance is the one
+// installed with lightClustersMakeCurrent(), or a default one; the job workers it hands the
+// assignment to are given it directly.
+struct light_clusters_t;
+light_clusters_t *lightClustersCreate();
+void lightClustersDestroy( light_clusters_t *clusters );		// closeLightClusters() first
+void lightClustersMakeCurrent( light_clusters_t *clusters );	// NULL for the default
+
+bool initLightClusters();
+void closeLightClusters();
+
+// Scatters 'count' lights over the given box with random colors and sizes, same seed every time
+void setClusterLights( unsigned int count, const glm::vec3 &boxMin, const glm::vec3 &boxMax );
+unsigned int clusterLightCount();
+
+// Animate, assign to clusters and upload. near/far bound the slices, lights past far are dropped.
+void updateLightClusters( float time, const glm::mat4 &view, const glm::mat4 &proj, float nearPlane, float farPlane );
+
+// Binds the buffers and sets the cluster uniforms of a program using them
+void bindLightClusters( GLuint program, unsigned int renderWidth, unsigned int renderHeight );
+void setLightClusterSamplers( GLuint program );		// once, after linking
+
+light_cluster_stats_t lightClusterStats();
+
+#endif
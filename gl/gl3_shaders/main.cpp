@@ -4,6 +4,26 @@
 
 #include "gl_utils.h"
 #include "frank_console.h"
+#include "post_compute.h"
+#include "render_graph.h"
+#include "gl_state.h"
+#include "draw_queue.h"
+#include "jobs.h"
+#include "triple_buffer.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
+#include "dynres.h"
+#include "gpu_memory.h"
+#include "light_clusters.h"
+#include "shadow_atlas.h"
+#include "stream_ring.h"
+#include "soft_raster.h"
+#include "image_filters.h"
+#include "convolution.h"
+#include "frame_capture.h"
+#include "scene_renderer.h"
+#include <algorithm>
+#include <string.h>
 
 /////////////////////
 ///// MAIN.CPP //////
@@ -15,22 +35,56 @@
 const int SCREEN_WIDTH 		= 800;
 const int SCREEN_HEIGHT 	= 600;
 const int TEX_DIMENSION 	= 256;
-const int LORES_WIDTH		= 320;
-const int LORES_HEIGHT		= 200;
-const float GODRAYS_SCALE	= 0.25f;
 
-const bool USE_LORES = false;
+const bool USE_RENDER_THREAD = true;	// render and swap on their own thread, input and update() stay on this one
+const unsigned int SIM_STEP_MS = 8;		// simulation tick when it runs apart from rendering
+const float DYNRES_TARGET_MS = 14.0f;	// GPU budget per frame for dynamic resolution
+const unsigned int RESIZE_SETTLE_MS = 250;	// window size must hold this long before targets are reallocated
 
-const float CUBE_SIZE = 5.0f;
-const float FLOOR_SIZE = 100.0f;
-const float FLOOR_HEIGHT = 10.0f;
+// clustered point lights over the floor, 'j' steps through the counts
+const unsigned int CLUSTER_LIGHT_STEPS = 5;
+const unsigned int CLUSTER_LIGHT_COUNTS[CLUSTER_LIGHT_STEPS] = { 0, 64, 256, 1024, 4096 };
 
-const unsigned int SHADOW_RES = 1024; // shadow map resolution - smaller=blockier/pixellated
+// --soft renders the cube and floor on the CPU into memory, no window or GL context
+const unsigned int SOFT_FRAMES = 300;
+const char *SOFT_FRAME_FILE = "soft_frame.bmp";		// the last frame, next to the executable
+
+// --capture <raw|png|y4m> records from the start, '7' starts and stops it while running
+const char *CAPTURE_FILE = "capture";		// prefix, next to the executable
+const unsigned int CAPTURE_FPS = 60;		// what Y4M players are told
+
+// --filters checks and times the CPU image filters, --filters <name> <in> <out> filters a file
+const unsigned int FILTER_CHECK_WIDTH = 1920;
+const unsigned int FILTER_CHECK_HEIGHT = 1080;
+
+// --batch [images] renders thumbnails around the cube on scene renderers, one per core
+const unsigned int BATCH_MAX_RENDERERS = 8;
+const unsigned int BATCH_IMAGES = 64;
+const unsigned int BATCH_WIDTH = 256;
+const unsigned int BATCH_HEIGHT = 256;
+const unsigned int BATCH_PITCHES = 4;			// camera heights, the yaw goes round once over the batch
+const float BATCH_CAMERA_DISTANCE = 40.0f;
+const char *BATCH_FILE = "batch";				// prefix, next to the executable
 
 bool DRAW_CUBE = true;
 bool DRAW_FLOOR = true;
 bool MOVE_LIGHT = true;
 bool BLOOM = true;
+bool COMPUTE_POST = true;		// use the compute shader post-processing path when GL 4.3 is available
+bool GRAYSCALE = false;
+bool LORES = false;				// 320x200, unfiltered and colour quantized
+bool DYNAMIC_RES = true;		// lower the render resolution when the GPU falls behind
+bool GODRAYS = true;			// light shafts from the light, at GODRAYS_SCALE resolution
+unsigned int CLUSTER_LIGHTS = 0;	// index into CLUSTER_LIGHT_COUNTS
+bool CAPTURE = false;			// record the frames, see frame_capture.h
+capture_format_t CAPTURE_FORMAT = CAPTURE_Y4M;
+unsigned int SHADOW_LIGHTS = 1;	// shadowed point lights, up to SHADOW_MAX_LIGHTS
+bool DEPTH_PREPASS = true;		// opaque depth first, so the scene pass shades each pixel once
+bool OIT = true;				// weighted blended transparency, else transparent draws sorted back to front
+bool COMPACT_TARGETS = true;	// COMPACT_TARGET_FORMATS, else FULL_TARGET_FORMATS
+bool GPU_PROFILE = true;		// print per-pass GPU times every few seconds
+bool CUBE_FIELD = false;		// a field of small spinning cubes, recorded across the job threads
+post_kernel_t POST_KERNEL = POST_KERNEL_NONE;
 float EXPOSURE = 1.0f;
 unsigned int BlurAmount = 10;
 float lightDistance = 20.0f;
@@ -38,62 +92,48 @@ float lightDistance = 20.0f;
 SDL_Window* gWindow = NULL;
 SDL_GLContext gContext;
 
-// shader programs
-GLuint gProgramID = 0;
-GLuint gScreenProgram = 0;
-GLuint gBlurProgram = 0;
-GLuint gBloomProgram = 0;
-GLuint gShadowProgram = 0;
-GLuint gRaysProgram = 0;
-
 // location info
 GLint gVertexPos2DLocation = -1;
 GLint gColorLocation = -1;
 
-// scene objects
-GLuint gTex = 0;
-GLuint gFloortex = 0;
-
-GLuint gVAO = 0;
-GLuint gVBO = 0;
-GLuint gEBO = 0;
-
-GLuint gVAOfloor = 0;
-GLuint gVBOfloor = 0;
-GLuint gEBOfloor = 0;
 glm::mat4 matFloor( 1.0f );
 
 glm::vec3 lightPos( -1.f, 3.f, 4.f );
 glm::vec3 viewPos( 0.0f, 0.0f, 50.0f );
 
-// offscreen rendering objects
-GLuint gFBO = 0; 				// main offscreen FBO
-GLuint gColorBuffers[2];    	// 0=normal scene, 1=bright colors only
-GLuint gRBO = 0;				// Render buffer object - holds depth and stencil info
-
-// Gaussian blur
-GLuint gBlurFBOs[2];			// Gaussian blur FBOs
-GLuint gBlurColorBuffers[2];
-
-// Low-Resolution low-color effect
-GLuint gLoresFBO = 0;
-GLuint gLoresColorBuffer = 0;
+// the scene, drawn on the render thread
+scene_assets_t gAssets;
+SceneRenderer gScene;
+float gFieldAngle = 0.0f;
+
+// Everything render() needs from the simulation, copied once per update(). The main thread
+// writes the globals above and publishes a snapshot, the render thread only reads gFrame.
+typedef struct {
+	scene_frame_t scene;
+	bool dynamicRes;
+	bool capture;
+	unsigned int statsRequests;		// bumped by 'i', the render thread prints when it changes
+	unsigned int lightBenchRequests;	// bumped by '4', same
+	unsigned int windowWidth;		// drawable size
+	unsigned int windowHeight;
+} frame_snapshot_t;
+
+TripleBuffer<frame_snapshot_t> gFrames;
+frame_snapshot_t gFrame;				// the snapshot being rendered
+glm::vec4 gClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
+unsigned int gDrawableWidth = SCREEN_WIDTH;		// updated from window events
+unsigned int gDrawableHeight = SCREEN_HEIGHT;
+unsigned int gStatsRequests = 0;
+unsigned int gLightBenchRequests = 0;
+SDL_atomic_t gRenderQuit;
+
+// The renderer follows the window size at once, its targets once a resize has settled
+unsigned int gWindowWidth = SCREEN_WIDTH;
+unsigned int gWindowHeight = SCREEN_HEIGHT;
+unsigned int gTargetWidth = SCREEN_WIDTH;
+unsigned int gTargetHeight = SCREEN_HEIGHT;
+unsigned int gResizeTick = 0;			// when the window size last changed
 
-// shadow mapping
-GLuint gShadowFBO = 0;
-GLuint gShadowBuffer = 0; // a depth buffer, to be precise
-
-// God Rays
-GLuint gRaysFBO = 0;
-GLuint gRaysBuffer = 0;
-
-// offscreen geometry objects
-GLuint VAO_screen = 0;
-GLuint VBO_screen = 0;
-GLuint EBO_screen = 0;
-
-glm::mat4 view( 1.0f );
-glm::mat4 proj( 1.0f );
 glm::mat4 model( 1.0f );
 
 // -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
@@ -108,9 +148,9 @@ bool init(){
         printf( "ERROR: SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
         success = false;
     } else{
-        //Use OpenGL 3.1 to use shaders
-        SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
-        SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 1 );
+        //Ask for OpenGL 4.3 for compute shaders, we fall back to 3.1 below if it's not there
+        SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 4 );
+        SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
         SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
 
         //Create window
@@ -120,7 +160,7 @@ bool init(){
 									SDL_WINDOWPOS_UNDEFINED, 
 									SCREEN_WIDTH, 
 									SCREEN_HEIGHT, 
-									SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN );
+									SDL_WINDOW_OPENGL | SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE );
         if( gWindow == NULL ){
             printf( "ERROR: Window could not be created! SDL Error: %s\n", SDL_GetError() );
             success = false;
@@ -128,6 +168,13 @@ bool init(){
         	printf("SUCCESS: Window created %d x %d...\n", SCREEN_WIDTH, SCREEN_HEIGHT );
             //Create context
             gContext = SDL_GL_CreateContext( gWindow );
+            if( gContext == NULL ){
+            	//Use OpenGL 3.1 to use shaders
+            	printf( "WARNING: OpenGL 4.3 context could not be created, trying 3.1...\n" );
+            	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
+            	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 1 );
+            	gContext = SDL_GL_CreateContext( gWindow );
+            }
             if( gContext == NULL ){
                 printf( "ERROR: OpenGL context could not be created! SDL Error: %s\n", SDL_GetError() );
                 success = false;
@@ -138,6 +185,9 @@ bool init(){
             	GLenum glewError = glewInit();
             	if( glewError != GLEW_OK ) printf( "ERROR: Could not initialize GLEW: %s\n", glewGetErrorString( glewError ) );
             	
+                // worker threads for command recording
+                initJobs();
+            	
                 //Use Vsync
                 if( SDL_GL_SetSwapInterval( 1 ) < 0 )
                     printf( "WARNING: Unable to set VSync! SDL Error: %s\n", SDL_GetError() );
@@ -165,415 +215,23 @@ bool init(){
 // -=-=-=-=-=-=- InitGL -=-=-=-=-=-=-=-=-
 // -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 bool initGL(){
-    GLenum error = GL_NO_ERROR;
-    unsigned int i;
-    
-    // global GL settings go here
-    glEnable( GL_DEPTH_TEST );
-    glEnable( GL_TEXTURE_2D );
-    glEnable( GL_CULL_FACE );
-    glEnable( GL_BLEND );
-    glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
-    
-    glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
-    
-    // LOAD SHADERS
-    //////////////////
-    
-	// load regular 3D scene shader
-	if( loadProgram( gProgramID, "vshader.txt", "fshader.txt", "" ) == false ){
-		printf( "ERROR: Loading shader program failed!\n" );
-		return false;
-	}
-	
-	// Create a separate shader program for rendering a texture to the screen, for post-processing
-	if( loadProgram( gScreenProgram, "vscreen.txt", "fscreen.txt", "" ) == false ){
-		printf( "ERROR: Loading screen shader program failed!\n" );
-		return false;
-	}
-	
-	// Create a shader program for processing a Gaussian blur
-	if( loadProgram( gBlurProgram, "vblur.txt", "fblur.txt", "" ) == false ){
-		printf( "ERROR: Loading blur shader program failed!\n" );
-		return false;
-	}
-	
-	// Create a shader program for processing Bloom effect
-	if( loadProgram( gBloomProgram, "vbloom.txt", "fbloom.txt", "" ) == false ){
-		printf( "ERROR: Loading bloom shader program failed!\n" );
-		return false;
-	}
-	
-	// Create a shader program for shadow mapping
-	if( loadProgram( gShadowProgram, "vshadow.txt", "fshadow.txt", "gshadow.txt" ) == false ){
-		printf( "ERROR: Loading shadow shader program failed!\n" );
-		return false;	
-	}
-	
-	// Create a shader program for God Rays
-	if( loadProgram( gRaysProgram, "vrays.txt", "frays.txt", "" ) == false ){
-		printf( "ERROR: Loading god-rays shader program failed!\n" );
+	// cube, floor and their textures, then everything else the scene draws with
+	if( !createSceneAssets( gAssets ) )
+		printf( "WARNING: Scene textures could not be loaded...\n" );
+	if( !gScene.init( gAssets, SCREEN_WIDTH, SCREEN_HEIGHT ) )
 		return false;
-	}
-	
-	
-    
-    // figure out screen dimensions
-    unsigned int fbWidth= USE_LORES ? LORES_WIDTH : SCREEN_WIDTH;
-    unsigned int fbHeight = USE_LORES ? LORES_HEIGHT : SCREEN_HEIGHT;
-    
-    // Set the rendering viewport according to the screen dimensions we wanna use
-    glViewport( 0, 0, fbWidth, fbHeight );
-    
-    
-    // FRAME BUFFER OBJECTS FOR SHADER PROGRAMS
-    ////////////////////////////////////////////
-    
-    // create and bind a framebuffer object
-    glGenFramebuffers( 1, &gFBO );
-    glBindFramebuffer( GL_FRAMEBUFFER, gFBO );
-    
-    // create two offscreen color buffers for bloom color effects
-    glGenTextures(2, gColorBuffers );
-	for ( i = 0; i < 2; i++ )
-	{
-	    glBindTexture( GL_TEXTURE_2D, gColorBuffers[i] );
-	    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB16F, fbWidth, fbHeight, 0, GL_RGB, GL_FLOAT, NULL );
-		glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-	    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-	    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-	    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-	    // attach texture to framebuffer
-	    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, gColorBuffers[i], 0 );
-	}
-
-    // Create a Renderbuffer to put depth and stencil info
-    glGenRenderbuffers( 1, &gRBO );
-    glBindRenderbuffer( GL_RENDERBUFFER, gRBO );
-    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, fbWidth, fbHeight );
-    glBindRenderbuffer( GL_RENDERBUFFER, 0 );
-    // add renderbuffer to our framebuffer
-    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, gRBO );
-    
-    // Tell OpenGL the assignment of each color buffer element
-	unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-	glDrawBuffers( 2, attachments );
-    
-    // check for Framebuffer errors
-    error = glCheckFramebufferStatus( GL_FRAMEBUFFER );
-    if( error != GL_FRAMEBUFFER_COMPLETE ){
-    	printf( "ERROR: " );
-    	switch( error ){
-    		case 36054:
-    			printf( "Incomplete attachment, check if zero or undefined before attaching.\n" );
-    			break;
-    		case 36057:
-    			printf( "Not all attachments have the same width/height.\n" );
-    			break;
-    		case 36055:
-    			printf( "No images are attached to the framebuffer.\n" );
-    			break;
-    		case 36061:
-    			printf( "The combination of internal formats of the attached images violates an implementation-dependent set of restrictions.\n" );
-    	}
-    	return false;
-    }
-    
-    // Create two framebuffer objects for Gaussian blue shader
-    glGenFramebuffers( 2, gBlurFBOs );
-    glGenTextures( 2, gBlurColorBuffers );
-    for ( i = 0; i < 2; i++ ){
-        glBindFramebuffer( GL_FRAMEBUFFER, gBlurFBOs[i] );
-        glBindTexture( GL_TEXTURE_2D, gBlurColorBuffers[i] );
-        glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB16F, fbWidth, fbHeight, 0, GL_RGB, GL_FLOAT, NULL );
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE ); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gBlurColorBuffers[i], 0 );
-		// check if framebuffers are complete (no need for depth buffer)
-        if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
-            printf( "ERROR: Create blurring framebuffer failed!\n" );
-    }
-    
-    // Lo-Res
-	glGenFramebuffers( 1, &gLoresFBO );
-    glGenTextures( 1, &gLoresColorBuffer );
-    glBindFramebuffer( GL_FRAMEBUFFER, gLoresFBO );
-    glBindTexture( GL_TEXTURE_2D, gLoresColorBuffer );
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB16F, fbWidth, fbHeight, 0, GL_RGB, GL_FLOAT, NULL );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gLoresColorBuffer, 0 );
-	// check if framebuffers are complete (no need for depth buffer)
-    if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
-        printf( "ERROR: Create Lores framebuffer failed!\n" );
-        
-    // Shadow Mapping Framebuffers and depth surface
-    glGenFramebuffers( 1, &gShadowFBO );
-    glGenTextures( 1, &gShadowBuffer );
-    glBindTexture( GL_TEXTURE_CUBE_MAP, gShadowBuffer );
-    for( i = 0; i < 6; ++i )
-    {
-    	glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_DEPTH_COMPONENT, SHADOW_RES, SHADOW_RES, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL );
-    }
-    glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-	glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
-	
-    glBindFramebuffer( GL_FRAMEBUFFER, gShadowFBO );
-    glFramebufferTexture( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, gShadowBuffer, 0 );
-    glDrawBuffer( GL_NONE );  // Tell OpenGL we don't want to draw expensive color information,
-    glReadBuffer( GL_NONE );  // all we want is depth info for shadow calculations.
-    if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
-        printf( "ERROR: Create shadow framebuffer failed!\n" );
-    
-    // God Rays
-    glGenFramebuffers( 1, &gRaysFBO );
-    glGenTextures( 1, &gRaysBuffer );
-    glBindTexture( GL_TEXTURE_2D, gRaysBuffer );
-    glBindFramebuffer( GL_FRAMEBUFFER, gRaysFBO );
-    glBindTexture( GL_TEXTURE_2D, gRaysBuffer );
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB16F, fbWidth * GODRAYS_SCALE, fbHeight * GODRAYS_SCALE, 0, GL_RGB, GL_FLOAT, NULL );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
-    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gRaysBuffer, 0 );
-	// also check if framebuffers are complete (no need for depth buffer)
-    if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
-        printf( "ERROR: Create Lores framebuffer failed!\n" );
-
-	// Bind the screen space, we're done creating off-screen buffers
-    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-    
-    
-    
-    // Create shader program parameters
-    glUseProgram( gProgramID );
-    glUniform1i( glGetUniformLocation( gProgramID, "diffuseTexture" ), 0 );
-    glUniform1i( glGetUniformLocation( gProgramID, "shadowMap" ), 1 );
-    
-    glUseProgram( gBlurProgram );
-    glUniform1i( glGetUniformLocation( gBlurProgram, "image" ), 0 );
-    
-    glUseProgram( gBloomProgram );
-    glUniform1i( glGetUniformLocation( gBloomProgram, "scene" ), 0);
-    glUniform1i( glGetUniformLocation( gBloomProgram, "bloomBlur" ), 1);
-    
-    glUseProgram( gShadowProgram );
-    glUniform1i( glGetUniformLocation( gShadowProgram, "alphatex"), 0 );
-
-
-
-	// GEOMETRY
-	//////////////////
-    
-    // Cube
-    float vertexData[] =
-    {
-        // positions                        // normals         // uv coords
-        // north
-	    -CUBE_SIZE, -CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  0.0f, 1.0f,
-	     CUBE_SIZE, -CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,
-	    -CUBE_SIZE,  CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  0.0f, 0.0f,
-	     CUBE_SIZE,  CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  1.0f, 0.0f,
-	    
-	    // south
-	    -CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  1.0f, 1.0f,
-	     CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,
-	    -CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,
-	     CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f,
-	    
-	    // east
-	    CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
-	    CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f,
-	    CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  1.0f, 0.0f, 0.0f,  1.0f, 0.0f,
-	    CUBE_SIZE,  CUBE_SIZE,  CUBE_SIZE,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
-	    
-	    // west
-	    -CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  0.0f, 1.0f,
-	    -CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
-	    -CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
-	    -CUBE_SIZE,  CUBE_SIZE,  CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  1.0f, 0.0f,
-	    
-	    // top
-	    -CUBE_SIZE, CUBE_SIZE,  CUBE_SIZE,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
-	     CUBE_SIZE, CUBE_SIZE,  CUBE_SIZE,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f,
-	    -CUBE_SIZE, CUBE_SIZE, -CUBE_SIZE,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-	     CUBE_SIZE, CUBE_SIZE, -CUBE_SIZE,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
-	    
-	    // bottom
-	    -CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  0.0f, -1.0f, 0.0f,  1.0f, 1.0f,
-	     CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  0.0f, -1.0f, 0.0f,  0.0f, 1.0f,
-	    -CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, -1.0f, 0.0f,  1.0f, 0.0f,
-	     CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, -1.0f, 0.0f,  0.0f, 0.0f
-    };
-    
-    unsigned int indices[] = {
-    	// north
-		0, 1, 2,
-		1, 3, 2,
-    	
-    	// south
-    	6, 5, 4,
-    	7, 5, 6,
-    	
-    	// east
-    	10, 9, 8,
-    	10, 11, 9,
-    	
-    	// west
-    	12, 13, 14,
-    	14, 13, 15,
-    	
-    	// top
-    	16, 17, 18,
-    	17, 19, 18,
-    	
-    	// bottom
-    	22, 21, 20,
-    	23, 21, 22
-    };
-
-    //Create a Vertex Buffer Object, and send our vertex data and specifications to OpenGL
-    glGenVertexArrays( 1, &gVAO );
-    glBindVertexArray( gVAO );
-    
-    glGenBuffers( 1, &gVBO );
-    glGenBuffers( 1, &gEBO );
-    
-    // Vertex data
-    glBindBuffer( GL_ARRAY_BUFFER, gVBO );
-    glBufferData( GL_ARRAY_BUFFER, sizeof( vertexData ), vertexData, GL_STATIC_DRAW );
-    
-	// index/element data
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, gEBO );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( indices ), indices, GL_STATIC_DRAW );
-    
-    // Set vertex attributes for the "scene" vertex array
-    // position attribute
-	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0 );
-	glEnableVertexAttribArray(0);
-	// color attribute
-	glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)) );
-	glEnableVertexAttribArray(1);
-	// texture attribute
-	glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)) );
-	glEnableVertexAttribArray(2);
-	
-	
-	
-	//Vertex Buffer Object - Floor!
-    float vertexFloor[] =
-    {
-        // positions         // normals         // uv coords
-		-100.f, -FLOOR_HEIGHT,  100.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-	     100.f, -FLOOR_HEIGHT,  100.0f,	 0.0f, 1.0f, 0.0f,  10.0f, 0.0f,
-	    -100.f, -FLOOR_HEIGHT, -100.0f,	 0.0f, 1.0f, 0.0f,  0.0f, 10.0f,
-	     100.f, -FLOOR_HEIGHT, -100.0f,	 0.0f, 1.0f, 0.0f,  10.0f, 10.0f  
-    };
-    
-    unsigned int indicesFloor[] = {
-		0, 1, 2,
-		1, 3, 2
-    };
-
-    //Create a Vertex Buffer Object, and send our vertex data and specifications to OpenGL
-    glGenVertexArrays( 1, &gVAOfloor );
-    glBindVertexArray( gVAOfloor );
-    
-    glGenBuffers( 1, &gVBOfloor );
-    glGenBuffers( 1, &gEBOfloor );
-    
-    // Vertex data
-    glBindBuffer( GL_ARRAY_BUFFER, gVBOfloor );
-    glBufferData( GL_ARRAY_BUFFER, sizeof( vertexFloor ), vertexFloor, GL_STATIC_DRAW );
-    
-	// index/element data
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, gEBOfloor );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( indicesFloor ), indicesFloor, GL_STATIC_DRAW );
-    
-    // Set vertex attributes for the "scene" vertex array
-    // position attribute
-	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0 );
-	glEnableVertexAttribArray(0);
-	// normal attribute
-	glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)) );
-	glEnableVertexAttribArray(1);
-	// texture attribute
-	glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)) );
-	glEnableVertexAttribArray(2);
-    
-    
-    // Here we will create another Vertex Array Object containing a simple quad to use
-    // when we draw a copy of an offscreen buffer to screen memory, used for post-processing effects.
-    glGenVertexArrays( 1, &VAO_screen );
-    glBindVertexArray( VAO_screen );
-    
-    float screen_verts[] = {
-    	-1.f, -1.f, 0.0f,  0.0f, 0.0f,
-	     1.f, -1.f, 0.0f,  1.0f, 0.0f,
-	    -1.f,  1.f, 0.0f,  0.0f, 1.0f,
-	     1.f,  1.f, 0.0f,  1.0f, 1.0f
-	};
-	
-	unsigned int screen_inds[] = {
-		0, 1, 2,
-		2, 1, 3
-	};
-	
-	glGenBuffers( 1, &VBO_screen );
-    glGenBuffers( 1, &EBO_screen );
-	
-	glBindBuffer( GL_ARRAY_BUFFER, VBO_screen );
-	glBufferData( GL_ARRAY_BUFFER, sizeof( screen_verts ), screen_verts, GL_STATIC_DRAW );
-		
-    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, EBO_screen );
-    glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( screen_inds ), screen_inds, GL_STATIC_DRAW );
-    
-	// Set the vertex attributes for the "screen" vertex array
-	// position attribute
-	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0 );
-	glEnableVertexAttribArray(0);
-	// texture attribute
-	glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)) );
-	glEnableVertexAttribArray(1);
-	
-	
-	
 	
-	// MATRICES
-	///////////////
-	view = glm::translate( view, -viewPos ); // negative, the "world" is translated in the opposite direction of any "camera" movement
-	proj = glm::perspective( glm::radians( 45.0f ), (float)SCREEN_WIDTH/(float)SCREEN_HEIGHT, 1.f, 1000.0f );
-	
-	
-	
-	
-	// TEXTURES
-	///////////////
-	gTex = 		loadTexFromFile( "trans.png", 256, 256, true, !USE_LORES );
-	gFloortex =	loadTexFromFile( "tile2.png", 512, 512, true, !USE_LORES );
-
+	initDynamicResolution( makeDynresConfig( DYNRES_TARGET_MS ) );
 
 	printf( "SUCCESS: OpenGL initialized...\n" );
     return true;
 }
 
-
-
-
-
-
 // -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // -=-=-=-=- update -=-=-=-=-=-=-=-
 // -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 void update( float delta ){
+	CPU_ZONE( "update" );
 	float theta = 0.5f;
 	static float lightAngle = 0.0f;
 	
@@ -581,6 +239,9 @@ void update( float delta ){
 	model    = glm::rotate( model,    glm::radians( theta * delta ), glm::vec3( 1.0f, 1.0f, 1.0f ) );
 	matFloor = glm::rotate( matFloor, glm::radians( ( theta * 0.075f ) * delta ), glm::vec3( 0.0f, 1.0f, 0.0f ) );
 	
+	gFieldAngle += 0.02f * delta;
+	if( gFieldAngle > 3.14159*2 ) gFieldAngle -= 3.14159*2;
+	
 	if( MOVE_LIGHT )
 	{
 		lightAngle += 0.0075f * delta;
@@ -591,232 +252,571 @@ void update( float delta ){
 	}
 }
 
-void renderCube(){
-	// Note: Culling disabled temporarily to show backside(s) if there is transparent texture
-	glDisable( GL_CULL_FACE );
-	glBindVertexArray( gVAO );
-	glActiveTexture( GL_TEXTURE0 );
-	glBindTexture( GL_TEXTURE_2D, gTex );
-	glDrawElements( GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0 );
-	glEnable( GL_CULL_FACE );
+// What the scene renderer should draw, from the toggles and the simulation
+scene_frame_t currentSceneFrame(){
+	scene_frame_t scene;
+	
+	scene.model = model;
+	scene.matFloor = matFloor;
+	scene.view = glm::translate( glm::mat4( 1.0f ), -viewPos ); // negative, the "world" is translated in the opposite direction of any "camera" movement
+	scene.viewPos = viewPos;
+	scene.lightPos = lightPos;
+	scene.fieldAngle = gFieldAngle;
+	scene.clearColor = gClearColor;
+	scene.drawCube = DRAW_CUBE;
+	scene.drawFloor = DRAW_FLOOR;
+	scene.bloom = BLOOM;
+	scene.computePost = COMPUTE_POST;
+	scene.grayscale = GRAYSCALE;
+	scene.cubeField = CUBE_FIELD;
+	scene.gpuProfile = GPU_PROFILE;
+	scene.lores = LORES;
+	scene.godrays = GODRAYS;
+	scene.compactTargets = COMPACT_TARGETS;
+	scene.depthPrepass = DEPTH_PREPASS;
+	scene.oit = OIT;
+	scene.clusterLights = CLUSTER_LIGHT_COUNTS[CLUSTER_LIGHTS];
+	scene.shadowLights = SHADOW_LIGHTS;
+	scene.postKernel = POST_KERNEL;
+	scene.exposure = EXPOSURE;
+	scene.blurAmount = BlurAmount;
+	scene.renderScale = 1.0f;
+	return scene;
 }
 
-void renderFloor(){
-	glBindVertexArray( gVAOfloor );
-	glActiveTexture( GL_TEXTURE0 );
-    glBindTexture( GL_TEXTURE_2D, gFloortex );
-	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0 );
+// Hand the current simulation state to the renderer
+void publishFrame(){
+	frame_snapshot_t &frame = gFrames.back();
+	
+	frame.scene = currentSceneFrame();
+	frame.dynamicRes = DYNAMIC_RES;
+	frame.capture = CAPTURE;
+	frame.lightBenchRequests = gLightBenchRequests;
+	frame.statsRequests = gStatsRequests;
+	frame.windowWidth = gDrawableWidth;
+	frame.windowHeight = gDrawableHeight;
+	
+	gFrames.publish();
 }
 
-void renderQuad(){
-	glBindVertexArray( VAO_screen );
-	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0 );	
+// Render the newest snapshot, or the last one again if the simulation hasn't published since
+void renderFrame(){
+	gFrames.acquire();
+	const frame_snapshot_t &frame = gFrames.front();
+	
+	if( frame.lightBenchRequests != gFrame.lightBenchRequests )
+		gScene.startLightBenchmark();
+	
+	if( frame.statsRequests != gFrame.statsRequests ){
+		// GL calls since the last time we asked
+		gl_state_stats_t stats = stateGetStats();
+		unsigned int total = stats.issued + stats.skipped;
+		printf( "GL STATE: %u calls issued, %u redundant calls skipped (%.1f%%)\n", stats.issued, stats.skipped, total ? 100.0f * stats.skipped / total : 0.0f );
+		stateResetStats();
+		printStreamRingStats();
+		if( capturing() ) printCaptureStats();
+	}
+	
+	if( frame.capture != gFrame.capture ){
+		if( frame.capture ) startCapture( CAPTURE_FORMAT, ( SDL_GetBasePath() + std::string( CAPTURE_FILE ) ).c_str(), CAPTURE_FPS );
+		else stopCapture();
+	}
+	
+	// Follow the window right away with the viewport and projection, but only reallocate the
+	// targets when it stops changing - until then we render at the old size and scale to fit
+	if( frame.windowWidth != gWindowWidth || frame.windowHeight != gWindowHeight ){
+		gWindowWidth = frame.windowWidth;
+		gWindowHeight = frame.windowHeight;
+		gResizeTick = SDL_GetTicks();
+		gScene.resize( gWindowWidth, gWindowHeight );
+	}
+	
+	if( ( gTargetWidth != gWindowWidth || gTargetHeight != gWindowHeight ) && SDL_GetTicks() - gResizeTick >= RESIZE_SETTLE_MS ){
+		gTargetWidth = gWindowWidth;
+		gTargetHeight = gWindowHeight;
+		gScene.resizeTargets( gTargetWidth, gTargetHeight );
+	}
+	
+	// pixelated textures go with lo-res mode
+	if( frame.scene.lores != gFrame.scene.lores ){
+		setTexFiltering( gAssets.cubeTexture, !frame.scene.lores );
+		setTexFiltering( gAssets.floorTexture, !frame.scene.lores );
+	}
+	
+	if( frame.dynamicRes && !frame.scene.lores ){
+		float gpuMs;
+		if( gpuProfilerLatest( "frame", gpuMs ) ) updateDynamicResolution( gpuMs );
+	}
+	else if( gFrame.dynamicRes && !frame.dynamicRes ) resetDynamicResolution();
+	
+	gFrame = frame;
+	gFrame.scene.renderScale = gFrame.dynamicRes ? dynamicResolutionScale() : 1.0f;
+	gScene.render( gFrame.scene );
+	captureReadback( gWindowWidth, gWindowHeight );
+	{
+		CPU_ZONE( "swap" );
+		SDL_GL_SwapWindow( gWindow );
+	}
+	CPU_PROFILER_FRAME();
+}
+
+int renderThread( void * ){
+	CPU_PROFILER_THREAD( "render" );
+	
+	// the context moves over from the main thread, which released it
+	if( SDL_GL_MakeCurrent( gWindow, gContext ) < 0 ){
+		printf( "ERROR: Render thread could not make the OpenGL context current! SDL Error: %s\n", SDL_GetError() );
+		CPU_PROFILER_THREAD_END();
+		return 1;
+	}
+	gScene.makeCurrent();
+	
+	while( !SDL_AtomicGet( &gRenderQuit ) )
+		renderFrame();
+	
+	SDL_GL_MakeCurrent( gWindow, NULL );
+	CPU_PROFILER_THREAD_END();
+	return 0;
 }
 
 
 
-// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-// -=-=-=-=- processShadows -=-=-=-=-=-
-// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
-void processShadows( float far_plane ) {
-	float near_plane = 1.0f;
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=- Run modes -=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// Command line modes that run instead of the interactive demo, picked in main()
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=- runSoftRenderer -=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// The scene without lighting, shadows or post, drawn by soft_raster for SOFT_FRAMES frames
+int runSoftRenderer(){
+	soft_texture_t cubeTex, floorTex;
 	
-	// In this example we have a point light and shadows
-	// are produced using a "perspective" transform
-	glm::mat4 shadowProj = glm::perspective( glm::radians( 90.0f ), 1.0f, near_plane, far_plane );
+	CPU_PROFILER_THREAD( "main" );
+	if( SDL_Init( SDL_INIT_TIMER ) < 0 ){
+		printf( "ERROR: SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+		return 1;
+	}
+	IMG_Init( IMG_INIT_PNG );
+	initJobs();
+	initSoftRaster( SCREEN_WIDTH, SCREEN_HEIGHT );
 	
-	// We will need 6 elements arrayed inside a vector - one for each cube face
-	std::vector<glm::mat4> shadowTransforms;
+	if( !softLoadTexture( "trans.png", &cubeTex ) || !softLoadTexture( "tile2.png", &floorTex ) ){
+		closeSoftRaster();
+		closeJobs();
+		IMG_Quit();
+		SDL_Quit();
+		return 1;
+	}
 	
-	// populate vector with the 6 different directions of the cube map
-	shadowTransforms.push_back( shadowProj * glm::lookAt( lightPos, lightPos + glm::vec3( 1.0f, 0.0f, 0.0f ), glm::vec3( 0.0f, -1.0f,  0.0f ) ) );
-	shadowTransforms.push_back( shadowProj * glm::lookAt( lightPos, lightPos + glm::vec3(-1.0f, 0.0f, 0.0f ), glm::vec3( 0.0f, -1.0f,  0.0f ) ) );
-	shadowTransforms.push_back( shadowProj * glm::lookAt( lightPos, lightPos + glm::vec3( 0.0f, 1.0f, 0.0f ), glm::vec3( 0.0f,  0.0f,  1.0f ) ) );
-	shadowTransforms.push_back( shadowProj * glm::lookAt( lightPos, lightPos + glm::vec3( 0.0f,-1.0f, 0.0f ), glm::vec3( 0.0f,  0.0f, -1.0f ) ) );
-	shadowTransforms.push_back( shadowProj * glm::lookAt( lightPos, lightPos + glm::vec3( 0.0f, 0.0f, 1.0f ), glm::vec3( 0.0f, -1.0f,  0.0f ) ) );
-	shadowTransforms.push_back( shadowProj * glm::lookAt( lightPos, lightPos + glm::vec3( 0.0f, 0.0f,-1.0f ), glm::vec3( 0.0f, -1.0f,  0.0f ) ) );
+	glm::mat4 softView = glm::translate( glm::mat4( 1.0f ), -viewPos );
+	glm::mat4 softProj = glm::perspective( glm::radians( 45.0f ), (float)SCREEN_WIDTH/(float)SCREEN_HEIGHT, CAMERA_NEAR, CAMERA_FAR );
+	glm::mat4 viewProj = softProj * softView;
 	
-	// Use the shadow rendering program
-	glUseProgram( gShadowProgram );
+	soft_state_t floorState = softDefaultState();
+	floorState.texture = &floorTex;
 	
-	// adjust viewport before rendering
-	glViewport( 0, 0, SHADOW_RES, SHADOW_RES );
-	glBindFramebuffer( GL_FRAMEBUFFER, gShadowFBO );
-	glClear( GL_DEPTH_BUFFER_BIT );
+	// like the GL path: both sides of the see-through cube, blended after the opaque draws
+	soft_state_t cubeState = softDefaultState();
+	cubeState.texture = &cubeTex;
+	cubeState.cullBack = false;
+	cubeState.blend = true;
+	cubeState.depthWrite = false;
 	
-	for( int i = 0; i < 6; i++ )
-		setMat4( gShadowProgram, "shadowMatrices[" + std::to_string(i) + "]", shadowTransforms[i] );
+	soft_state_t lightState = softDefaultState();
+	lightState.tint = glm::vec4( 1.0f, 0.9f, 0.5f, 1.0f );
 	
-	glUniform1f( glGetUniformLocation( gShadowProgram, "far_plane" ), far_plane );
-	glUniform3f( glGetUniformLocation( gShadowProgram, "lightPos" ), lightPos.x, lightPos.y, lightPos.z );
+	if( CAPTURE ) startCapture( CAPTURE_FORMAT, ( SDL_GetBasePath() + std::string( CAPTURE_FILE ) ).c_str(), CAPTURE_FPS );
+	
+	printf( "ATTEMPT: Rendering %u frames in software...\n", SOFT_FRAMES );
+	double totalMs = 0.0, worstMs = 0.0;
+	
+	for( unsigned int frame = 0; frame < SOFT_FRAMES; frame++ ){
+		Uint64 frameStart = SDL_GetPerformanceCounter();
+		update( 1.0f );
+		
+		softClear( gClearColor );
+		softDrawIndexed( FLOOR_VERTICES, 8, 6, FLOOR_INDICES, 6, viewProj * matFloor, floorState );
+		glm::mat4 lightMatrix = glm::scale( glm::translate( glm::mat4( 1.0f ), lightPos ), glm::vec3( 0.1f ) );
+		softDrawIndexed( CUBE_VERTICES, 8, 6, CUBE_INDICES, 36, viewProj * lightMatrix, lightState );
+		softDrawIndexed( CUBE_VERTICES, 8, 6, CUBE_INDICES, 36, viewProj * model, cubeState );
+		softFinish();
+		
+		double frameMs = 1000.0 * ( SDL_GetPerformanceCounter() - frameStart ) / SDL_GetPerformanceFrequency();
+		totalMs += frameMs;
+		if( frameMs > worstMs ) worstMs = frameMs;
 		
-	// render floor
-	shaderSendMatrix( glGetUniformLocation( gShadowProgram, "model" ), matFloor );
-	renderFloor();
+		// outside the timed part, the capture costs a copy
+		soft_framebuffer_t fb = softFramebuffer();
+		captureImage( fb.pixels, fb.width, fb.height, fb.pitch );
+	}
+	stopCapture();
+	
+	printf( "SUCCESS: %u frames at %ux%u on %u threads, %.2f ms a frame (%.0f fps), worst %.2f ms\n", SOFT_FRAMES,
+			SCREEN_WIDTH, SCREEN_HEIGHT, jobWorkerCount(), totalMs / SOFT_FRAMES, 1000.0 * SOFT_FRAMES / totalMs, worstMs );
+	printSoftRasterStats();
 	
-	// render cube - with transparency
-	shaderSendMatrix( glGetUniformLocation( gShadowProgram, "model" ), model );
-	renderCube();
+	soft_framebuffer_t fb = softFramebuffer();
+	SDL_Surface *shot = SDL_CreateRGBSurfaceWithFormatFrom( (void*)fb.pixels, fb.width, fb.height, 32, fb.pitch, SDL_PIXELFORMAT_RGBA32 );
+	std::string shotPath = SDL_GetBasePath() + std::string( SOFT_FRAME_FILE );
+	if( shot && SDL_SaveBMP( shot, shotPath.c_str() ) == 0 )
+		printf( "SUCCESS: Last frame saved to %s\n", shotPath.c_str() );
+	else
+		printf( "ERROR: Could not save the last frame! SDL Error: %s\n", SDL_GetError() );
+	if( shot ) SDL_FreeSurface( shot );
 	
-	// reset viewport
-	setViewport();
+	closeSoftRaster();
+	closeJobs();
+	IMG_Quit();
+	SDL_Quit();
+	return 0;
 }
 
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=- runImageFilters -=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// The post effects on the CPU, either checked against the shader math or run over one image
+int runImageFilters( int argc, char *argv[] ){
+	bool ok = true;
+	
+	CPU_PROFILER_THREAD( "main" );
+	if( SDL_Init( SDL_INIT_TIMER ) < 0 ){
+		printf( "ERROR: SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+		return 1;
+	}
+	IMG_Init( IMG_INIT_PNG );
+	initJobs();
+	
+	if( argc < 3 ){
+		ok = verifyImageFilters( FILTER_CHECK_WIDTH, FILTER_CHECK_HEIGHT );
+	}
+	else if( argc < 5 || findImageFilter( argv[2] ) == IMAGE_FILTER_COUNT ){
+		printf( "ERROR: Usage is --filters <grayscale|quantize|blur|sharpen|gaussian> <input> <output.png>\n" );
+		ok = false;
+	}
+	else {
+		SDL_Surface *loaded = IMG_Load( argv[3] );
+		SDL_Surface *in = loaded ? SDL_ConvertSurfaceFormat( loaded, SDL_PIXELFORMAT_RGBA32, 0 ) : NULL;
+		SDL_Surface *out = in ? SDL_CreateRGBSurfaceWithFormat( 0, in->w, in->h, 32, SDL_PIXELFORMAT_RGBA32 ) : NULL;
+		
+		if( out == NULL ){
+			printf( "ERROR: Could not load %s! SDL Error: %s\n", argv[3], SDL_GetError() );
+			ok = false;
+		}
+		else {
+			Uint64 start = SDL_GetPerformanceCounter();
+			ok = applyImageFilter( findImageFilter( argv[2] ), makeImage( in->pixels, in->w, in->h, IMAGE_RGBA8, in->pitch ),
+								   makeImage( out->pixels, out->w, out->h, IMAGE_RGBA8, out->pitch ) );
+			double ms = 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency();
+			
+			if( ok && IMG_SavePNG( out, argv[4] ) == 0 )
+				printf( "SUCCESS: %s of %dx%d in %.2f ms%s, saved to %s\n", argv[2], in->w, in->h, ms,
+						imageFilterSimd() ? " with AVX2" : "", argv[4] );
+			else {
+				printf( "ERROR: Could not save %s! SDL Error: %s\n", argv[4], SDL_GetError() );
+				ok = false;
+			}
+		}
+		if( out ) SDL_FreeSurface( out );
+		if( in ) SDL_FreeSurface( in );
+		if( loaded ) SDL_FreeSurface( loaded );
+	}
+	
+	closeJobs();
+	IMG_Quit();
+	SDL_Quit();
+	return ok ? 0 : 1;
+}
 
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=- runBatchRenderer -=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// One scene renderer on a context of its own. SDL2 can't make a context without a surface,
+// so it sits on a hidden 1x1 window; it shares objects with the main context, which holds
+// the scene assets. Framebuffers can't be shared, so the image target is made in it too.
+typedef struct {
+	SDL_Window *window;
+	SDL_GLContext context;
+	gl_state_t *state;			// the context's cache
+	SceneRenderer scene;
+	GLuint fbo;
+	GLuint color;				// RGBA8, BATCH_WIDTH x BATCH_HEIGHT
+	SDL_atomic_t *next;			// next image to take
+	unsigned int images;
+	unsigned char *pixels;		// every image of the batch, BATCH_WIDTH x BATCH_HEIGHT RGBA8 each
+	bool ok;
+} batch_worker_t;
+
+// image 'index' of 'count', the camera circles the cube and steps through BATCH_PITCHES heights
+scene_frame_t batchView( unsigned int index, unsigned int count ){
+	scene_frame_t scene = currentSceneFrame();
+	float yaw = glm::radians( 360.0f * index / count );
+	float pitch = glm::radians( 10.0f + 60.0f * ( index % BATCH_PITCHES ) / BATCH_PITCHES );
+	glm::vec3 eye = BATCH_CAMERA_DISTANCE * glm::vec3( cos( pitch ) * sin( yaw ), sin( pitch ), cos( pitch ) * cos( yaw ) );
+	
+	scene.view = glm::lookAt( eye, glm::vec3( 0.0f ), glm::vec3( 0.0f, 1.0f, 0.0f ) );
+	scene.viewPos = eye;
+	scene.clearColor = glm::vec4( 0.1f, 0.1f, 0.12f, 1.0f );
+	scene.gpuProfile = false;		// one printout per renderer would interleave
+	return scene;
+}
 
-// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-// -=-=-=-=-=-=-=- render -=-=-=-=-=-=-=-=-
-// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-void render()
-{
-	// SHADOWS:
-	// Set up a cubemap and render depth information
-	float far_plane = 100.0f;
-	processShadows( far_plane );
-	
-	
-	// COLOR:
-	// Render color information (including shadows) and pass only highlights
-	// into secondary buffer, to be processed later
-	glUseProgram( gProgramID );
-	
-	// Submit scene transform matrices
-	glm::mat3 matNormal(1.0f); // declare a matrix specific to only modifying normals
-	
-	int viewLocation = glGetUniformLocation( gProgramID, "view" );
-	shaderSendMatrix( viewLocation, view );
-	
-	int projLocation = glGetUniformLocation( gProgramID, "projection" );
-	shaderSendMatrix( projLocation, proj );
-	
-	int modelLocation = glGetUniformLocation( gProgramID, "model" );
-	int normalLocation = glGetUniformLocation( gProgramID, "normal_matrix" );
-	
-	// Calculate light's 2D position in screen space
-	glm::mat4 transform = proj * view;
-	glm::vec4 lightPosition2D( lightPos.x, lightPos.y, lightPos.z, 1.0f );
-	lightPosition2D = transform * lightPosition2D;
-	
-	lightPosition2D.x /= lightPosition2D.w;
-	lightPosition2D.y /= lightPosition2D.w;
-	lightPosition2D.x += 1.0f;
-	lightPosition2D.y += 1.0f;
-	lightPosition2D.x *= SCREEN_WIDTH / 2;
-	lightPosition2D.y *= SCREEN_HEIGHT / 2;	
-	
-	// Prepare scene lighting
-	glUniform3f( glGetUniformLocation( gProgramID, "lightColor" ), 10.f, 9.f, 5.f );
-	glUniform3f( glGetUniformLocation( gProgramID, "lightPos" ), lightPos.x, lightPos.y, lightPos.z );
-	glUniform3f( glGetUniformLocation( gProgramID, "viewPos" ), viewPos.x, viewPos.y, viewPos.z );
-	glUniform1f( glGetUniformLocation( gProgramID, "far_plane" ), far_plane );
-	glUniform2f( glGetUniformLocation( gProgramID, "lightPos2D" ), lightPosition2D.x, lightPosition2D.y );
-	
-	glBindFramebuffer( GL_FRAMEBUFFER, gFBO );
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-	
-	// Texture0 - Regular color object texture (set in rendering functions)
-	// Texture1 - cubemap depth info for shadows
-	glActiveTexture( GL_TEXTURE1 );
-	glBindTexture( GL_TEXTURE_CUBE_MAP, gShadowBuffer );
-	
-    // DRAW THE FLOOR
-    // Update the floor's transform matrix
-    shaderSendMatrix( modelLocation, matFloor );
-    
-	// Calculate the normals for the floor
-	matNormal = getNormalMatrix( matFloor );
-	shaderSendMatrix( normalLocation, matNormal );
-	
-	// Render the floor's textured geometry
-	if( DRAW_FLOOR ) renderFloor();
-	
-	// Draw a fullbright mini cube at the Light's position
-	glm::mat4 lightTranslate = glm::translate( glm::mat4(1.0f), lightPos );
-	glm::mat4 lightScale = glm::scale( glm::mat4( 1.0f ), glm::vec3( 0.1f, 0.1f, 0.1f ) );
-	glm::mat4 light_matrix = lightTranslate * lightScale;
-	
-	shaderSendMatrix( modelLocation, light_matrix );
-	glUniform1i( glGetUniformLocation( gProgramID, "fullbright" ), true );
-	renderCube();
-	glUniform1i( glGetUniformLocation( gProgramID, "fullbright" ), false );
-	
-	// Draw cube last, allows for transparency
-	matNormal = getNormalMatrix( model );
-	shaderSendMatrix( normalLocation, matNormal );
-	shaderSendMatrix( modelLocation, model );
-	if( DRAW_CUBE ) renderCube();
-	
-	
-    // GAUSSIAN BLUR:
-    // Blur the secondary highlight buffer
-    bool horizontal = true, first_iteration = true;
-    unsigned int amount = BlurAmount, index, inverse;
-    glUseProgram( gBlurProgram );
-    for (unsigned int i = 0; i < amount; i++)
-    {
-    	if( horizontal ){ index = 1; inverse = 0; }
-    	else { index = 0; inverse = 1; }
-    	
-        glBindFramebuffer( GL_FRAMEBUFFER, gBlurFBOs[index] );
-        glUniform1i( glGetUniformLocation( gBlurProgram, "horizontal" ), horizontal );
-        glBindTexture( GL_TEXTURE_2D, first_iteration ? gColorBuffers[1] : gBlurColorBuffers[inverse] );  // bind texture of other framebuffer (or scene if first iteration)
-        renderQuad();
-        horizontal = !horizontal;
-        if (first_iteration)
-            first_iteration = false;
-    }
-    
-    
-    // BLOOM:
-    // Additive blending of main color buffer and blurred "bloom" buffer
-	glUseProgram( gBloomProgram );
+// Called with the main context current, leaves the worker's current
+bool createBatchWorker( batch_worker_t &worker, const scene_assets_t &assets ){
+	worker.state = NULL;
+	worker.fbo = worker.color = 0;
+	worker.window = SDL_CreateWindow( "Shader Demo batch", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN );
+	worker.context = worker.window ? SDL_GL_CreateContext( worker.window ) : NULL;
+	if( worker.context == NULL ){
+		printf( "WARNING: Batch renderer context could not be created! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+	worker.state = stateCreate();
+	stateMakeCurrent( worker.state );
+	if( !worker.scene.init( assets, BATCH_WIDTH, BATCH_HEIGHT ) )
+		return false;
 	
-	// We must draw onto yet another offscreen buffer if we're in "Lo-Res" mode, otherwise draw right to the screen
-	if( USE_LORES )
-		glBindFramebuffer( GL_FRAMEBUFFER, gLoresFBO );	// Copy to Lores framebuffer, for later
-	else
-		glBindFramebuffer( GL_FRAMEBUFFER, 0 );	// Draw directly to screen surface
+	glGenTextures( 1, &worker.color );
+	stateBindTexture( 0, GL_TEXTURE_2D, worker.color );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, BATCH_WIDTH, BATCH_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	gpuMemoryTrack( GPU_MEM_TEXTURE, worker.color, "batch", "image", BATCH_WIDTH * BATCH_HEIGHT * 4 );
+	
+	glGenFramebuffers( 1, &worker.fbo );
+	stateBindFramebuffer( GL_FRAMEBUFFER, worker.fbo );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, worker.color, 0 );
+	bool complete = glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+	stateBindFramebuffer( GL_FRAMEBUFFER, 0 );
+	if( !complete ) printf( "WARNING: Batch renderer framebuffer is not complete!\n" );
+	return complete;
+}
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    // Pass along rendering parameters we can control programatically, using keyboard input
-	glUniform1i( glGetUniformLocation( gBloomProgram, "bloom" ), BLOOM );
-    glUniform1f( glGetUniformLocation( gBloomProgram, "exposure" ), EXPOSURE );
-    
-    // Texture0 = regular scene color information
-	glActiveTexture( GL_TEXTURE0 );
-    glBindTexture( GL_TEXTURE_2D, gColorBuffers[0] );
-    
-    // Texture1 - Highlights-only that have been blurred, will be drawn using additive blending within shader
-	glActiveTexture( GL_TEXTURE1 );
-    glBindTexture( GL_TEXTURE_2D, gBlurColorBuffers[!horizontal] );
+// On the main thread, after the worker's thread let go of its context
+void destroyBatchWorker( batch_worker_t &worker ){
+	if( worker.context ){
+		SDL_GL_MakeCurrent( worker.window, worker.context );
+		stateMakeCurrent( worker.state );
+		stateForgetFramebuffer( worker.fbo );
+		glDeleteFramebuffers( 1, &worker.fbo );
+		stateForgetTexture( worker.color );
+		gpuMemoryUntrack( GPU_MEM_TEXTURE, worker.color );
+		glDeleteTextures( 1, &worker.color );
+		worker.scene.close();
+		stateMakeCurrent( NULL );
+		stateDestroy( worker.state );
+		SDL_GL_DeleteContext( worker.context );
+	}
+	if( worker.window ) SDL_DestroyWindow( worker.window );
+	worker.window = NULL;
+	worker.context = NULL;
+	worker.state = NULL;
+	worker.fbo = worker.color = 0;
+}
 
-    renderQuad();
-    
-    // If we are using Lo-Res mode, scale up the drawing viewport, and remove texture filtering (more pixels!!!)
-    if( USE_LORES ){
-    	glUseProgram( gScreenProgram );
-		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-		glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-		glActiveTexture( GL_TEXTURE0 );
-		glBindTexture( GL_TEXTURE_2D, gLoresColorBuffer );
-		glViewport( 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT );
-		renderQuad();
-		glViewport( 0, 0, LORES_WIDTH, LORES_HEIGHT );
-    }
+int batchThread( void *data ){
+	batch_worker_t *worker = (batch_worker_t*)data;
+	size_t rowBytes = BATCH_WIDTH * 4;
+	size_t imageBytes = rowBytes * BATCH_HEIGHT;
+	std::vector<unsigned char> row( rowBytes );
+	
+	CPU_PROFILER_THREAD( "batch" );
+	if( SDL_GL_MakeCurrent( worker->window, worker->context ) < 0 ){
+		printf( "ERROR: Batch thread could not make its OpenGL context current! SDL Error: %s\n", SDL_GetError() );
+		CPU_PROFILER_THREAD_END();
+		return 1;
+	}
+	stateMakeCurrent( worker->state );
+	worker->scene.makeCurrent();
+	
+	for( ;; ){
+		unsigned int i = SDL_AtomicAdd( worker->next, 1 );
+		if( i >= worker->images ) break;
+		unsigned char *image = worker->pixels + i * imageBytes;
+		
+		worker->scene.render( batchView( i, worker->images ), worker->fbo );
+		stateBindFramebuffer( GL_READ_FRAMEBUFFER, worker->fbo );
+		glReadPixels( 0, 0, BATCH_WIDTH, BATCH_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, image );
+		
+		// GL's rows go bottom up
+		for( unsigned int y = 0; y < BATCH_HEIGHT / 2; y++ ){
+			unsigned char *top = image + y * rowBytes;
+			unsigned char *bottom = image + ( BATCH_HEIGHT - 1 - y ) * rowBytes;
+			memcpy( &row[0], top, rowBytes );
+			memcpy( top, bottom, rowBytes );
+			memcpy( bottom, &row[0], rowBytes );
+		}
+	}
+	worker->ok = true;
+	
+	stateMakeCurrent( NULL );
+	SDL_GL_MakeCurrent( worker->window, NULL );
+	CPU_PROFILER_THREAD_END();
+	return 0;
 }
 
+// the whole batch on the first 'count' workers, in ms
+double renderBatch( batch_worker_t *workers, unsigned int count, unsigned int images, unsigned char *pixels ){
+	SDL_Thread *threads[BATCH_MAX_RENDERERS];
+	SDL_atomic_t next;
+	
+	SDL_AtomicSet( &next, 0 );
+	Uint64 start = SDL_GetPerformanceCounter();
+	for( unsigned int i = 0; i < count; i++ ){
+		workers[i].next = &next;
+		workers[i].images = images;
+		workers[i].pixels = pixels;
+		workers[i].ok = false;
+		threads[i] = SDL_CreateThread( batchThread, "batch", &workers[i] );
+		if( threads[i] == NULL ) printf( "WARNING: Could not start batch thread %u! SDL Error: %s\n", i, SDL_GetError() );
+	}
+	for( unsigned int i = 0; i < count; i++ ){
+		if( threads[i] ) SDL_WaitThread( threads[i], NULL );
+		if( !workers[i].ok ) printf( "WARNING: Batch renderer %u did not render!\n", i );
+	}
+	return 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency();
+}
 
+// Thumbnails of the scene from all around, once on a single scene renderer and once on one
+// per core, each on its own thread and context. The main context only holds the shared
+// geometry and textures.
+int runBatchRenderer( unsigned int images ){
+	batch_worker_t workers[BATCH_MAX_RENDERERS];
+	scene_assets_t assets;
+	SDL_Window *window = NULL;
+	SDL_GLContext context = NULL;
+	unsigned int count = 0;
+	bool ok = false;
+	
+	CPU_PROFILER_THREAD( "main" );
+	if( SDL_Init( SDL_INIT_VIDEO ) < 0 ){
+		printf( "ERROR: SDL could not initialize! SDL Error: %s\n", SDL_GetError() );
+		return 1;
+	}
+	IMG_Init( IMG_INIT_PNG );
+	initJobs();
+	
+	// like init(): 4.3 for the compute post path, else 3.1
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 4 );
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 3 );
+	SDL_GL_SetAttribute( SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE );
+	window = SDL_CreateWindow( "Shader Demo batch", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 1, 1, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN );
+	if( window ){
+		context = SDL_GL_CreateContext( window );
+		if( context == NULL ){
+			printf( "WARNING: OpenGL 4.3 context could not be created, trying 3.1...\n" );
+			SDL_GL_SetAttribute( SDL_GL_CONTEXT_MAJOR_VERSION, 3 );
+			SDL_GL_SetAttribute( SDL_GL_CONTEXT_MINOR_VERSION, 1 );
+			context = SDL_GL_CreateContext( window );
+		}
+	}
+	GLenum glewError = GLEW_OK;
+	if( context ){
+		glewExperimental = GL_TRUE;
+		glewError = glewInit();
+	}
+	if( context == NULL || glewError != GLEW_OK ){
+		if( context == NULL ) printf( "ERROR: OpenGL context could not be created! SDL Error: %s\n", SDL_GetError() );
+		else printf( "ERROR: Could not initialize GLEW: %s\n", glewGetErrorString( glewError ) );
+		
+		// nothing of ours was made in the context yet, only it and the window go
+		if( context ) SDL_GL_DeleteContext( context );
+		if( window ) SDL_DestroyWindow( window );
+		closeJobs();
+		IMG_Quit();
+		SDL_Quit();
+		return 1;
+	}
+	
+	// shared by every renderer, nothing writes to these once they're made
+	if( createSceneAssets( assets ) ){
+		// each worker's context joins the main one's objects, then holds its own scene renderer
+		unsigned int wanted = std::max( 1, std::min( SDL_GetCPUCount(), (int)BATCH_MAX_RENDERERS ) );
+		SDL_GL_SetAttribute( SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1 );
+		for( ; count < wanted; count++ ){
+			SDL_GL_MakeCurrent( window, context );
+			bool created = createBatchWorker( workers[count], assets );
+			stateMakeCurrent( NULL );
+			SDL_GL_MakeCurrent( window, NULL );		// the worker's context goes to its thread
+			if( !created ){
+				destroyBatchWorker( workers[count] );
+				break;
+			}
+		}
+		SDL_GL_MakeCurrent( window, context );
+	}
+	else printf( "ERROR: Scene textures could not be loaded!\n" );
+	
+	if( count > 0 ){
+		std::vector<unsigned char> pixels( (size_t)images * BATCH_WIDTH * BATCH_HEIGHT * 4 );
+		
+		printf( "ATTEMPT: Rendering %u images of %ux%u offscreen...\n", images, BATCH_WIDTH, BATCH_HEIGHT );
+		double singleMs = renderBatch( workers, 1, images, &pixels[0] );
+		double batchMs = count > 1 ? renderBatch( workers, count, images, &pixels[0] ) : singleMs;
+		printf( "SUCCESS: %u images, %.2f ms on one renderer, %.2f ms on %u (%.1fx), %.0f images a second\n", images,
+				singleMs, batchMs, count, singleMs / batchMs, 1000.0 * images / batchMs );
+		
+		// PNG encoding needs no GL, the job workers take it
+		SDL_atomic_t failed;
+		SDL_AtomicSet( &failed, 0 );
+		std::string prefix = SDL_GetBasePath() + std::string( BATCH_FILE );
+		parallelFor( images, 1, [&]( unsigned int begin, unsigned int end, unsigned int ){
+			char path[1024];
+			for( unsigned int i = begin; i < end; i++ ){
+				SDL_Surface *shot = SDL_CreateRGBSurfaceWithFormatFrom( &pixels[(size_t)i * BATCH_WIDTH * BATCH_HEIGHT * 4], BATCH_WIDTH, BATCH_HEIGHT,
+																		32, BATCH_WIDTH * 4, SDL_PIXELFORMAT_RGBA32 );
+				snprintf( path, sizeof( path ), "%s_%03u.png", prefix.c_str(), i );
+				if( shot == NULL || IMG_SavePNG( shot, path ) != 0 ) SDL_AtomicAdd( &failed, 1 );
+				if( shot ) SDL_FreeSurface( shot );
+			}
+		} );
+		ok = SDL_AtomicGet( &failed ) == 0;
+		if( ok ) printf( "SUCCESS: Images saved to %s_000.png and on\n", prefix.c_str() );
+		else printf( "ERROR: Could not save %d of the images!\n", SDL_AtomicGet( &failed ) );
+	}
+	
+	for( unsigned int i = 0; i < count; i++ )
+		destroyBatchWorker( workers[i] );
+	SDL_GL_MakeCurrent( window, context );
+	destroySceneAssets( assets );
+	SDL_GL_DeleteContext( context );
+	SDL_DestroyWindow( window );
+	closeJobs();
+	IMG_Quit();
+	SDL_Quit();
+	return ok ? 0 : 1;
+}
 
 // -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
 // -=-=-=-=-=- main -=-=-=-=-=-=-=-=-=-=-
 // -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
-int main() {
+int main( int argc, char *argv[] ) {
 	bool quit = false;
 	SDL_Event e;
 	
-	unsigned int lastTick, currentTick=SDL_GetTicks();
+	Uint64 lastTick, currentTick=SDL_GetPerformanceCounter();
+	double tickFrequency = (double)SDL_GetPerformanceFrequency();
 	float delta;
+	SDL_Thread *renderer = NULL;
+	
+	for( int i = 1; i + 1 < argc; i++ ){
+		if( strcmp( argv[i], "--capture" ) != 0 ) continue;
+		CAPTURE_FORMAT = findCaptureFormat( argv[i + 1] );
+		CAPTURE = CAPTURE_FORMAT != CAPTURE_FORMAT_COUNT;
+		if( !CAPTURE ){
+			printf( "ERROR: Usage is --capture <raw|png|y4m>\n" );
+			return 1;
+		}
+	}
+	
+	for( int i = 1; i < argc; i++ )
+		if( strcmp( argv[i], "--soft" ) == 0 ) return runSoftRenderer();
+	if( argc > 1 && strcmp( argv[1], "--filters" ) == 0 ) return runImageFilters( argc, argv );
+	if( argc > 1 && strcmp( argv[1], "--batch" ) == 0 )
+		return runBatchRenderer( argc > 2 && atoi( argv[2] ) > 0 ? atoi( argv[2] ) : BATCH_IMAGES );
+	
+	CPU_PROFILER_THREAD( "main" );
 
 	// Init SDL
 	if( init() ){
@@ -824,8 +824,20 @@ int main() {
 		// Use key input for our program
 		SDL_StartTextInput();
 		
-		// Bind our "scene" shader
-		glUseProgram( gProgramID );
+		// The first snapshot has to exist before anything renders
+		publishFrame();
+		
+		if( USE_RENDER_THREAD ){
+			// a context is current on one thread at a time, let go of it here
+			SDL_AtomicSet( &gRenderQuit, 0 );
+			SDL_GL_MakeCurrent( gWindow, NULL );
+			renderer = SDL_CreateThread( renderThread, "render", NULL );
+			if( renderer == NULL ){
+				printf( "WARNING: Could not start the render thread, rendering on the main thread! SDL Error: %s\n", SDL_GetError() );
+				SDL_GL_MakeCurrent( gWindow, gContext );
+			}
+			else printf( "SUCCESS: Render thread started...\n" );
+		}
 		
 	    ////////////////////////////
 	    //////// Main Loop /////////
@@ -834,9 +846,9 @@ int main() {
 	    	
 			// calculate the time difference since the last loop
 			lastTick = currentTick;
-	    	currentTick = SDL_GetTicks();
+	    	currentTick = SDL_GetPerformanceCounter();
 	    	
-	    	delta = (float)(currentTick - lastTick) / 16.666666666667f;	// SDL is locked in at 60 fps... usually...
+	    	delta = (float)( 1000.0 * ( currentTick - lastTick ) / tickFrequency ) / 16.666666666667f;	// in 60 fps frames
 	    	
 	    	
 	        //Handle events on queue
@@ -846,6 +858,16 @@ int main() {
 	            if( e.type == SDL_QUIT ){
 	                quit = true;
 	            }
+	            //Window resized, the renderer picks the new size up from the next snapshot
+	            else if( e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED )
+	            {
+	                int w = 0, h = 0;
+	                SDL_GL_GetDrawableSize( gWindow, &w, &h );
+	                if( w > 0 && h > 0 ){
+	                    gDrawableWidth = w;
+	                    gDrawableHeight = h;
+	                }
+	            }
 	            //Handle keypress with current mouse position
 	            else if( e.type == SDL_TEXTINPUT )
 	            {
@@ -857,20 +879,37 @@ int main() {
 	        
 	        // update scene
 	        update( delta );
+	        publishFrame();
 	        
-	        // render scene
-	        render();
-	        
-	        // draw to screen
-	        SDL_GL_SwapWindow( gWindow );
+	        if( renderer ){
+	        	// the render thread picks the snapshot up whenever it's ready for one,
+	        	// keep ticking at our own pace in the meantime
+	        	unsigned int spent = (unsigned int)( 1000.0 * ( SDL_GetPerformanceCounter() - currentTick ) / tickFrequency );
+	        	if( spent < SIM_STEP_MS ) SDL_Delay( SIM_STEP_MS - spent );
+	        }
+	        else {
+	        	// render scene and draw to screen
+	        	renderFrame();
+	        }
 	        
 		} printf( "ATTEMPT: Exiting loop, cleaning up...\n" );
+		
+		if( renderer ){
+			SDL_AtomicSet( &gRenderQuit, 1 );
+			SDL_WaitThread( renderer, NULL );
+			SDL_GL_MakeCurrent( gWindow, gContext );
+		}
+	}
+	else {
+		// the context may not exist, none of the GL teardown below is safe
+		SDL_Quit();
+		return 1;
 	}
 	
 	SDL_StopTextInput();
 
 	// exit the shader program
-	glUseProgram( 0 );
+	stateUseProgram( 0 );
 	
     // clean up
     close();
@@ -880,38 +919,10 @@ int main() {
 }
 
 void close(){
-	glDeleteBuffers( 1, &VBO_screen );
-	glDeleteBuffers( 1, &EBO_screen );
-	glDeleteBuffers( 1, &gVBO );
-	glDeleteBuffers( 1, &gEBO );
-	glDeleteBuffers( 1, &gVBOfloor );
-	glDeleteBuffers( 1, &gEBOfloor );
-
-	glDeleteVertexArrays( 1, &gVAOfloor );
-	glDeleteVertexArrays( 1, &gVAO );
-	glDeleteVertexArrays( 1, &VAO_screen );
-	
-	glDeleteFramebuffers( 1, &gRaysFBO );
-	glDeleteFramebuffers( 1, &gShadowFBO );
-	glDeleteFramebuffers( 1, &gLoresFBO );
-	glDeleteFramebuffers( 1, &gFBO );
-	glDeleteFramebuffers( 2, gBlurFBOs );
-	glDeleteRenderbuffers( 1, &gRBO );
-	
-	glDeleteTextures( 1, &gRaysBuffer );
-	glDeleteTextures( 1, &gShadowBuffer );
-	glDeleteTextures( 1, &gLoresColorBuffer );
-	glDeleteTextures( 1, &gFloortex );
-	glDeleteTextures( 1, &gTex );
-	glDeleteTextures( 2, gColorBuffers );
-	glDeleteTextures( 2, gBlurColorBuffers );
-	
-	glDeleteProgram( gRaysProgram );
-	glDeleteProgram( gScreenProgram );
-	glDeleteProgram( gProgramID );
-	glDeleteProgram( gBlurProgram );
-	glDeleteProgram( gBloomProgram );
-	glDeleteProgram( gShadowProgram );
+	stopCapture();		// before the context goes, it finishes the readbacks in flight
+	gScene.close();
+	destroySceneAssets( gAssets );
+	closeJobs();
 
 	SDL_DestroyWindow( gWindow );
 	SDL_GL_DeleteContext( gContext );
@@ -945,6 +956,63 @@ void handleKeys( unsigned char key, int x, int y ){
     if( key == 'f' )
     	DRAW_FLOOR = !DRAW_FLOOR;
     	
+    if( key == 'p' )
+    	COMPUTE_POST = !COMPUTE_POST;
+    	
+    if( key == 'g' )
+    	GRAYSCALE = !GRAYSCALE;
+    	
+    if( key == 'h' )
+    	POST_KERNEL = (post_kernel_t)( ( POST_KERNEL + 1 ) % POST_KERNEL_COUNT );
+    	
+    if( key == 'i' )
+    	gStatsRequests++;	// printed by the render thread, the state cache belongs to it
+    	
+    if( key == 'b' )
+    	benchmarkDrawQueue( 100000, 30 );
+    	
+    if( key == 't' )
+    	CPU_PROFILER_EXPORT( "cpu_trace.json" );
+    	
+    if( key == 'v' )
+    	LORES = !LORES;
+    	
+    if( key == 'r' )
+    	DYNAMIC_RES = !DYNAMIC_RES;
+    	
+    if( key == 'y' )
+    	GODRAYS = !GODRAYS;
+    	
+    if( key == 'j' )
+    	CLUSTER_LIGHTS = ( CLUSTER_LIGHTS + 1 ) % CLUSTER_LIGHT_STEPS;
+    	
+    if( key == '4' )
+    	gLightBenchRequests++;	// run by the render thread
+    	
+    if( key == '5' )
+    	SHADOW_LIGHTS = SHADOW_LIGHTS % SHADOW_MAX_LIGHTS + 1;
+    	
+    if( key == '6' )
+    	OIT = !OIT;
+    	
+    if( key == '7' )
+    	CAPTURE = !CAPTURE;		// started and stopped by the render thread
+    	
+    if( key == 'd' )
+    	DEPTH_PREPASS = !DEPTH_PREPASS;
+    	
+    if( key == 'e' )
+    	COMPACT_TARGETS = !COMPACT_TARGETS;
+    	
+    if( key == 'u' )
+    	gpuMemoryReport();
+    	
+    if( key == 'n' )
+    	GPU_PROFILE = !GPU_PROFILE;
+    	
+    if( key == 'm' )
+    	CUBE_FIELD = !CUBE_FIELD;
+    	
     if( key == 'l' )
     	lightDistance += 1.0f;
     	
@@ -958,13 +1026,13 @@ void handleKeys( unsigned char key, int x, int y ){
     	lightPos.y -= 1.0f;
     	
     if( key == '1' )
-    	glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
+    	gClearColor = glm::vec4( 0.0f, 0.0f, 0.0f, 1.0f );
     	
     if( key == '2' )
-    	glClearColor( 1.0f, 1.0f, 1.0f, 1.0f );
+    	gClearColor = glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f );
     	
     if( key == '3' )
-    	glClearColor( 0.1f, 0.2f, 0.3f, 1.0f );
+    	gClearColor = glm::vec4( 0.1f, 0.2f, 0.3f, 1.0f );
     	
     if( BlurAmount < 2 ) BlurAmount = 2;
     if( EXPOSURE < 0.0f ) EXPOSURE = 0.0f;
@@ -987,13 +1055,6 @@ void setMat4(unsigned int &ID, const std::string &name, const glm::mat4 &mat)
     glUniformMatrix4fv( loc, 1, GL_FALSE, &mat[0][0] );
 }
 
-void setViewport(){
-	if( USE_LORES )
-		glViewport( 0, 0, LORES_WIDTH, LORES_HEIGHT );
-	else
-		glViewport( 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT );
-}
-
 glm::mat3 getNormalMatrix( glm::mat4 inMatrix ){
 	return glm::transpose( glm::inverse( inMatrix ) );
 }
@@ -0,0 +1,246 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "post_compute.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include <algorithm>
+
+////////////////////////////////
+////// POST_COMPUTE.CPP ////////
+////////////////////////////////
+
+const unsigned int POST_TILE = 16;	// must match local_size in cblur.txt and cpost.txt
+
+struct compute_post_t {
+	bool available;
+	unsigned int width;
+	unsigned int height;
+	unsigned int regionWidth;	// area processed by the last run
+	unsigned int regionHeight;
+	
+	GLuint blurProgram;
+	GLuint postProgram;
+	
+	GLuint blurBuffers[2];		// ping-pong targets for the blur, r11f_g11f_b10f for imageStore
+	GLuint output;				// final tonemapped image, rgba8
+	GLuint outputFBO;			// read framebuffer used to blit the output to screen
+};
+
+compute_post_t gCompute;						// used while no renderer installed its own
+thread_local compute_post_t *tCompute = NULL;	// programs and targets of this thread's context
+
+inline compute_post_t &currentComputePost(){
+	return tCompute ? *tCompute : gCompute;
+}
+
+compute_post_t *computePostCreate(){
+	return new compute_post_t();
+}
+
+void computePostDestroy( compute_post_t *compute ){
+	if( tCompute == compute ) tCompute = NULL;
+	delete compute;
+}
+
+void computePostMakeCurrent( compute_post_t *compute ){
+	tCompute = compute;
+}
+
+// 3x3 kernels, top-left to bottom-right: none, binomial blur, sharpen. The fragment path
+// runs the same weights through fconvolve.txt
+const float POST_KERNELS[POST_KERNEL_COUNT][9] = {
+	{ 0.0f, 0.0f, 0.0f,
+	  0.0f, 1.0f, 0.0f,
+	  0.0f, 0.0f, 0.0f },
+	{ 1.0f / 16, 2.0f / 16, 1.0f / 16,
+	  2.0f / 16, 4.0f / 16, 2.0f / 16,
+	  1.0f / 16, 2.0f / 16, 1.0f / 16 },
+	{ -1.0f, -1.0f, -1.0f,
+	  -1.0f,  9.0f, -1.0f,
+	  -1.0f, -1.0f, -1.0f }
+};
+
+GLuint createComputeTarget( GLenum internalformat, unsigned int width, unsigned int height, const char *label ){
+	GLuint tex;
+	glGenTextures( 1, &tex );
+	stateBindTexture( 0, GL_TEXTURE_2D, tex );
+	glTexStorage2D( GL_TEXTURE_2D, 1, internalformat, width, height );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	gpuMemoryTrack( GPU_MEM_TEXTURE, tex, "compute post", label, textureBytes( internalformat, width, height ) );
+	return tex;
+}
+
+void createComputeTargets( unsigned int width, unsigned int height ){
+	compute_post_t &compute = currentComputePost();
+	compute.width = width;
+	compute.height = height;
+	
+	compute.blurBuffers[0] = createComputeTarget( GL_R11F_G11F_B10F, width, height, "blur 0" );
+	compute.blurBuffers[1] = createComputeTarget( GL_R11F_G11F_B10F, width, height, "blur 1" );
+	compute.output = createComputeTarget( GL_RGBA8, width, height, "output" );
+	compute.regionWidth = width;
+	compute.regionHeight = height;
+	
+	// sampled by the upscale filter when rendering below full resolution
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	
+	if( !compute.outputFBO ) glGenFramebuffers( 1, &compute.outputFBO );
+	stateBindFramebuffer( GL_FRAMEBUFFER, compute.outputFBO );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, compute.output, 0 );
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		printf( "ERROR: Create compute output framebuffer failed!\n" );
+	stateBindFramebuffer( GL_FRAMEBUFFER, 0 );
+}
+
+void deleteComputeTargets(){
+	compute_post_t &compute = currentComputePost();
+	stateForgetTexture( compute.output );
+	stateForgetTexture( compute.blurBuffers[0] );
+	stateForgetTexture( compute.blurBuffers[1] );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, compute.output );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, compute.blurBuffers[0] );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, compute.blurBuffers[1] );
+	glDeleteTextures( 1, &compute.output );
+	glDeleteTextures( 2, compute.blurBuffers );
+	compute.output = 0;
+	compute.blurBuffers[0] = compute.blurBuffers[1] = 0;
+}
+
+bool initComputePost( unsigned int width, unsigned int height ){
+	compute_post_t &compute = currentComputePost();
+	compute.available = false;
+	
+	// compute shaders and image load/store need a 4.3 context
+	if( !GLEW_VERSION_4_3 ){
+		printf( "WARNING: OpenGL 4.3 not available, compute post-processing disabled.\n" );
+		return false;
+	}
+	
+	if( loadComputeProgram( compute.blurProgram, "cblur.txt" ) == false ){
+		printf( "ERROR: Loading compute blur program failed!\n" );
+		return false;
+	}
+	
+	if( loadComputeProgram( compute.postProgram, "cpost.txt" ) == false ){
+		printf( "ERROR: Loading compute post program failed!\n" );
+		glDeleteProgram( compute.blurProgram );
+		compute.blurProgram = 0;
+		return false;
+	}
+	
+	createComputeTargets( width, height );
+	
+	// sampler units never change
+	stateUseProgram( compute.blurProgram );
+	glUniform1i( glGetUniformLocation( compute.blurProgram, "image" ), 0 );
+	
+	stateUseProgram( compute.postProgram );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "scene" ), 0 );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "bloomBlur" ), 1 );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "depthMap" ), 2 );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "rays" ), 3 );
+	
+	compute.available = true;
+	printf( "SUCCESS: Compute post-processing initialized...\n" );
+	return true;
+}
+
+bool computePostAvailable(){
+	return currentComputePost().available;
+}
+
+void resizeComputePost( unsigned int width, unsigned int height ){
+	compute_post_t &compute = currentComputePost();
+	if( !compute.available || ( width == compute.width && height == compute.height ) ) return;
+	
+	// immutable storage can't be resized, start over
+	deleteComputeTargets();
+	createComputeTargets( width, height );
+}
+
+GLuint computePostOutput(){
+	return currentComputePost().output;
+}
+
+void runComputePost( GLuint sceneTex, GLuint brightTex, const post_params_t &params ){
+	compute_post_t &compute = currentComputePost();
+	compute.regionWidth = params.width ? std::min( params.width, compute.width ) : compute.width;
+	compute.regionHeight = params.height ? std::min( params.height, compute.height ) : compute.height;
+	
+	GLuint groupsX = ( compute.regionWidth + POST_TILE - 1 ) / POST_TILE;
+	GLuint groupsY = ( compute.regionHeight + POST_TILE - 1 ) / POST_TILE;
+	GLuint bloomTex = brightTex;
+	
+	// GAUSSIAN BLUR:
+	// every dispatch does a horizontal and a vertical pass, so half as many as the fragment path
+	if( params.bloom ){
+		unsigned int dispatches = ( params.blurAmount + 1 ) / 2;
+		
+		stateUseProgram( compute.blurProgram );
+		glUniform2i( glGetUniformLocation( compute.blurProgram, "region" ), compute.regionWidth, compute.regionHeight );
+		for( unsigned int i = 0; i < dispatches; i++ ){
+			GLuint target = compute.blurBuffers[i % 2];
+			
+			stateBindTexture( 0, GL_TEXTURE_2D, bloomTex );
+			glBindImageTexture( 0, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R11F_G11F_B10F );
+			glDispatchCompute( groupsX, groupsY, 1 );
+			
+			// next dispatch samples what this one wrote
+			glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT );
+			bloomTex = target;
+		}
+	}
+	
+	// COMPOSITE + FILTER CHAIN:
+	stateUseProgram( compute.postProgram );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "bloom" ), params.bloom );
+	glUniform1f( glGetUniformLocation( compute.postProgram, "exposure" ), params.exposure );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "useKernel" ), params.kernel != POST_KERNEL_NONE );
+	glUniform1fv( glGetUniformLocation( compute.postProgram, "kernel" ), 9, POST_KERNELS[params.kernel] );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "grayscale" ), params.grayscale );
+	glUniform1i( glGetUniformLocation( compute.postProgram, "quantize" ), params.quantize );
+	glUniform2i( glGetUniformLocation( compute.postProgram, "region" ), compute.regionWidth, compute.regionHeight );
+	
+	glUniform1i( glGetUniformLocation( compute.postProgram, "godrays" ), params.raysTex != 0 );
+	if( params.raysTex ){
+		glUniform2f( glGetUniformLocation( compute.postProgram, "raysUvScale" ), params.raysUvScale.x, params.raysUvScale.y );
+		glUniform2i( glGetUniformLocation( compute.postProgram, "raysArea" ), params.raysWidth, params.raysHeight );
+		glUniform1f( glGetUniformLocation( compute.postProgram, "nearPlane" ), params.nearPlane );
+		glUniform1f( glGetUniformLocation( compute.postProgram, "farPlane" ), params.farPlane );
+		stateBindTexture( 2, GL_TEXTURE_2D, params.depthTex );
+		stateBindTexture( 3, GL_TEXTURE_2D, params.raysTex );
+	}
+	
+	stateBindTexture( 0, GL_TEXTURE_2D, sceneTex );
+	stateBindTexture( 1, GL_TEXTURE_2D, bloomTex );
+	glBindImageTexture( 0, compute.output, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8 );
+	glDispatchCompute( groupsX, groupsY, 1 );
+	
+	// the output is read back by a framebuffer blit
+	glMemoryBarrier( GL_FRAMEBUFFER_BARRIER_BIT );
+}
+
+void blitComputePost( GLuint targetFBO, int width, int height, bool filtering ){
+	compute_post_t &compute = currentComputePost();
+	stateBindFramebuffer( GL_READ_FRAMEBUFFER, compute.outputFBO );
+	stateBindFramebuffer( GL_DRAW_FRAMEBUFFER, targetFBO );
+	glBlitFramebuffer( 0, 0, compute.regionWidth, compute.regionHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, filtering ? GL_LINEAR : GL_NEAREST );
+	stateBindFramebuffer( GL_FRAMEBUFFER, targetFBO );
+}
+
+void closeComputePost(){
+	compute_post_t &compute = currentComputePost();
+	stateForgetFramebuffer( compute.outputFBO );
+	glDeleteFramebuffers( 1, &compute.outputFBO );
+	compute.outputFBO = 0;
+	deleteComputeTargets();
+	glDeleteProgram( compute.blurProgram );
+	glDeleteProgram( compute.postProgram );
+	compute.available = false;
+}
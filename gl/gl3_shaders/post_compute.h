@@ -0,0 +1,56 @@
+#ifndef POST_COMPUTE_H
+#define POST_COMPUTE_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+////// POST_COMPUTE HEADER ////////
+///////////////////////////////////
+
+// GL 4.3 compute shader backend for the post-processing filters.
+// The Gaussian blur runs both directions per dispatch from a shared memory tile, and the
+// bloom and god rays composite, 3x3 kernel, grayscale and quantize effects are fused into one dispatch.
+
+typedef enum {
+	POST_KERNEL_NONE,
+	POST_KERNEL_BLUR,
+	POST_KERNEL_SHARPEN,
+	POST_KERNEL_COUNT } post_kernel_t ;
+
+// 3x3 weights per post_kernel_t, top-left to bottom-right, for both post paths
+extern const float POST_KERNELS[POST_KERNEL_COUNT][9];
+
+typedef struct {
+	bool bloom;
+	float exposure;
+	unsigned int blurAmount;	// fragment blur passes to match, two per dispatch
+	post_kernel_t kernel;
+	bool grayscale;
+	int quantize;				// colour levels per channel, 0 = off
+	unsigned int width;			// region of the inputs holding the image, from the origin
+	unsigned int height;
+	GLuint raysTex;				// god rays with linear depth in alpha like fbloom.txt reads them, 0 = none
+	GLuint depthTex;			// scene depth for their upsample
+	glm::vec2 raysUvScale;		// part of the rays texture holding the image
+	unsigned int raysWidth;		// same, in texels
+	unsigned int raysHeight;
+	float nearPlane;			// of the scene depth
+	float farPlane;
+} post_params_t;
+
+// Programs and targets per context, like the shadow atlas: a renderer creates its own and
+// installs it with computePostMakeCurrent(), without one the calls use a default set.
+struct compute_post_t;
+compute_post_t *computePostCreate();
+void computePostDestroy( compute_post_t *compute );		// after closeComputePost()
+void computePostMakeCurrent( compute_post_t *compute );
+
+bool initComputePost( unsigned int width, unsigned int height );	// false if GL 4.3 compute is unavailable
+bool computePostAvailable();
+void resizeComputePost( unsigned int width, unsigned int height );	// reallocates the targets
+GLuint computePostOutput();		// rgba8, linear filtered; the last run filled width x height of it
+void runComputePost( GLuint sceneTex, GLuint brightTex, const post_params_t &params );
+void blitComputePost( GLuint targetFBO, int width, int height, bool filtering );
+void closeComputePost();
+
+#endif
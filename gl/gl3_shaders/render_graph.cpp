@@ -0,0 +1,440 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "render_graph.h"
+#include "gl_state.h"
+#include "gpu_profiler.h"
+#include "gpu_memory.h"
+#include <algorithm>
+
+////////////////////////////////
+////// RENDER_GRAPH.CPP ////////
+////////////////////////////////
+
+const unsigned int RG_RELEASE_FRAMES = 60;	// pooled textures unused this long are deleted
+
+rg_texture_desc_t makeTextureDesc( GLenum format, unsigned int width, unsigned int height, GLenum filter ){
+	rg_texture_desc_t desc;
+	desc.format = format;
+	desc.width = width;
+	desc.height = height;
+	desc.filter = filter;
+	return desc;
+}
+
+// pixel transfer format/type glTexImage2D wants alongside a sized internal format
+void textureTransferFormat( GLenum internalformat, GLenum &format, GLenum &type ){
+	switch( internalformat ){
+		case GL_DEPTH24_STENCIL8:	format = GL_DEPTH_STENCIL;		type = GL_UNSIGNED_INT_24_8;	return;
+		case GL_DEPTH_COMPONENT16:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:	format = GL_DEPTH_COMPONENT;	type = GL_FLOAT;				return;
+		case GL_R8:
+		case GL_R16F:
+		case GL_R32F:				format = GL_RED;				type = GL_FLOAT;				return;
+		case GL_RG8:
+		case GL_RG16F:
+		case GL_RG32F:				format = GL_RG;					type = GL_FLOAT;				return;
+		case GL_RGBA8:
+		case GL_RGBA16F:
+		case GL_RGBA32F:
+		case GL_RGB10_A2:
+		case GL_SRGB8_ALPHA8:		format = GL_RGBA;				type = GL_FLOAT;				return;
+		case GL_R11F_G11F_B10F:		format = GL_RGB;				type = GL_FLOAT;				return;
+	}
+	format = GL_RGB;
+	type = GL_FLOAT;
+}
+
+bool sameDesc( const rg_texture_desc_t &a, const rg_texture_desc_t &b ){
+	return a.format == b.format && a.width == b.width && a.height == b.height && a.filter == b.filter;
+}
+
+RenderGraph::RenderGraph(){
+	mFrame = 0;
+	mCompiled = false;
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- Building -=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+rg_handle_t RenderGraph::createTexture( const char *name, const rg_texture_desc_t &desc ){
+	Resource res;
+	res.name = name;
+	res.desc = desc;
+	res.areaWidth = desc.width;
+	res.areaHeight = desc.height;
+	res.imported = false;
+	res.backbuffer = false;
+	res.output = false;
+	res.consumed = false;
+	res.firstPass = -1;
+	res.lastPass = -1;
+	res.physical = -1;
+	res.texture = 0;
+	res.framebuffer = 0;
+	mResources.push_back( res );
+	return (rg_handle_t)mResources.size() - 1;
+}
+
+rg_handle_t RenderGraph::importTexture( const char *name, GLuint texture, unsigned int width, unsigned int height ){
+	rg_handle_t handle = createTexture( name, makeTextureDesc( GL_NONE, width, height ) );
+	mResources[handle].imported = true;
+	mResources[handle].texture = texture;
+	return handle;
+}
+
+rg_handle_t RenderGraph::importBackbuffer( const char *name, unsigned int width, unsigned int height, GLuint framebuffer ){
+	rg_handle_t handle = importTexture( name, 0, width, height );
+	mResources[handle].backbuffer = true;
+	mResources[handle].framebuffer = framebuffer;
+	mResources[handle].output = true;
+	return handle;
+}
+
+void RenderGraph::markOutput( rg_handle_t res ){
+	mResources[res].output = true;
+}
+
+void RenderGraph::setArea( rg_handle_t res, unsigned int width, unsigned int height ){
+	mResources[res].areaWidth = std::min( width, mResources[res].desc.width );
+	mResources[res].areaHeight = std::min( height, mResources[res].desc.height );
+}
+
+int RenderGraph::addPass( const char *name, rg_execute_t execute ){
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	pass.sideEffect = false;
+	pass.culled = false;
+	mPasses.push_back( pass );
+	mCompiled = false;
+	return (int)mPasses.size() - 1;
+}
+
+void RenderGraph::read( int pass, rg_handle_t res ){
+	mPasses[pass].reads.push_back( res );
+}
+
+void RenderGraph::write( int pass, rg_handle_t res, rg_load_t load ){
+	Attachment att;
+	att.res = res;
+	att.load = load;
+	mPasses[pass].writes.push_back( att );
+}
+
+void RenderGraph::setSideEffect( int pass ){
+	mPasses[pass].sideEffect = true;
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- Compile -=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void RenderGraph::compile(){
+	unsigned int i, j;
+	int p;
+
+	// CULLING:
+	// Walk backwards from the outputs. A pass survives if something later needs one of its
+	// writes; a cleared write satisfies that need, so earlier writers of it are not needed.
+	std::vector<bool> needed( mResources.size(), false );
+	for( i = 0; i < mResources.size(); i++ )
+		needed[i] = mResources[i].output;
+
+	for( p = (int)mPasses.size() - 1; p >= 0; p-- ){
+		Pass &pass = mPasses[p];
+		bool keep = pass.sideEffect;
+		for( j = 0; j < pass.writes.size(); j++ )
+			if( needed[pass.writes[j].res] ) keep = true;
+
+		pass.culled = !keep;
+		if( pass.culled ) continue;
+
+		for( j = 0; j < pass.writes.size(); j++ )
+			if( pass.writes[j].load != RG_LOAD_KEEP ) needed[pass.writes[j].res] = false;
+		for( j = 0; j < pass.writes.size(); j++ )
+			if( pass.writes[j].load == RG_LOAD_KEEP ) needed[pass.writes[j].res] = true;
+		for( j = 0; j < pass.reads.size(); j++ )
+			needed[pass.reads[j]] = true;
+	}
+
+	// LIFETIMES:
+	// Only count consumed resources, plus depth buffers - a depth test needs its buffer even
+	// when nobody samples it later. Unconsumed color writes are simply left unattached.
+	for( i = 0; i < mResources.size(); i++ ){
+		mResources[i].consumed = mResources[i].output;
+		mResources[i].firstPass = -1;
+		mResources[i].lastPass = -1;
+		mResources[i].physical = -1;
+	}
+	for( p = 0; p < (int)mPasses.size(); p++ ){
+		if( mPasses[p].culled ) continue;
+		for( j = 0; j < mPasses[p].reads.size(); j++ )
+			mResources[mPasses[p].reads[j]].consumed = true;
+		for( j = 0; j < mPasses[p].writes.size(); j++ )
+			if( mPasses[p].writes[j].load == RG_LOAD_KEEP ) mResources[mPasses[p].writes[j].res].consumed = true;
+	}
+
+	for( p = 0; p < (int)mPasses.size(); p++ ){
+		Pass &pass = mPasses[p];
+		if( pass.culled ) continue;
+
+		std::vector<rg_handle_t> touched = pass.reads;
+		for( j = 0; j < pass.writes.size(); j++ ){
+			Resource &res = mResources[pass.writes[j].res];
+			if( res.consumed || isDepthFormat( res.desc.format ) ) touched.push_back( pass.writes[j].res );
+		}
+
+		for( j = 0; j < touched.size(); j++ ){
+			Resource &res = mResources[touched[j]];
+			if( res.firstPass < 0 ) res.firstPass = p;
+			res.lastPass = p;
+		}
+	}
+
+	// ALIASING:
+	// Hand out physical textures in order of first use. A texture is free for reuse once the
+	// last pass of the resource holding it is behind us.
+	for( i = 0; i < mPool.size(); i++ )
+		mPool[i].busyUntil = -1;
+
+	for( p = 0; p < (int)mPasses.size(); p++ ){
+		for( i = 0; i < mResources.size(); i++ ){
+			Resource &res = mResources[i];
+			if( res.imported || res.firstPass != p ) continue;
+			res.physical = acquirePhysical( res.desc, p );
+			mPool[res.physical].busyUntil = res.lastPass;
+		}
+	}
+
+	mCompiled = true;
+}
+
+bool RenderGraph::isDepthFormat( GLenum format ){
+	return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH_COMPONENT16 ||
+		   format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+}
+
+int RenderGraph::acquirePhysical( const rg_texture_desc_t &desc, int firstPass ){
+	unsigned int i;
+
+	// reuse a pooled texture of the same shape that is idle by now
+	for( i = 0; i < mPool.size(); i++ ){
+		if( sameDesc( mPool[i].desc, desc ) && mPool[i].busyUntil < firstPass ){
+			mPool[i].lastFrame = mFrame;
+			return (int)i;
+		}
+	}
+
+	// nothing suitable, allocate
+	GLenum format, type;
+	textureTransferFormat( desc.format, format, type );
+
+	PhysicalTexture phys;
+	phys.desc = desc;
+	phys.busyUntil = -1;
+	phys.lastFrame = mFrame;
+
+	glGenTextures( 1, &phys.texture );
+	stateBindTexture( 0, GL_TEXTURE_2D, phys.texture );
+	glTexImage2D( GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, format, type, NULL );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, desc.filter );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, desc.filter );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE ); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	char label[64];
+	snprintf( label, sizeof( label ), "%ux%u %s", desc.width, desc.height, textureFormatName( desc.format ) );
+	gpuMemoryTrack( GPU_MEM_TEXTURE, phys.texture, "render graph", label, textureBytes( desc.format, desc.width, desc.height ) );
+
+	mPool.push_back( phys );
+	return (int)mPool.size() - 1;
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- Execute -=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void RenderGraph::execute(){
+	if( !mCompiled ) compile();
+
+	for( unsigned int p = 0; p < mPasses.size(); p++ ){
+		if( mPasses[p].culled ) continue;
+		gpuScopeBegin( mPasses[p].name.c_str() );
+		bindPassTargets( mPasses[p] );
+		mPasses[p].execute( *this );
+		gpuScopeEnd();
+	}
+
+	printStats();
+	releaseUnused();
+	mFrame++;
+}
+
+GLuint RenderGraph::getFramebuffer( const Pass &pass ){
+	// key is every color attachment in slot order (0 = unattached), then depth
+	std::vector<GLuint> key;
+	GLuint depth = 0;
+	GLenum depthFormat = GL_NONE;
+	unsigned int i;
+
+	for( i = 0; i < pass.writes.size(); i++ ){
+		const Resource &res = mResources[pass.writes[i].res];
+		GLuint tex = res.physical >= 0 ? mPool[res.physical].texture : 0;
+		if( isDepthFormat( res.desc.format ) ){
+			depth = tex;
+			depthFormat = res.desc.format;
+		}
+		else if( !res.imported ) key.push_back( tex );
+	}
+	key.push_back( depth );
+
+	std::map< std::vector<GLuint>, GLuint >::iterator it = mFramebuffers.find( key );
+	if( it != mFramebuffers.end() ) return it->second;
+
+	GLuint fbo;
+	unsigned int colorCount = key.size() - 1;
+	std::vector<GLenum> drawBuffers( colorCount, GL_NONE );
+
+	glGenFramebuffers( 1, &fbo );
+	stateBindFramebuffer( GL_FRAMEBUFFER, fbo );
+	for( i = 0; i < colorCount; i++ ){
+		if( key[i] == 0 ) continue;
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, key[i], 0 );
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + i;
+	}
+	if( depth != 0 ){
+		GLenum attachment = depthFormat == GL_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+		glFramebufferTexture2D( GL_FRAMEBUFFER, attachment, GL_TEXTURE_2D, depth, 0 );
+	}
+
+	// Tell OpenGL the assignment of each color buffer element
+	if( colorCount > 0 )
+		glDrawBuffers( colorCount, &drawBuffers[0] );
+	else
+		glDrawBuffer( GL_NONE );
+
+	if ( glCheckFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		printf( "ERROR: Render graph framebuffer for pass '%s' is incomplete!\n", pass.name.c_str() );
+
+	mFramebuffers[key] = fbo;
+	return fbo;
+}
+
+void RenderGraph::bindPassTargets( const Pass &pass ){
+	bool backbuffer = false, transient = false;
+	GLuint backbufferFBO = 0;
+	GLbitfield clearBits = 0;
+	unsigned int width = 0, height = 0;
+
+	for( unsigned int i = 0; i < pass.writes.size(); i++ ){
+		const Resource &res = mResources[pass.writes[i].res];
+		if( res.backbuffer ){
+			backbuffer = true;
+			backbufferFBO = res.framebuffer;
+		}
+		else if( res.imported ) continue;	// imported targets are bound by the pass itself
+		else transient = true;
+
+		if( width == 0 ){
+			width = res.areaWidth;
+			height = res.areaHeight;
+		}
+
+		if( pass.writes[i].load == RG_LOAD_CLEAR )
+			clearBits |= isDepthFormat( res.desc.format ) ? ( GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT ) : GL_COLOR_BUFFER_BIT;
+	}
+
+	if( backbuffer && transient )
+		printf( "ERROR: Pass '%s' writes to the backbuffer and offscreen targets at once!\n", pass.name.c_str() );
+
+	if( !backbuffer && !transient ) return;
+
+	stateBindFramebuffer( GL_FRAMEBUFFER, backbuffer ? backbufferFBO : getFramebuffer( pass ) );
+	stateViewport( 0, 0, width, height );
+	if( clearBits ) glClear( clearBits );
+}
+
+GLuint RenderGraph::texture( rg_handle_t res ){
+	const Resource &r = mResources[res];
+	if( r.imported ) return r.texture;
+	if( r.physical < 0 ) return 0;
+	return mPool[r.physical].texture;
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- Lifetime -=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void RenderGraph::reset(){
+	mResources.clear();
+	mPasses.clear();
+	mCompiled = false;
+}
+
+void RenderGraph::releaseUnused(){
+	for( int i = (int)mPool.size() - 1; i >= 0; i-- ){
+		if( mFrame - mPool[i].lastFrame > RG_RELEASE_FRAMES )
+			deletePhysical( i );
+	}
+}
+
+void RenderGraph::deletePhysical( unsigned int index ){
+	GLuint tex = mPool[index].texture;
+
+	// any framebuffer using this texture goes with it
+	std::map< std::vector<GLuint>, GLuint >::iterator it = mFramebuffers.begin();
+	while( it != mFramebuffers.end() ){
+		bool uses = false;
+		for( unsigned int i = 0; i < it->first.size(); i++ )
+			if( it->first[i] == tex ) uses = true;
+
+		if( uses ){
+			stateForgetFramebuffer( it->second );
+			glDeleteFramebuffers( 1, &it->second );
+			mFramebuffers.erase( it++ );
+		}
+		else ++it;
+	}
+
+	stateForgetTexture( tex );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, tex );
+	glDeleteTextures( 1, &tex );
+	mPool.erase( mPool.begin() + index );
+
+	// resources of the current frame point into the pool by index
+	for( unsigned int i = 0; i < mResources.size(); i++ ){
+		if( mResources[i].physical == (int)index ) mResources[i].physical = -1;
+		else if( mResources[i].physical > (int)index ) mResources[i].physical--;
+	}
+}
+
+void RenderGraph::release(){
+	while( !mPool.empty() )
+		deletePhysical( mPool.size() - 1 );
+	reset();
+}
+
+// print a summary whenever the shape of the frame changes
+void RenderGraph::printStats(){
+	unsigned int kept = 0, transient = 0, bytes = 0, i;
+	for( i = 0; i < mPasses.size(); i++ )
+		if( !mPasses[i].culled ) kept++;
+	for( i = 0; i < mResources.size(); i++ )
+		if( !mResources[i].imported && mResources[i].physical >= 0 ) transient++;
+	for( i = 0; i < mPool.size(); i++ )
+		if( mPool[i].lastFrame == mFrame )
+			bytes += textureBytes( mPool[i].desc.format, mPool[i].desc.width, mPool[i].desc.height );
+
+	unsigned int used = 0;
+	for( i = 0; i < mPool.size(); i++ )
+		if( mPool[i].lastFrame == mFrame ) used++;
+
+	char stats[256];
+	snprintf( stats, sizeof( stats ), "RENDER GRAPH: %u of %u passes, %u targets aliased into %u textures (%.2f MB)",
+			  kept, (unsigned int)mPasses.size(), transient, used, bytes / ( 1024.0f * 1024.0f ) );
+
+	if( mLastStats != stats ){
+		printf( "%s\n", stats );
+		mLastStats = stats;
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "gl_utils.h"
+#include "gpu_memory.h"
+#include <functional>
+#include <map>
+
+///////////////////////////////////
+////// RENDER_GRAPH HEADER ////////
+///////////////////////////////////
+
+// A frame is described as a list of passes that declare the textures they read and write.
+// compile() drops passes whose outputs are never consumed, then maps the transient
+// textures onto a pool of physical textures, sharing one texture between resources
+// whose lifetimes don't overlap. Physical textures and FBOs persist between frames.
+
+typedef int rg_handle_t;
+
+typedef enum {
+	RG_LOAD_CLEAR,		// clear the attachment before the pass
+	RG_LOAD_DONTCARE,	// the pass overwrites every pixel
+	RG_LOAD_KEEP		// read-modify-write, keeps what earlier passes wrote
+} rg_load_t;
+
+typedef struct {
+	GLenum format;			// sized internal format, e.g. GL_RGB16F
+	unsigned int width;
+	unsigned int height;
+	GLenum filter;			// GL_NEAREST or GL_LINEAR
+} rg_texture_desc_t;
+
+class RenderGraph;
+typedef std::function<void( RenderGraph &graph )> rg_execute_t;
+
+rg_texture_desc_t makeTextureDesc( GLenum format, unsigned int width, unsigned int height, GLenum filter=GL_NEAREST );
+
+class RenderGraph {
+public:
+	RenderGraph();
+
+	// resources
+	rg_handle_t createTexture( const char *name, const rg_texture_desc_t &desc );	// transient, owned by the graph
+	rg_handle_t importTexture( const char *name, GLuint texture, unsigned int width, unsigned int height );
+	rg_handle_t importBackbuffer( const char *name, unsigned int width, unsigned int height, GLuint framebuffer=0 );	// the window's, or an image's FBO
+	void markOutput( rg_handle_t res );		// never cull the passes that produce this
+	void setArea( rg_handle_t res, unsigned int width, unsigned int height );	// render to a corner only, default whole texture
+
+	// passes
+	int addPass( const char *name, rg_execute_t execute );
+	void read( int pass, rg_handle_t res );
+	void write( int pass, rg_handle_t res, rg_load_t load=RG_LOAD_CLEAR );
+	void setSideEffect( int pass );			// keep the pass even if nothing reads its output
+
+	void compile();
+	void execute();
+	void reset();							// forget this frame's passes, physical textures are kept
+	void release();							// delete every physical texture and FBO
+
+	GLuint texture( rg_handle_t res );		// physical texture, valid while executing
+	void printStats();
+
+private:
+	struct Resource {
+		std::string name;
+		rg_texture_desc_t desc;
+		unsigned int areaWidth;		// viewport when rendering to it
+		unsigned int areaHeight;
+		bool imported;
+		bool backbuffer;
+		bool output;
+		bool consumed;		// read by a kept pass, or a graph output
+		int firstPass;
+		int lastPass;
+		int physical;		// index into mPool, -1 if not allocated
+		GLuint texture;		// imported texture
+		GLuint framebuffer;	// the backbuffer's
+	};
+
+	struct Attachment {
+		rg_handle_t res;
+		rg_load_t load;
+	};
+
+	struct Pass {
+		std::string name;
+		rg_execute_t execute;
+		std::vector<rg_handle_t> reads;
+		std::vector<Attachment> writes;
+		bool sideEffect;
+		bool culled;
+	};
+
+	struct PhysicalTexture {
+		rg_texture_desc_t desc;
+		GLuint texture;
+		int busyUntil;				// last pass using it this frame
+		unsigned int lastFrame;		// last frame it was assigned
+	};
+
+	bool isDepthFormat( GLenum format );
+	int acquirePhysical( const rg_texture_desc_t &desc, int firstPass );
+	GLuint getFramebuffer( const Pass &pass );
+	void bindPassTargets( const Pass &pass );
+	void releaseUnused();
+	void deletePhysical( unsigned int index );
+
+	std::vector<Resource> mResources;
+	std::vector<Pass> mPasses;
+	std::vector<PhysicalTexture> mPool;
+	std::map< std::vector<GLuint>, GLuint > mFramebuffers;
+	unsigned int mFrame;
+	bool mCompiled;
+	std::string mLastStats;
+};
+
+#endif
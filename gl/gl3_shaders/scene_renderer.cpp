@@ -0,0 +1,1177 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "scene_renderer.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "cpu_profiler.h"
+#include "jobs.h"
+#include "dynres.h"
+#include <algorithm>
+#include <string.h>
+
+//////////////////////////////////
+////// SCENE_RENDERER.CPP ////////
+//////////////////////////////////
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=- DEFINITIONS -=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+const int LORES_WIDTH		= 320;
+const int LORES_HEIGHT		= 200;
+const float GODRAYS_SCALE	= 0.25f;
+
+const float CUBE_VERTICES[CUBE_VERTEX_COUNT * SCENE_VERTEX_FLOATS] =
+{
+	// positions                        // normals         // uv coords
+	// north
+	-CUBE_SIZE, -CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  0.0f, 1.0f,
+	 CUBE_SIZE, -CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  1.0f, 1.0f,
+	-CUBE_SIZE,  CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  0.0f, 0.0f,
+	 CUBE_SIZE,  CUBE_SIZE, CUBE_SIZE,  0.0f, 0.0f, 1.0f,  1.0f, 0.0f,
+
+	// south
+	-CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  1.0f, 1.0f,
+	 CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  0.0f, 1.0f,
+	-CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  1.0f, 0.0f,
+	 CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  0.0f, 0.0f, -1.0f,  0.0f, 0.0f,
+
+	// east
+	CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
+	CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  1.0f, 0.0f, 0.0f,  0.0f, 1.0f,
+	CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  1.0f, 0.0f, 0.0f,  1.0f, 0.0f,
+	CUBE_SIZE,  CUBE_SIZE,  CUBE_SIZE,  1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
+
+	// west
+	-CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  0.0f, 1.0f,
+	-CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  1.0f, 1.0f,
+	-CUBE_SIZE,  CUBE_SIZE, -CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  0.0f, 0.0f,
+	-CUBE_SIZE,  CUBE_SIZE,  CUBE_SIZE,  -1.0f, 0.0f, 0.0f,  1.0f, 0.0f,
+
+	// top
+	-CUBE_SIZE, CUBE_SIZE,  CUBE_SIZE,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
+	 CUBE_SIZE, CUBE_SIZE,  CUBE_SIZE,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f,
+	-CUBE_SIZE, CUBE_SIZE, -CUBE_SIZE,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+	 CUBE_SIZE, CUBE_SIZE, -CUBE_SIZE,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+
+	// bottom
+	-CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  0.0f, -1.0f, 0.0f,  1.0f, 1.0f,
+	 CUBE_SIZE, -CUBE_SIZE,  CUBE_SIZE,  0.0f, -1.0f, 0.0f,  0.0f, 1.0f,
+	-CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, -1.0f, 0.0f,  1.0f, 0.0f,
+	 CUBE_SIZE, -CUBE_SIZE, -CUBE_SIZE,  0.0f, -1.0f, 0.0f,  0.0f, 0.0f
+};
+
+const unsigned int CUBE_INDICES[CUBE_INDEX_COUNT] = {
+	// north
+	0, 1, 2,
+	1, 3, 2,
+
+	// south
+	6, 5, 4,
+	7, 5, 6,
+
+	// east
+	10, 9, 8,
+	10, 11, 9,
+
+	// west
+	12, 13, 14,
+	14, 13, 15,
+
+	// top
+	16, 17, 18,
+	17, 19, 18,
+
+	// bottom
+	22, 21, 20,
+	23, 21, 22
+};
+
+// Floor
+const float FLOOR_VERTICES[FLOOR_VERTEX_COUNT * SCENE_VERTEX_FLOATS] =
+{
+	// positions         // normals         // uv coords
+	-100.f, -FLOOR_HEIGHT,  100.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+	 100.f, -FLOOR_HEIGHT,  100.0f,	 0.0f, 1.0f, 0.0f,  10.0f, 0.0f,
+	-100.f, -FLOOR_HEIGHT, -100.0f,	 0.0f, 1.0f, 0.0f,  0.0f, 10.0f,
+	 100.f, -FLOOR_HEIGHT, -100.0f,	 0.0f, 1.0f, 0.0f,  10.0f, 10.0f
+};
+
+const unsigned int FLOOR_INDICES[FLOOR_INDEX_COUNT] = {
+	0, 1, 2,
+	1, 3, 2
+};
+
+// shadowed point lights: the main one plus up to three colored ones circling the floor, '5' adds them.
+// Face resolutions come from the shadow atlas, see shadow_atlas.h.
+const float MAIN_LIGHT_FAR = 100.0f;	// shadow and light range
+const float EXTRA_LIGHT_FAR = 60.0f;
+const float EXTRA_LIGHT_ORBIT = 28.0f;
+const glm::vec3 EXTRA_LIGHT_COLORS[SHADOW_MAX_LIGHTS - 1] = {
+	glm::vec3( 2.0f, 6.0f, 10.0f ), glm::vec3( 10.0f, 3.0f, 6.0f ), glm::vec3( 4.0f, 10.0f, 3.0f )
+};
+
+// Offscreen target formats. HDR targets without alpha fit R11F_G11F_B10F at 4 bytes a pixel
+// instead of RGB16F's 6 (8 where drivers pad it), after tonemapping 8 or 10 bits per channel
+// are plenty. The full set is kept to compare against.
+typedef enum {
+	TARGET_SCENE,		// lit scene, HDR
+	TARGET_BRIGHT,		// highlights for bloom, HDR
+	TARGET_BLUR,		// blurred highlights, HDR
+	TARGET_RAYS,		// god rays, HDR color and linear depth in alpha
+	TARGET_LORES,		// tonemapped, quantized to 4 levels by fscreen.txt
+	TARGET_UPSCALE,		// tonemapped, filtered up to the window
+	TARGET_COUNT
+} render_target_t;
+
+const GLenum COMPACT_TARGET_FORMATS[TARGET_COUNT] = {
+	GL_R11F_G11F_B10F, GL_R11F_G11F_B10F, GL_R11F_G11F_B10F, GL_RGBA16F, GL_RGBA8, GL_RGB10_A2
+};
+const GLenum FULL_TARGET_FORMATS[TARGET_COUNT] = {
+	GL_RGB16F, GL_RGB16F, GL_RGB16F, GL_RGBA16F, GL_RGB16F, GL_RGB16F
+};
+
+const unsigned int FIELD_SIDE = 48;		// cube field is FIELD_SIDE x FIELD_SIDE cubes
+const float FIELD_SPACING = 4.0f;
+const float FIELD_CUBE_SCALE = 0.15f;
+const unsigned int FIELD_GLASS_EVERY = 3;	// every third field cube is transparent
+
+const float CLUSTER_FAR = 200.0f;		// depth covered by the cluster slices
+
+// per-frame GPU data: the camera block now, instances and dynamic vertices can share it
+const size_t STREAM_RING_FRAME_BYTES = 1024 * 1024;
+const GLuint CAMERA_BLOCK_BINDING = 0;
+
+// std140 layout of the Camera block in vshader.txt, fshader.txt and vdepth.txt
+typedef struct {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 viewPos;
+} camera_block_t;
+
+const unsigned int LIGHT_BENCH_STEPS = 4;
+const unsigned int LIGHT_BENCH_COUNTS[LIGHT_BENCH_STEPS] = { 1, 64, 1024, 4096 };
+const unsigned int LIGHT_BENCH_WARMUP = 30;		// frames before measuring, covers the GPU profiler latency
+const unsigned int LIGHT_BENCH_FRAMES = 120;
+
+const float BLOOM_WEIGHTS[5] = { 0.2270270270f, 0.1945945946f, 0.1216216216f, 0.0540540541f, 0.0162162162f };	// centre out
+
+// Programs with the Camera block read it from CAMERA_BLOCK_BINDING, see uploadCamera()
+static void bindCameraBlock( GLuint program )
+{
+	GLuint block = glGetUniformBlockIndex( program, "Camera" );
+	if( block != GL_INVALID_INDEX )
+		glUniformBlockBinding( program, block, CAMERA_BLOCK_BINDING );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=- Scene assets -=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+bool createSceneAssets( scene_assets_t &assets ){
+	glGenBuffers( 1, &assets.cubeVBO );
+	glGenBuffers( 1, &assets.cubeEBO );
+	glGenBuffers( 1, &assets.floorVBO );
+	glGenBuffers( 1, &assets.floorEBO );
+
+	// Vertex data
+	glBindBuffer( GL_ARRAY_BUFFER, assets.cubeVBO );
+	glBufferData( GL_ARRAY_BUFFER, sizeof( CUBE_VERTICES ), CUBE_VERTICES, GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, assets.floorVBO );
+	glBufferData( GL_ARRAY_BUFFER, sizeof( FLOOR_VERTICES ), FLOOR_VERTICES, GL_STATIC_DRAW );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+	// index/element data, no vertex array is bound yet so they go in through the copy target
+	glBindBuffer( GL_COPY_WRITE_BUFFER, assets.cubeEBO );
+	glBufferData( GL_COPY_WRITE_BUFFER, sizeof( CUBE_INDICES ), CUBE_INDICES, GL_STATIC_DRAW );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, assets.floorEBO );
+	glBufferData( GL_COPY_WRITE_BUFFER, sizeof( FLOOR_INDICES ), FLOOR_INDICES, GL_STATIC_DRAW );
+	glBindBuffer( GL_COPY_WRITE_BUFFER, 0 );
+
+	gpuMemoryTrack( GPU_MEM_BUFFER, assets.cubeVBO, "geometry", "cube vertices", sizeof( CUBE_VERTICES ) );
+	gpuMemoryTrack( GPU_MEM_BUFFER, assets.cubeEBO, "geometry", "cube indices", sizeof( CUBE_INDICES ) );
+	gpuMemoryTrack( GPU_MEM_BUFFER, assets.floorVBO, "geometry", "floor vertices", sizeof( FLOOR_VERTICES ) );
+	gpuMemoryTrack( GPU_MEM_BUFFER, assets.floorEBO, "geometry", "floor indices", sizeof( FLOOR_INDICES ) );
+
+	assets.cubeTexture =	loadTexFromFile( "trans.png", 256, 256, true, true );
+	assets.floorTexture =	loadTexFromFile( "tile2.png", 512, 512, true, true );
+	return assets.cubeTexture && assets.floorTexture;
+}
+
+void destroySceneAssets( scene_assets_t &assets ){
+	gpuMemoryUntrack( GPU_MEM_BUFFER, assets.cubeVBO );
+	gpuMemoryUntrack( GPU_MEM_BUFFER, assets.cubeEBO );
+	gpuMemoryUntrack( GPU_MEM_BUFFER, assets.floorVBO );
+	gpuMemoryUntrack( GPU_MEM_BUFFER, assets.floorEBO );
+	glDeleteBuffers( 1, &assets.cubeVBO );
+	glDeleteBuffers( 1, &assets.cubeEBO );
+	glDeleteBuffers( 1, &assets.floorVBO );
+	glDeleteBuffers( 1, &assets.floorEBO );
+
+	stateForgetTexture( assets.floorTexture );
+	stateForgetTexture( assets.cubeTexture );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, assets.floorTexture );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, assets.cubeTexture );
+	glDeleteTextures( 1, &assets.floorTexture );
+	glDeleteTextures( 1, &assets.cubeTexture );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=- SceneRenderer -=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+SceneRenderer::SceneRenderer() :
+	mAtlas( NULL ), mClusters( NULL ), mRing( NULL ), mCompute( NULL ), mProfiler( NULL ),
+	mProgram( 0 ), mScreenProgram( 0 ), mConvolveProgram( 0 ), mBloomProgram( 0 ), mShadowProgram( 0 ),
+	mRaysProgram( 0 ), mRaysMaskProgram( 0 ), mUpscaleProgram( 0 ), mDepthProgram( 0 ), mOitProgram( 0 ),
+	mOitCompositeProgram( 0 ), mCubeVAO( 0 ), mFloorVAO( 0 ), mScreenVAO( 0 ), mScreenVBO( 0 ), mScreenEBO( 0 ),
+	mCameraUBO( 0 ), mProj( 1.0f ), mOutputWidth( 0 ), mOutputHeight( 0 ), mTargetWidth( 0 ), mTargetHeight( 0 ),
+	mRenderWidth( 0 ), mRenderHeight( 0 ), mUvScale( 1.0f, 1.0f ), mRaysUvScale( 1.0f, 1.0f ),
+	mRaysWidth( 0 ), mRaysHeight( 0 )
+{
+	memset( &mAssets, 0, sizeof( mAssets ) );
+	mLightBench.step = -1;
+	mLightBench.frame = 0;
+	mLightBench.assignMs = mLightBench.gpuMs = 0.0;
+	mLightBench.gpuSamples = 0;
+	mFrame.clearColor = glm::vec4( 0.0f, 0.0f, 0.0f, 1.0f );
+}
+
+bool SceneRenderer::init( const scene_assets_t &assets, unsigned int width, unsigned int height ){
+	mAssets = assets;
+	mAtlas = shadowAtlasCreate();
+	mClusters = lightClustersCreate();
+	mRing = streamRingCreate();
+	mCompute = computePostCreate();
+	mProfiler = gpuProfilerCreate();
+	makeCurrent();
+
+	// global GL settings go here
+	stateEnable( GL_DEPTH_TEST );
+	stateEnable( GL_CULL_FACE );
+	stateEnable( GL_BLEND );
+	stateBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+
+	glClearColor( mFrame.clearColor.x, mFrame.clearColor.y, mFrame.clearColor.z, mFrame.clearColor.w );
+
+	// LOAD SHADERS
+	//////////////////
+
+	// load regular 3D scene shader
+	if( loadProgram( mProgram, "vshader.txt", "fshader.txt", "" ) == false ){
+		printf( "ERROR: Loading shader program failed!\n" );
+		return false;
+	}
+
+	// Create a separate shader program for rendering a texture to the screen, for post-processing
+	if( loadProgram( mScreenProgram, "vscreen.txt", "fscreen.txt", "" ) == false ){
+		printf( "ERROR: Loading screen shader program failed!\n" );
+		return false;
+	}
+
+	// Create a shader program for convolution kernels, the bloom's Gaussian blur among them
+	if( loadProgram( mConvolveProgram, "vblur.txt", "fconvolve.txt", "" ) == false ){
+		printf( "ERROR: Loading convolution shader program failed!\n" );
+		return false;
+	}
+
+	makeConvKernelSymmetric( BLOOM_WEIGHTS, 9, &mBloomKernel );
+	printConvKernel( "Bloom", mBloomKernel );
+	for( unsigned int i = POST_KERNEL_BLUR; i < POST_KERNEL_COUNT; i++ ){
+		makeConvKernel( POST_KERNELS[i], 3, &mPostKernels[i] );
+		printConvKernel( i == POST_KERNEL_BLUR ? "Blur" : "Sharpen", mPostKernels[i] );
+	}
+
+	// Create a shader program for processing Bloom effect
+	if( loadProgram( mBloomProgram, "vbloom.txt", "fbloom.txt", "" ) == false ){
+		printf( "ERROR: Loading bloom shader program failed!\n" );
+		return false;
+	}
+
+	// Create a shader program for shadow mapping
+	if( loadProgram( mShadowProgram, "vshadow.txt", "fshadow.txt", "" ) == false ){
+		printf( "ERROR: Loading shadow shader program failed!\n" );
+		return false;
+	}
+
+	// Catmull-Rom upscale from the render resolution to the screen
+	if( loadProgram( mUpscaleProgram, "vscreen.txt", "fupscale.txt", "" ) == false ){
+		printf( "ERROR: Loading upscale shader program failed!\n" );
+		return false;
+	}
+
+	// Create a shader program for God Rays
+	if( loadProgram( mRaysProgram, "vrays.txt", "frays.txt", "" ) == false ){
+		printf( "ERROR: Loading god-rays shader program failed!\n" );
+		return false;
+	}
+
+	if( loadProgram( mRaysMaskProgram, "vrays.txt", "fraysmask.txt", "" ) == false ){
+		printf( "ERROR: Loading god-rays mask shader program failed!\n" );
+		return false;
+	}
+
+	if( loadProgram( mDepthProgram, "vdepth.txt", "fdepth.txt", "" ) == false ){
+		printf( "ERROR: Loading depth prepass shader program failed!\n" );
+		return false;
+	}
+
+	// The scene shader again, writing weighted blended transparency instead of color
+	if( loadProgram( mOitProgram, "vshader.txt", "fshader.txt", "", "#define OIT\n" ) == false ){
+		printf( "ERROR: Loading transparency shader program failed!\n" );
+		return false;
+	}
+
+	if( loadProgram( mOitCompositeProgram, "vscreen.txt", "foit.txt", "" ) == false ){
+		printf( "ERROR: Loading transparency composite shader program failed!\n" );
+		return false;
+	}
+
+	// Set the rendering viewport according to the dimensions we wanna use
+	stateViewport( 0, 0, width, height );
+
+	// FRAME BUFFER OBJECTS FOR SHADER PROGRAMS
+	////////////////////////////////////////////
+
+	// The scene, blur and lo-res color buffers are created by the render graph the first
+	// time a frame needs them (see render()), only the shadow atlas is allocated up front.
+	if( !initShadowAtlas() )
+		return false;
+
+	// Bind the screen space, we're done creating off-screen buffers
+	stateBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	// Compute shader post-processing, optional - the fragment passes are used without it
+	initComputePost( width, height );
+	initGpuProfiler();
+	initLightClusters();
+	initStreamRing( STREAM_RING_FRAME_BYTES );
+
+	// the camera block goes here instead when the ring has no room left this frame
+	glGenBuffers( 1, &mCameraUBO );
+	glBindBuffer( GL_UNIFORM_BUFFER, mCameraUBO );
+	glBufferData( GL_UNIFORM_BUFFER, sizeof( camera_block_t ), NULL, GL_DYNAMIC_DRAW );
+	gpuMemoryTrack( GPU_MEM_BUFFER, mCameraUBO, "streaming", "camera block fallback", sizeof( camera_block_t ) );
+
+	// Create shader program parameters
+	stateUseProgram( mProgram );
+	glUniform1i( glGetUniformLocation( mProgram, "diffuseTexture" ), 0 );
+	setLightClusterSamplers( mProgram );
+
+	bindCameraBlock( mProgram );
+	bindCameraBlock( mOitProgram );
+	bindCameraBlock( mDepthProgram );
+
+	stateUseProgram( mOitProgram );
+	glUniform1i( glGetUniformLocation( mOitProgram, "diffuseTexture" ), 0 );
+	setLightClusterSamplers( mOitProgram );
+
+	stateUseProgram( mOitCompositeProgram );
+	glUniform1i( glGetUniformLocation( mOitCompositeProgram, "accum" ), 0 );
+	glUniform1i( glGetUniformLocation( mOitCompositeProgram, "weight" ), 1 );
+
+	stateUseProgram( mConvolveProgram );
+	glUniform1i( glGetUniformLocation( mConvolveProgram, "image" ), 0 );
+
+	stateUseProgram( mBloomProgram );
+	glUniform1i( glGetUniformLocation( mBloomProgram, "scene" ), 0);
+	glUniform1i( glGetUniformLocation( mBloomProgram, "bloomBlur" ), 1);
+	glUniform1i( glGetUniformLocation( mBloomProgram, "depthMap" ), 2 );
+	glUniform1i( glGetUniformLocation( mBloomProgram, "rays" ), 3 );
+	glUniform1f( glGetUniformLocation( mBloomProgram, "nearPlane" ), CAMERA_NEAR );
+	glUniform1f( glGetUniformLocation( mBloomProgram, "farPlane" ), CAMERA_FAR );
+
+	stateUseProgram( mRaysMaskProgram );
+	glUniform1i( glGetUniformLocation( mRaysMaskProgram, "depthMap" ), 0 );
+	glUniform1f( glGetUniformLocation( mRaysMaskProgram, "nearPlane" ), CAMERA_NEAR );
+	glUniform1f( glGetUniformLocation( mRaysMaskProgram, "farPlane" ), CAMERA_FAR );
+	glUniform1f( glGetUniformLocation( mRaysMaskProgram, "radius" ), 0.04f );
+	glUniform3f( glGetUniformLocation( mRaysMaskProgram, "lightColor" ), 1.0f, 0.9f, 0.5f );
+
+	stateUseProgram( mRaysProgram );
+	glUniform1i( glGetUniformLocation( mRaysProgram, "occlusion" ), 0 );
+
+	stateUseProgram( mUpscaleProgram );
+	glUniform1i( glGetUniformLocation( mUpscaleProgram, "image" ), 0 );
+
+	stateUseProgram( mShadowProgram );
+	glUniform1i( glGetUniformLocation( mShadowProgram, "alphatex"), 0 );
+
+	// GEOMETRY
+	//////////////////
+
+	// Cube and floor share the assets' buffers, only the vertex arrays are this renderer's
+	GLuint sceneVAOs[2];
+	const GLuint sceneVBOs[2] = { mAssets.cubeVBO, mAssets.floorVBO };
+	const GLuint sceneEBOs[2] = { mAssets.cubeEBO, mAssets.floorEBO };
+	glGenVertexArrays( 2, sceneVAOs );
+	for( unsigned int i = 0; i < 2; i++ ){
+		stateBindVertexArray( sceneVAOs[i] );
+		glBindBuffer( GL_ARRAY_BUFFER, sceneVBOs[i] );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, sceneEBOs[i] );
+
+		// position attribute
+		glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, SCENE_VERTEX_FLOATS * sizeof(float), (void*)0 );
+		glEnableVertexAttribArray(0);
+		// normal attribute
+		glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, SCENE_VERTEX_FLOATS * sizeof(float), (void*)(3 * sizeof(float)) );
+		glEnableVertexAttribArray(1);
+		// texture attribute
+		glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, SCENE_VERTEX_FLOATS * sizeof(float), (void*)(6 * sizeof(float)) );
+		glEnableVertexAttribArray(2);
+	}
+	mCubeVAO = sceneVAOs[0];
+	mFloorVAO = sceneVAOs[1];
+
+	// Here we will create another Vertex Array Object containing a simple quad to use
+	// when we draw a copy of an offscreen buffer to screen memory, used for post-processing effects.
+	glGenVertexArrays( 1, &mScreenVAO );
+	stateBindVertexArray( mScreenVAO );
+
+	float screen_verts[] = {
+		-1.f, -1.f, 0.0f,  0.0f, 0.0f,
+		 1.f, -1.f, 0.0f,  1.0f, 0.0f,
+		-1.f,  1.f, 0.0f,  0.0f, 1.0f,
+		 1.f,  1.f, 0.0f,  1.0f, 1.0f
+	};
+
+	unsigned int screen_inds[] = {
+		0, 1, 2,
+		2, 1, 3
+	};
+
+	glGenBuffers( 1, &mScreenVBO );
+	glGenBuffers( 1, &mScreenEBO );
+
+	glBindBuffer( GL_ARRAY_BUFFER, mScreenVBO );
+	glBufferData( GL_ARRAY_BUFFER, sizeof( screen_verts ), screen_verts, GL_STATIC_DRAW );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mScreenEBO );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( screen_inds ), screen_inds, GL_STATIC_DRAW );
+	gpuMemoryTrack( GPU_MEM_BUFFER, mScreenVBO, "post", "screen quad vertices", sizeof( screen_verts ) );
+	gpuMemoryTrack( GPU_MEM_BUFFER, mScreenEBO, "post", "screen quad indices", sizeof( screen_inds ) );
+
+	// Set the vertex attributes for the "screen" vertex array
+	// position attribute
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0 );
+	glEnableVertexAttribArray(0);
+	// texture attribute
+	glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)) );
+	glEnableVertexAttribArray(1);
+
+	// SIZES
+	///////////////
+	mTargetWidth = mRenderWidth = width;
+	mTargetHeight = mRenderHeight = height;
+	resize( width, height );
+	return true;
+}
+
+void SceneRenderer::close(){
+	if( !mAtlas ) return;
+	makeCurrent();
+
+	closeGpuProfiler();
+	closeLightClusters();
+	closeComputePost();
+
+	gpuMemoryUntrack( GPU_MEM_BUFFER, mScreenVBO );
+	gpuMemoryUntrack( GPU_MEM_BUFFER, mScreenEBO );
+	glDeleteBuffers( 1, &mScreenVBO );
+	glDeleteBuffers( 1, &mScreenEBO );
+	gpuMemoryUntrack( GPU_MEM_BUFFER, mCameraUBO );
+	glDeleteBuffers( 1, &mCameraUBO );
+
+	stateForgetVertexArray( mFloorVAO );
+	stateForgetVertexArray( mCubeVAO );
+	stateForgetVertexArray( mScreenVAO );
+	glDeleteVertexArrays( 1, &mFloorVAO );
+	glDeleteVertexArrays( 1, &mCubeVAO );
+	glDeleteVertexArrays( 1, &mScreenVAO );
+
+	mGraph.release();
+	closeShadowAtlas();
+	closeStreamRing();
+
+	stateUseProgram( 0 );
+	glDeleteProgram( mRaysProgram );
+	glDeleteProgram( mRaysMaskProgram );
+	glDeleteProgram( mUpscaleProgram );
+	glDeleteProgram( mDepthProgram );
+	glDeleteProgram( mOitProgram );
+	glDeleteProgram( mOitCompositeProgram );
+	glDeleteProgram( mScreenProgram );
+	glDeleteProgram( mProgram );
+	glDeleteProgram( mConvolveProgram );
+	glDeleteProgram( mBloomProgram );
+	glDeleteProgram( mShadowProgram );
+
+	gpuProfilerDestroy( mProfiler );
+	computePostDestroy( mCompute );
+	streamRingDestroy( mRing );
+	lightClustersDestroy( mClusters );
+	shadowAtlasDestroy( mAtlas );
+	mAtlas = NULL;
+	mClusters = NULL;
+	mRing = NULL;
+	mCompute = NULL;
+	mProfiler = NULL;
+}
+
+void SceneRenderer::makeCurrent(){
+	shadowAtlasMakeCurrent( mAtlas );
+	lightClustersMakeCurrent( mClusters );
+	streamRingMakeCurrent( mRing );
+	computePostMakeCurrent( mCompute );
+	gpuProfilerMakeCurrent( mProfiler );
+}
+
+void SceneRenderer::resize( unsigned int width, unsigned int height ){
+	mOutputWidth = width;
+	mOutputHeight = height;
+	mProj = glm::perspective( glm::radians( 45.0f ), (float)width / (float)height, CAMERA_NEAR, CAMERA_FAR );
+}
+
+void SceneRenderer::resizeTargets( unsigned int width, unsigned int height ){
+	printf( "ATTEMPT: Resizing render targets to %u x %u...\n", width, height );
+	mTargetWidth = width;
+	mTargetHeight = height;
+	resizeComputePost( width, height );
+}
+
+void SceneRenderer::startLightBenchmark(){
+	if( mLightBench.step >= 0 ) return;
+	printf( "ATTEMPT: Light benchmark, %u frames per light count, dynamic resolution held off...\n", LIGHT_BENCH_FRAMES );
+	mLightBench.step = 0;
+	mLightBench.frame = 0;
+	mLightBench.assignMs = mLightBench.gpuMs = 0.0;
+	mLightBench.gpuSamples = 0;
+}
+
+// Point lights for this frame, the benchmark overrides the chosen count while it runs
+unsigned int SceneRenderer::frameLightCount() const {
+	return mLightBench.step < 0 ? mFrame.clusterLights : LIGHT_BENCH_COUNTS[mLightBench.step];
+}
+
+// Accumulate this frame's timings, print and move on once a count has had its frames
+void SceneRenderer::stepLightBenchmark(){
+	LightBench &bench = mLightBench;
+	if( bench.step < 0 ) return;
+
+	if( bench.frame >= LIGHT_BENCH_WARMUP ){
+		float ms;
+		bench.assignMs += lightClusterStats().assignMs;
+		if( gpuProfilerLatest( "scene", ms ) ){
+			bench.gpuMs += ms;
+			bench.gpuSamples++;
+		}
+	}
+	if( ++bench.frame < LIGHT_BENCH_WARMUP + LIGHT_BENCH_FRAMES ) return;
+
+	light_cluster_stats_t stats = lightClusterStats();
+	printf( "LIGHT BENCHMARK: %4u lights at %ux%u - assign %.3f ms CPU, scene ", stats.lights, mRenderWidth, mRenderHeight, bench.assignMs / LIGHT_BENCH_FRAMES );
+	if( bench.gpuSamples ) printf( "%.3f ms GPU", bench.gpuMs / bench.gpuSamples );
+	else printf( "n/a GPU" );
+	printf( ", %u visible, %.1f average / %u max per cluster%s\n", stats.visible, stats.averagePerCluster, stats.maxPerCluster,
+			stats.overflow ? ", INDEX LIST FULL" : "" );
+
+	bench.frame = 0;
+	bench.assignMs = bench.gpuMs = 0.0;
+	bench.gpuSamples = 0;
+	if( ++bench.step == (int)LIGHT_BENCH_STEPS ){
+		bench.step = -1;
+		printf( "SUCCESS: Light benchmark done...\n" );
+	}
+}
+
+// Transparent draws go to the OIT program in no particular order, or to the scene program
+// sorted back to front when OIT is off
+draw_command_t SceneRenderer::makeTransparentCommand( GLuint vao, GLuint texture, GLsizei indexCount, const glm::mat4 &model, float depth ){
+	if( mFrame.oit )
+		return makeDrawCommand( DRAW_PASS_SCENE, mOitProgram, vao, texture, indexCount, model, true, 0.0f );
+	return makeDrawCommand( DRAW_PASS_SCENE, mProgram, vao, texture, indexCount, model, true, depth );
+}
+
+// Spinning cubes over the floor, culled and recorded in parallel. Each worker fills its own
+// queue, then they are appended in worker order; the key sort does the rest on this thread.
+void SceneRenderer::queueCubeField( float far_plane ){
+	const glm::mat4 &view = mFrame.view;
+	frustum_t frustum = makeFrustum( mProj * view );
+	float radius = CUBE_SIZE * FIELD_CUBE_SCALE * 1.7320508f;	// bounding sphere of the scaled cube
+	float start = -( FIELD_SIDE - 1 ) * FIELD_SPACING * 0.5f;
+
+	mWorkerQueues.resize( jobWorkerCount() );
+	for( unsigned int i = 0; i < mWorkerQueues.size(); i++ )
+		mWorkerQueues[i].clear();
+
+	parallelFor( FIELD_SIDE * FIELD_SIDE, 64, [&]( unsigned int begin, unsigned int end, unsigned int worker ){
+		DrawQueue &queue = mWorkerQueues[worker];
+
+		for( unsigned int i = begin; i < end; i++ ){
+			glm::vec3 center( start + ( i % FIELD_SIDE ) * FIELD_SPACING,
+							  -FLOOR_HEIGHT + radius,
+							  start + ( i / FIELD_SIDE ) * FIELD_SPACING );
+			bool castsShadow = false;
+			for( unsigned int l = 0; l < mShadowLights.size() && !castsShadow; l++ )
+				castsShadow = glm::length( center - mShadowLights[l].position ) - radius < mShadowLights[l].farPlane;
+			bool visible = sphereInFrustum( frustum, center, radius );
+			if( !castsShadow && !visible ) continue;
+
+			glm::mat4 m = glm::translate( glm::mat4( 1.0f ), center );
+			m = glm::rotate( m, mFrame.fieldAngle + i * 0.37f, glm::vec3( 0.0f, 1.0f, 0.0f ) );
+			m = glm::scale( m, glm::vec3( FIELD_CUBE_SCALE, FIELD_CUBE_SCALE, FIELD_CUBE_SCALE ) );
+
+			// every few cubes are see-through, drawn from both sides
+			bool glass = i % FIELD_GLASS_EVERY == 0;
+			GLuint texture = glass ? mAssets.cubeTexture : mAssets.floorTexture;
+			float depth = -( view * glm::vec4( center, 1.0f ) ).z / far_plane;
+
+			if( castsShadow )
+				queue.submit( makeDrawCommand( DRAW_PASS_SHADOW, mShadowProgram, mCubeVAO, texture, CUBE_INDEX_COUNT, m, false,
+											   glm::length( center - mFrame.lightPos ) / far_plane ) );
+			if( visible && glass ){
+				draw_command_t cmd = makeTransparentCommand( mCubeVAO, texture, CUBE_INDEX_COUNT, m, depth );
+				cmd.cullFace = false;
+				queue.submit( cmd );
+			}
+			else if( visible )
+				queue.submit( makeDrawCommand( DRAW_PASS_SCENE, mProgram, mCubeVAO, texture, CUBE_INDEX_COUNT, m, false, depth ) );
+		}
+	} );
+
+	for( unsigned int i = 0; i < mWorkerQueues.size(); i++ )
+		mDrawQueue.append( mWorkerQueues[i] );
+}
+
+// Record every object draw of the frame, the queue sorts them by pass, state and depth
+void SceneRenderer::queueScene( float far_plane ){
+	CPU_ZONE( "queueScene" );
+	glm::mat4 lightScale = glm::scale( glm::mat4( 1.0f ), glm::vec3( 0.1f, 0.1f, 0.1f ) );
+	glm::mat4 light_matrix;
+	draw_command_t cmd;
+
+	mDrawQueue.clear();
+
+	// distance of an object's origin from the eye (or light), normalized to the far plane
+	auto viewDepth = [&]( const glm::mat4 &m ){ return -( mFrame.view * m[3] ).z / far_plane; };
+	auto lightDepth = [&]( const glm::mat4 &m ){ return glm::length( glm::vec3( m[3] ) - mFrame.lightPos ) / far_plane; };
+
+	// SHADOW CASTERS
+	mDrawQueue.submit( makeDrawCommand( DRAW_PASS_SHADOW, mShadowProgram, mFloorVAO, mAssets.floorTexture, FLOOR_INDEX_COUNT, mFrame.matFloor, false, lightDepth( mFrame.matFloor ) ) );
+
+	// Note: Culling disabled to show backside(s) if there is transparent texture
+	cmd = makeDrawCommand( DRAW_PASS_SHADOW, mShadowProgram, mCubeVAO, mAssets.cubeTexture, CUBE_INDEX_COUNT, mFrame.model, false, lightDepth( mFrame.model ) );
+	cmd.cullFace = false;
+	mDrawQueue.submit( cmd );
+
+	// SCENE
+	if( mFrame.drawFloor )
+		mDrawQueue.submit( makeDrawCommand( DRAW_PASS_SCENE, mProgram, mFloorVAO, mAssets.floorTexture, FLOOR_INDEX_COUNT, mFrame.matFloor, false, viewDepth( mFrame.matFloor ) ) );
+
+	// fullbright mini cubes at the lights' positions
+	for( unsigned int i = 0; i < mShadowLights.size(); i++ ){
+		light_matrix = glm::translate( glm::mat4( 1.0f ), mShadowLights[i].position ) * lightScale;
+		cmd = makeDrawCommand( DRAW_PASS_SCENE, mProgram, mCubeVAO, mAssets.cubeTexture, CUBE_INDEX_COUNT, light_matrix, false, viewDepth( light_matrix ) );
+		cmd.fullbright = true;
+		cmd.cullFace = false;
+		mDrawQueue.submit( cmd );
+	}
+
+	// the textured cube has transparent texels, so it's drawn after the opaque draws
+	if( mFrame.drawCube ){
+		cmd = makeTransparentCommand( mCubeVAO, mAssets.cubeTexture, CUBE_INDEX_COUNT, mFrame.model, viewDepth( mFrame.model ) );
+		cmd.cullFace = false;
+		mDrawQueue.submit( cmd );
+	}
+
+	if( mFrame.cubeField ) queueCubeField( far_plane );
+
+	mDrawQueue.sort();
+}
+
+void SceneRenderer::renderQuad(){
+	stateBindVertexArray( mScreenVAO );
+	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0 );
+}
+
+void SceneRenderer::setViewport(){
+	stateViewport( 0, 0, mRenderWidth, mRenderHeight );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+// -=-=-=-=- processShadows -=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
+void SceneRenderer::processShadows() {
+	CPU_ZONE( "processShadows" );
+
+	// every face of every light that got tiles, the casters were recorded for all of them
+	renderShadowAtlas( mShadowProgram, [this](){ mDrawQueue.execute( DRAW_PASS_SHADOW ); } );
+
+	// reset viewport
+	setViewport();
+}
+
+// The main light and the extra ones orbiting the floor, at most SHADOW_MAX_LIGHTS
+void SceneRenderer::gatherShadowLights(){
+	shadow_light_t light;
+
+	mShadowLights.clear();
+	light.position = mFrame.lightPos;
+	light.color = glm::vec3( 10.0f, 9.0f, 5.0f );
+	light.farPlane = MAIN_LIGHT_FAR;
+	mShadowLights.push_back( light );
+
+	for( unsigned int i = 1; i < std::min( mFrame.shadowLights, SHADOW_MAX_LIGHTS ); i++ ){
+		float angle = -mFrame.fieldAngle + i * 2.0943951f;	// a third of a turn apart
+		light.position = glm::vec3( cos( angle ) * EXTRA_LIGHT_ORBIT, -FLOOR_HEIGHT + 6.0f, sin( angle ) * EXTRA_LIGHT_ORBIT );
+		light.color = EXTRA_LIGHT_COLORS[i - 1];
+		light.farPlane = EXTRA_LIGHT_FAR;
+		mShadowLights.push_back( light );
+	}
+}
+
+// Depth of the opaque draws with a program that does nothing else. Fragments in the scene
+// pass then either match this depth exactly or get rejected before fshader runs, so the
+// lighting and shadow taps are paid once per pixel instead of once per layer of overdraw.
+void SceneRenderer::renderDepthPrepass()
+{
+	stateUseProgram( mDepthProgram );
+	mDrawQueue.execute( DRAW_PASS_SCENE, DRAW_OPAQUE, mDepthProgram );
+}
+
+// This frame's view and projection, written straight into the stream ring once instead of
+// sent to every program that needs them. When the ring is full they go to mCameraUBO the
+// plain way, so the programs never read last frame's camera.
+void SceneRenderer::uploadCamera()
+{
+	camera_block_t block;
+	block.view = mFrame.view;
+	block.projection = mProj;
+	block.viewPos = glm::vec4( mFrame.viewPos, 1.0f );
+
+	stream_alloc_t alloc = streamAllocUniform( sizeof( camera_block_t ) );
+	if( !alloc.data ){
+		glBindBuffer( GL_UNIFORM_BUFFER, mCameraUBO );
+		glBufferSubData( GL_UNIFORM_BUFFER, 0, sizeof( camera_block_t ), &block );
+		glBindBufferBase( GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, mCameraUBO );
+		return;
+	}
+
+	memcpy( alloc.data, &block, sizeof( camera_block_t ) );
+	glBindBufferRange( GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, alloc.buffer, alloc.offset, alloc.size );
+}
+
+// View, lights and shadows for either variant of fshader.txt
+void SceneRenderer::setSceneUniforms( GLuint program, GLuint shadowMap )
+{
+	// scene transform matrices are in the camera block, per-object ones are sent by the draw queue
+	stateUseProgram( program );
+
+	// Calculate light's 2D position in screen space
+	glm::mat4 transform = mProj * mFrame.view;
+	glm::vec4 lightPosition2D( mFrame.lightPos.x, mFrame.lightPos.y, mFrame.lightPos.z, 1.0f );
+	lightPosition2D = transform * lightPosition2D;
+
+	lightPosition2D.x /= lightPosition2D.w;
+	lightPosition2D.y /= lightPosition2D.w;
+	lightPosition2D.x += 1.0f;
+	lightPosition2D.y += 1.0f;
+	lightPosition2D.x *= mRenderWidth / 2;
+	lightPosition2D.y *= mRenderHeight / 2;
+
+	// Prepare scene lighting
+	glUniform2f( glGetUniformLocation( program, "lightPos2D" ), lightPosition2D.x, lightPosition2D.y );
+
+	// Texture0 - Regular color object texture (set in rendering functions)
+	// Texture1 - shadow atlas, with the lights and their tiles
+	stateBindTexture( 1, GL_TEXTURE_2D, shadowMap );
+	setShadowAtlasUniforms( program, 1 );
+
+	// Texture4-6 - clustered point lights
+	bindLightClusters( program, mRenderWidth, mRenderHeight );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=- renderScene -=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void SceneRenderer::renderScene( GLuint shadowMap, bool depthPrepass, bool oit )
+{
+	// Render color information (including shadows) and pass only highlights
+	// into secondary buffer, to be processed later
+	setSceneUniforms( mProgram, shadowMap );
+
+	// Floor, light cube, then the transparent cube last - unless they go through the OIT passes
+	if( depthPrepass ){
+		// opaque depth is already final, draw only what matches it
+		stateDepthFunc( GL_EQUAL );
+		stateDepthMask( GL_FALSE );
+		mDrawQueue.execute( DRAW_PASS_SCENE, DRAW_OPAQUE );
+		stateDepthFunc( GL_LESS );
+		stateDepthMask( GL_TRUE );
+		if( !oit ) mDrawQueue.execute( DRAW_PASS_SCENE, DRAW_TRANSPARENT );
+	}
+	else mDrawQueue.execute( DRAW_PASS_SCENE, oit ? DRAW_OPAQUE : DRAW_ALL );
+}
+
+// Weighted blended order-independent transparency (McGuire & Bavoil). Every transparent
+// draw adds its weighted color to one target and multiplies the revealage, so the order
+// they arrive in doesn't matter and the queue doesn't have to sort them by depth.
+// One blend function does both: the weight sum lives in a second target's red channel,
+// the revealage in the first target's alpha, so GL 3.3 without per-target blending works.
+void SceneRenderer::renderTransparentOIT( GLuint shadowMap )
+{
+	const GLfloat clearAccum[4] = { 0.0f, 0.0f, 0.0f, 1.0f };	// nothing added, fully revealed
+	const GLfloat clearWeight[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+	setSceneUniforms( mOitProgram, shadowMap );
+	glClearBufferfv( GL_COLOR, 0, clearAccum );
+	glClearBufferfv( GL_COLOR, 1, clearWeight );
+
+	// tested against the opaque depth, never written
+	stateDepthMask( GL_FALSE );
+	stateBlendFuncSeparate( GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA );
+	mDrawQueue.execute( DRAW_PASS_SCENE, DRAW_TRANSPARENT );
+	stateBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+	stateDepthMask( GL_TRUE );
+}
+
+// The resolved transparent layers over the scene and its highlights, before bloom
+void SceneRenderer::renderCompositeOIT( GLuint accumTex, GLuint weightTex )
+{
+	stateUseProgram( mOitCompositeProgram );
+	stateBindTexture( 0, GL_TEXTURE_2D, accumTex );
+	stateBindTexture( 1, GL_TEXTURE_2D, weightTex );
+	renderQuad();
+}
+
+// One pass of a kernel, separable kernels take a horizontal and a vertical one
+void SceneRenderer::renderConvolution( GLuint source, const conv_kernel_t &kernel, conv_pass_t convPass )
+{
+	stateUseProgram( mConvolveProgram );
+	setConvUniforms( mConvolveProgram, kernel, convPass );
+	glUniform2f( glGetUniformLocation( mConvolveProgram, "uvScale" ), mUvScale.x, mUvScale.y );
+	stateBindTexture( 0, GL_TEXTURE_2D, source );
+	renderQuad();
+}
+
+// God rays occlusion mask: the light's disc, where the scene is behind the light
+void SceneRenderer::renderRaysMask( GLuint depthTex )
+{
+	stateUseProgram( mRaysMaskProgram );
+	glUniform2f( glGetUniformLocation( mRaysMaskProgram, "uvScale" ), mRaysUvScale.x, mRaysUvScale.y );
+	glUniform2f( glGetUniformLocation( mRaysMaskProgram, "sceneUvScale" ), mUvScale.x, mUvScale.y );
+	glUniform2f( glGetUniformLocation( mRaysMaskProgram, "lightScreen" ), mRaysLight.x, mRaysLight.y );
+	glUniform1f( glGetUniformLocation( mRaysMaskProgram, "lightDepth" ), mRaysLight.z );
+	glUniform1f( glGetUniformLocation( mRaysMaskProgram, "aspect" ), (float)mRenderWidth / mRenderHeight );
+	stateBindTexture( 0, GL_TEXTURE_2D, depthTex );
+	renderQuad();
+}
+
+// Smear the mask out from the light
+void SceneRenderer::renderRays( GLuint maskTex )
+{
+	stateUseProgram( mRaysProgram );
+	glUniform2f( glGetUniformLocation( mRaysProgram, "uvScale" ), mRaysUvScale.x, mRaysUvScale.y );
+	glUniform2f( glGetUniformLocation( mRaysProgram, "lightScreen" ), mRaysLight.x, mRaysLight.y );
+	stateBindTexture( 0, GL_TEXTURE_2D, maskTex );
+	renderQuad();
+}
+
+// Additive blending of main color buffer and blurred "bloom" buffer
+void SceneRenderer::renderBloom( GLuint sceneTex, GLuint bloomTex, GLuint depthTex, GLuint raysTex )
+{
+	stateUseProgram( mBloomProgram );
+
+	// Pass along rendering parameters we can control programatically, using keyboard input
+	glUniform1i( glGetUniformLocation( mBloomProgram, "bloom" ), mFrame.bloom );
+	glUniform1f( glGetUniformLocation( mBloomProgram, "exposure" ), mFrame.exposure );
+	glUniform2f( glGetUniformLocation( mBloomProgram, "uvScale" ), mUvScale.x, mUvScale.y );
+
+	// Texture0 = regular scene color information
+	stateBindTexture( 0, GL_TEXTURE_2D, sceneTex );
+
+	// Texture1 - Highlights-only that have been blurred, will be drawn using additive blending within shader
+	stateBindTexture( 1, GL_TEXTURE_2D, bloomTex );
+
+	// Texture2/3 - depth and the low resolution god rays, upsampled within shader
+	glUniform1i( glGetUniformLocation( mBloomProgram, "godrays" ), raysTex != 0 );
+	if( raysTex ){
+		glUniform2f( glGetUniformLocation( mBloomProgram, "raysUvScale" ), mRaysUvScale.x, mRaysUvScale.y );
+		glUniform2i( glGetUniformLocation( mBloomProgram, "raysArea" ), mRaysWidth, mRaysHeight );
+		stateBindTexture( 2, GL_TEXTURE_2D, depthTex );
+		stateBindTexture( 3, GL_TEXTURE_2D, raysTex );
+	}
+
+	renderQuad();
+}
+
+// Scale the reduced resolution image up to the screen. Lo-Res mode keeps the pixels (more pixels!!!),
+// otherwise a Catmull-Rom filter keeps it sharp
+void SceneRenderer::renderUpscale( GLuint source, bool pixelated )
+{
+	GLuint program = pixelated ? mScreenProgram : mUpscaleProgram;
+	stateUseProgram( program );
+	glUniform2f( glGetUniformLocation( program, "uvScale" ), mUvScale.x, mUvScale.y );
+	stateBindTexture( 0, GL_TEXTURE_2D, source );
+	renderQuad();
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=- render -=-=-=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+void SceneRenderer::render( const scene_frame_t &frame, GLuint framebuffer )
+{
+	CPU_ZONE( "render" );
+	if( frame.clearColor != mFrame.clearColor )
+		glClearColor( frame.clearColor.x, frame.clearColor.y, frame.clearColor.z, frame.clearColor.w );
+	mFrame = frame;
+	gpuProfilerBeginFrame();
+
+	float far_plane = 100.0f;
+	unsigned int fbWidth = mTargetWidth;
+	unsigned int fbHeight = mTargetHeight;
+	bool lores = mFrame.lores;
+	const GLenum *formats = mFrame.compactTargets ? COMPACT_TARGET_FORMATS : FULL_TARGET_FORMATS;
+	int pass;
+
+	// Render resolution for this frame: fixed in lo-res mode, else whatever the GPU keeps up with.
+	// Targets don't change size with it, we only draw to the bottom left part of them.
+	// While a window resize settles the output can be bigger than the targets.
+	unsigned int baseWidth = std::min( mOutputWidth, fbWidth );
+	unsigned int baseHeight = std::min( mOutputHeight, fbHeight );
+	if( lores ){
+		mRenderWidth = std::min( (unsigned int)LORES_WIDTH, fbWidth );
+		mRenderHeight = std::min( (unsigned int)LORES_HEIGHT, fbHeight );
+	}
+	else if( mFrame.renderScale < 1.0f && mLightBench.step < 0 )
+		scaledRenderSize( baseWidth, baseHeight, mFrame.renderScale, mRenderWidth, mRenderHeight );
+	else {
+		mRenderWidth = baseWidth;
+		mRenderHeight = baseHeight;
+	}
+	bool upscale = mRenderWidth != mOutputWidth || mRenderHeight != mOutputHeight;
+	mUvScale = glm::vec2( (float)mRenderWidth / fbWidth, (float)mRenderHeight / fbHeight );
+
+	// Describe this frame as passes reading and writing textures. The graph skips passes
+	// nobody consumes (the blur chain with BLOOM off) and lets short-lived targets share memory.
+	// Shadowed lights first, the casters recorded by queueScene depend on their ranges.
+	// The atlas hands out face resolutions by how much of the screen each light can reach.
+	gatherShadowLights();
+	planShadowAtlas( mShadowLights, mFrame.view, mProj );
+	queueScene( far_plane );
+	mGraph.reset();
+
+	// Per-frame GPU data, this frame's part of the ring is free again once its fence from
+	// STREAM_RING_FRAMES frames ago has passed
+	streamBeginFrame();
+	uploadCamera();
+	streamFlush();
+
+	// Assign the point lights to clusters on the job threads and upload the lists
+	unsigned int lights = frameLightCount();
+	if( lights != clusterLightCount() )
+		setClusterLights( lights, glm::vec3( -90.0f, -FLOOR_HEIGHT + 0.5f, -90.0f ), glm::vec3( 90.0f, -FLOOR_HEIGHT + 5.0f, 90.0f ) );
+	if( lights )
+		updateLightClusters( mFrame.fieldAngle, mFrame.view, mProj, CAMERA_NEAR, CLUSTER_FAR );
+
+	unsigned int outputWidth = mOutputWidth;
+	unsigned int outputHeight = mOutputHeight;
+	rg_handle_t backbuffer	= mGraph.importBackbuffer( "backbuffer", outputWidth, outputHeight, framebuffer );
+	rg_handle_t shadowMap	= mGraph.importTexture( "shadowMap", shadowAtlasTexture(), SHADOW_ATLAS_WIDTH, SHADOW_ATLAS_HEIGHT );
+	rg_handle_t sceneColor	= mGraph.createTexture( "sceneColor", makeTextureDesc( formats[TARGET_SCENE], fbWidth, fbHeight ) );
+	rg_handle_t brightColor	= mGraph.createTexture( "brightColor", makeTextureDesc( formats[TARGET_BRIGHT], fbWidth, fbHeight ) );
+	rg_handle_t sceneDepth	= mGraph.createTexture( "sceneDepth", makeTextureDesc( GL_DEPTH24_STENCIL8, fbWidth, fbHeight ) );
+	mGraph.setArea( sceneColor, mRenderWidth, mRenderHeight );
+	mGraph.setArea( brightColor, mRenderWidth, mRenderHeight );
+	mGraph.setArea( sceneDepth, mRenderWidth, mRenderHeight );
+
+	// SHADOWS:
+	// Render depth information for each light's cube faces into the atlas
+	pass = mGraph.addPass( "shadows", [this]( RenderGraph & ){ processShadows(); } );
+	mGraph.write( pass, shadowMap );
+
+	// DEPTH PREPASS:
+	// Worth it when fshader's cost times the overdraw beats drawing the geometry twice,
+	// compare "depthPrepass" + "scene" against "scene" alone in the GPU profile ('d' toggles)
+	bool prepass = mFrame.depthPrepass;
+	if( prepass ){
+		pass = mGraph.addPass( "depthPrepass", [this]( RenderGraph & ){ renderDepthPrepass(); } );
+		mGraph.write( pass, sceneDepth );
+	}
+
+	// COLOR:
+	// Scene into buffer 0, highlights only into buffer 1
+	bool oit = mFrame.oit;
+	pass = mGraph.addPass( "scene", [=]( RenderGraph &graph ){ renderScene( graph.texture( shadowMap ), prepass, oit ); } );
+	mGraph.read( pass, shadowMap );
+	mGraph.write( pass, sceneColor );
+	mGraph.write( pass, brightColor );
+	mGraph.write( pass, sceneDepth, prepass ? RG_LOAD_KEEP : RG_LOAD_CLEAR );
+
+	// TRANSPARENCY:
+	// Accumulate every transparent draw in one unsorted pass, then resolve over the scene
+	if( oit ){
+		rg_handle_t oitAccum = mGraph.createTexture( "oitAccum", makeTextureDesc( GL_RGBA16F, fbWidth, fbHeight ) );
+		rg_handle_t oitWeight = mGraph.createTexture( "oitWeight", makeTextureDesc( GL_R16F, fbWidth, fbHeight ) );
+		mGraph.setArea( oitAccum, mRenderWidth, mRenderHeight );
+		mGraph.setArea( oitWeight, mRenderWidth, mRenderHeight );
+
+		pass = mGraph.addPass( "oitAccum", [=]( RenderGraph &graph ){ renderTransparentOIT( graph.texture( shadowMap ) ); } );
+		mGraph.read( pass, shadowMap );
+		mGraph.write( pass, oitAccum, RG_LOAD_DONTCARE );		// cleared to their own values
+		mGraph.write( pass, oitWeight, RG_LOAD_DONTCARE );
+		mGraph.write( pass, sceneDepth, RG_LOAD_KEEP );
+
+		pass = mGraph.addPass( "oitComposite", [=]( RenderGraph &graph ){ renderCompositeOIT( graph.texture( oitAccum ), graph.texture( oitWeight ) ); } );
+		mGraph.read( pass, oitAccum );
+		mGraph.read( pass, oitWeight );
+		mGraph.write( pass, sceneColor, RG_LOAD_KEEP );
+		mGraph.write( pass, brightColor, RG_LOAD_KEEP );
+	}
+
+	// GOD RAYS:
+	// Occlusion mask and radial blur at GODRAYS_SCALE, skipped when the light is behind us.
+	// Both post paths composite them, with the bloom.
+	glm::vec4 lightClip = mProj * mFrame.view * glm::vec4( mFrame.lightPos, 1.0f );
+	bool godrays = mFrame.godrays && lightClip.w > 0.0f;
+	rg_handle_t rays = -1;
+
+	if( godrays ){
+		mRaysLight = glm::vec3( lightClip.x, lightClip.y, lightClip.z ) / lightClip.w * 0.5f + glm::vec3( 0.5f, 0.5f, 0.5f );
+
+		unsigned int raysTargetWidth = (unsigned int)ceil( fbWidth * GODRAYS_SCALE );
+		unsigned int raysTargetHeight = (unsigned int)ceil( fbHeight * GODRAYS_SCALE );
+		mRaysWidth = (unsigned int)ceil( mRenderWidth * GODRAYS_SCALE );
+		mRaysHeight = (unsigned int)ceil( mRenderHeight * GODRAYS_SCALE );
+		mRaysUvScale = glm::vec2( (float)mRaysWidth / raysTargetWidth, (float)mRaysHeight / raysTargetHeight );
+
+		rg_handle_t raysMask = mGraph.createTexture( "raysMask", makeTextureDesc( formats[TARGET_RAYS], raysTargetWidth, raysTargetHeight, GL_LINEAR ) );
+		rays = mGraph.createTexture( "rays", makeTextureDesc( formats[TARGET_RAYS], raysTargetWidth, raysTargetHeight ) );
+		mGraph.setArea( raysMask, mRaysWidth, mRaysHeight );
+		mGraph.setArea( rays, mRaysWidth, mRaysHeight );
+
+		pass = mGraph.addPass( "raysMask", [=]( RenderGraph &graph ){ renderRaysMask( graph.texture( sceneDepth ) ); } );
+		mGraph.read( pass, sceneDepth );
+		mGraph.write( pass, raysMask, RG_LOAD_DONTCARE );
+
+		pass = mGraph.addPass( "rays", [=]( RenderGraph &graph ){ renderRays( graph.texture( raysMask ) ); } );
+		mGraph.read( pass, raysMask );
+		mGraph.write( pass, rays, RG_LOAD_DONTCARE );
+	}
+
+	if( mFrame.computePost && computePostAvailable() ){
+		// COMPUTE POST-PROCESSING:
+		// Blur, bloom and the screen filters as compute dispatches, then blit to the output
+		post_params_t params;
+		params.bloom = mFrame.bloom;
+		params.exposure = mFrame.exposure;
+		params.blurAmount = mFrame.blurAmount;
+		params.kernel = mFrame.postKernel;
+		params.grayscale = mFrame.grayscale;
+		params.quantize = lores ? 4 : 0;
+		params.width = mRenderWidth;
+		params.height = mRenderHeight;
+		params.raysTex = 0;
+		params.depthTex = 0;
+		params.raysUvScale = mRaysUvScale;
+		params.raysWidth = mRaysWidth;
+		params.raysHeight = mRaysHeight;
+		params.nearPlane = CAMERA_NEAR;
+		params.farPlane = CAMERA_FAR;
+
+		pass = mGraph.addPass( "computePost", [=]( RenderGraph &graph ){
+			post_params_t frameParams = params;
+			if( godrays ){
+				frameParams.raysTex = graph.texture( rays );
+				frameParams.depthTex = graph.texture( sceneDepth );
+			}
+			runComputePost( graph.texture( sceneColor ), graph.texture( brightColor ), frameParams );
+			if( upscale && !lores ) renderUpscale( computePostOutput(), false );
+			else blitComputePost( framebuffer, outputWidth, outputHeight, !lores );
+		} );
+		mGraph.read( pass, sceneColor );
+		if( mFrame.bloom ) mGraph.read( pass, brightColor );
+		if( godrays ){
+			mGraph.read( pass, sceneDepth );
+			mGraph.read( pass, rays );
+		}
+		mGraph.write( pass, backbuffer, RG_LOAD_DONTCARE );
+	}
+	else {
+		// GAUSSIAN BLUR:
+		// Blur the secondary highlight buffer, each pass reads what the previous one wrote
+		rg_handle_t blurred = brightColor;
+		bool horizontal = true;
+		for( unsigned int i = 0; i < mFrame.blurAmount; i++ ){
+			rg_handle_t target = mGraph.createTexture( "blur", makeTextureDesc( formats[TARGET_BLUR], fbWidth, fbHeight, GL_LINEAR ) );
+			mGraph.setArea( target, mRenderWidth, mRenderHeight );
+			pass = mGraph.addPass( "blur", [=]( RenderGraph &graph ){
+				renderConvolution( graph.texture( blurred ), mBloomKernel, horizontal ? CONV_PASS_HORIZONTAL : CONV_PASS_VERTICAL );
+			} );
+			mGraph.read( pass, blurred );
+			mGraph.write( pass, target, RG_LOAD_DONTCARE );
+			blurred = target;
+			horizontal = !horizontal;
+		}
+
+		// BLOOM:
+		// We must draw onto yet another offscreen buffer below full resolution, otherwise draw right to the output
+		rg_handle_t bloomTarget = backbuffer;
+		if( upscale ){
+			bloomTarget = mGraph.createTexture( "lowres", makeTextureDesc( formats[lores ? TARGET_LORES : TARGET_UPSCALE], fbWidth, fbHeight, lores ? GL_NEAREST : GL_LINEAR ) );
+			mGraph.setArea( bloomTarget, mRenderWidth, mRenderHeight );
+		}
+
+		// the post kernel needs the composite in a texture to read its neighbours
+		const conv_kernel_t *postKernel = mFrame.postKernel != POST_KERNEL_NONE ? &mPostKernels[mFrame.postKernel] : NULL;
+		rg_handle_t composite = bloomTarget;
+		if( postKernel ){
+			composite = mGraph.createTexture( "composite", makeTextureDesc( formats[TARGET_UPSCALE], fbWidth, fbHeight ) );
+			mGraph.setArea( composite, mRenderWidth, mRenderHeight );
+		}
+
+		pass = mGraph.addPass( "bloom", [=]( RenderGraph &graph ){
+			renderBloom( graph.texture( sceneColor ), graph.texture( blurred ), graph.texture( sceneDepth ), godrays ? graph.texture( rays ) : 0 );
+		} );
+		mGraph.read( pass, sceneColor );
+		if( mFrame.bloom ) mGraph.read( pass, blurred );
+		if( godrays ){
+			mGraph.read( pass, sceneDepth );
+			mGraph.read( pass, rays );
+		}
+		mGraph.write( pass, composite );
+
+		// POST KERNEL:
+		// POST_KERNELS' weights through fconvolve.txt, in two passes when separable
+		if( postKernel ){
+			rg_handle_t source = composite;
+			if( postKernel->separable ){
+				// signed float, the row pass of a kernel with negative weights (Sobel...) goes below 0
+				rg_handle_t across = mGraph.createTexture( "kernelAcross", makeTextureDesc( GL_RGBA16F, fbWidth, fbHeight ) );
+				mGraph.setArea( across, mRenderWidth, mRenderHeight );
+				pass = mGraph.addPass( "kernelAcross", [=]( RenderGraph &graph ){
+					renderConvolution( graph.texture( composite ), *postKernel, CONV_PASS_HORIZONTAL );
+				} );
+				mGraph.read( pass, composite );
+				mGraph.write( pass, across, RG_LOAD_DONTCARE );
+				source = across;
+			}
+
+			conv_pass_t last = postKernel->separable ? CONV_PASS_VERTICAL : CONV_PASS_FULL;
+			pass = mGraph.addPass( "kernel", [=]( RenderGraph &graph ){ renderConvolution( graph.texture( source ), *postKernel, last ); } );
+			mGraph.read( pass, source );
+			mGraph.write( pass, bloomTarget );
+		}
+
+		if( upscale ){
+			pass = mGraph.addPass( "upscale", [=]( RenderGraph &graph ){ renderUpscale( graph.texture( bloomTarget ), lores ); } );
+			mGraph.read( pass, bloomTarget );
+			mGraph.write( pass, backbuffer );
+		}
+	}
+
+	mGraph.compile();
+	mGraph.execute();
+	streamEndFrame();
+	stepLightBenchmark();
+	gpuProfilerEndFrame( mFrame.gpuProfile );
+}
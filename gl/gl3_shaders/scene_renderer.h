@@ -0,0 +1,194 @@
+#ifndef SCENE_RENDERER_H
+#define SCENE_RENDERER_H
+
+#include "gl_utils.h"
+#include "render_graph.h"
+#include "draw_queue.h"
+#include "convolution.h"
+#include "post_compute.h"
+#include "shadow_atlas.h"
+#include "light_clusters.h"
+#include "stream_ring.h"
+#include "gpu_profiler.h"
+
+///////////////////////////////////
+///// SCENE_RENDERER HEADER ///////
+///////////////////////////////////
+
+// The demo scene and everything that goes into one frame of it: shadow atlas, depth prepass,
+// lit scene, transparency, then compute or fragment post-processing, drawn into the window or
+// into a framebuffer of the caller's. Programs, vertex arrays, the render graph, the draw
+// queues and the per-context state of the shadow atlas, light clusters, stream ring, compute
+// post and GPU profiler all live in the instance, so several renderers can run at once, each
+// on its own thread and GL context. Only scene_assets_t is shared between them.
+//
+// init() and close() run with the renderer's context current. A thread that takes the
+// context over afterwards calls makeCurrent() before rendering. The GL state cache belongs to
+// whoever owns the context, see gl_state.h.
+
+const float CAMERA_NEAR		= 1.0f;
+const float CAMERA_FAR		= 1000.0f;
+
+const float CUBE_SIZE = 5.0f;
+const float FLOOR_SIZE = 100.0f;
+const float FLOOR_HEIGHT = 10.0f;
+
+// Cube and floor, shared by the GL vertex buffers and the software rasterizer
+const unsigned int SCENE_VERTEX_FLOATS = 8;		// position, normal, uv
+const unsigned int CUBE_VERTEX_COUNT = 24;
+const unsigned int CUBE_INDEX_COUNT = 36;
+const unsigned int FLOOR_VERTEX_COUNT = 4;
+const unsigned int FLOOR_INDEX_COUNT = 6;
+
+extern const float CUBE_VERTICES[CUBE_VERTEX_COUNT * SCENE_VERTEX_FLOATS];
+extern const unsigned int CUBE_INDICES[CUBE_INDEX_COUNT];
+extern const float FLOOR_VERTICES[FLOOR_VERTEX_COUNT * SCENE_VERTEX_FLOATS];
+extern const unsigned int FLOOR_INDICES[FLOOR_INDEX_COUNT];
+
+// Made once in one context, then only read by every renderer sharing that context's objects
+typedef struct {
+	GLuint cubeVBO;
+	GLuint cubeEBO;
+	GLuint floorVBO;
+	GLuint floorEBO;
+	GLuint cubeTexture;		// see-through, drawn after the opaque draws
+	GLuint floorTexture;
+} scene_assets_t;
+
+bool createSceneAssets( scene_assets_t &assets );
+void destroySceneAssets( scene_assets_t &assets );
+
+// What a frame shows and which parts of the pipeline draw it
+typedef struct {
+	glm::mat4 model;				// the textured cube
+	glm::mat4 matFloor;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	glm::vec3 lightPos;
+	float fieldAngle;				// spins the cube field, moves the extra lights
+	glm::vec4 clearColor;
+	bool drawCube;
+	bool drawFloor;
+	bool bloom;
+	bool computePost;				// when GL 4.3 is there
+	bool grayscale;
+	bool cubeField;
+	bool gpuProfile;				// print the GPU times every few seconds
+	bool lores;						// 320x200, unfiltered and colour quantized
+	bool godrays;
+	bool compactTargets;
+	bool depthPrepass;
+	bool oit;
+	unsigned int clusterLights;		// point light count
+	unsigned int shadowLights;		// shadowed point light count
+	post_kernel_t postKernel;
+	float exposure;
+	unsigned int blurAmount;
+	float renderScale;				// of the output size, below 1 for dynamic resolution
+} scene_frame_t;
+
+class SceneRenderer {
+public:
+	SceneRenderer();
+
+	bool init( const scene_assets_t &assets, unsigned int width, unsigned int height );	// output and targets this size
+	void close();					// also after a failed init()
+	void makeCurrent();				// on each thread before it renders, after the context
+
+	void resize( unsigned int width, unsigned int height );			// output size, the projection follows at once
+	void resizeTargets( unsigned int width, unsigned int height );	// reallocates, output beyond them is scaled up
+	void render( const scene_frame_t &frame, GLuint framebuffer=0 );	// 0 is the window
+
+	void startLightBenchmark();		// steps through the light counts over the next frames
+	unsigned int renderWidth() const { return mRenderWidth; }
+	unsigned int renderHeight() const { return mRenderHeight; }
+
+private:
+	// light benchmark: each count rendered for a while, then CPU assignment and GPU scene time printed
+	struct LightBench {
+		int step;				// into LIGHT_BENCH_COUNTS, -1 when not running
+		unsigned int frame;		// within the step
+		double assignMs;
+		double gpuMs;
+		unsigned int gpuSamples;
+	};
+
+	unsigned int frameLightCount() const;
+	void stepLightBenchmark();
+	draw_command_t makeTransparentCommand( GLuint vao, GLuint texture, GLsizei indexCount, const glm::mat4 &model, float depth );
+	void queueCubeField( float far_plane );
+	void queueScene( float far_plane );
+	void gatherShadowLights();
+	void setViewport();
+	void renderQuad();
+	void processShadows();
+	void renderDepthPrepass();
+	void uploadCamera();
+	void setSceneUniforms( GLuint program, GLuint shadowMap );
+	void renderScene( GLuint shadowMap, bool depthPrepass, bool oit );
+	void renderTransparentOIT( GLuint shadowMap );
+	void renderCompositeOIT( GLuint accumTex, GLuint weightTex );
+	void renderConvolution( GLuint source, const conv_kernel_t &kernel, conv_pass_t convPass );
+	void renderRaysMask( GLuint depthTex );
+	void renderRays( GLuint maskTex );
+	void renderBloom( GLuint sceneTex, GLuint bloomTex, GLuint depthTex, GLuint raysTex );
+	void renderUpscale( GLuint source, bool pixelated );
+
+	// this renderer's share of the module singletons, installed by makeCurrent()
+	shadow_atlas_t *mAtlas;
+	light_clusters_t *mClusters;
+	stream_ring_t *mRing;
+	compute_post_t *mCompute;
+	gpu_profiler_t *mProfiler;
+
+	scene_assets_t mAssets;
+
+	// shader programs
+	GLuint mProgram;
+	GLuint mScreenProgram;
+	GLuint mConvolveProgram;
+	GLuint mBloomProgram;
+	GLuint mShadowProgram;
+	GLuint mRaysProgram;
+	GLuint mRaysMaskProgram;
+	GLuint mUpscaleProgram;
+	GLuint mDepthProgram;
+	GLuint mOitProgram;
+	GLuint mOitCompositeProgram;
+
+	// convolution kernels for fconvolve.txt
+	conv_kernel_t mBloomKernel;							// 9x9 Gaussian, one direction per blur pass
+	conv_kernel_t mPostKernels[POST_KERNEL_COUNT];		// the post kernel on the fragment path
+
+	// vertex arrays can't be shared between contexts, these point at the shared buffers
+	GLuint mCubeVAO;
+	GLuint mFloorVAO;
+	GLuint mScreenVAO;
+	GLuint mScreenVBO;
+	GLuint mScreenEBO;
+	GLuint mCameraUBO;			// camera block when the stream ring is full
+
+	// scene, blur and lo-res targets are declared per frame in render() and owned by the graph
+	RenderGraph mGraph;
+	DrawQueue mDrawQueue;
+	std::vector<DrawQueue> mWorkerQueues;	// one per job worker, merged into mDrawQueue
+	std::vector<shadow_light_t> mShadowLights;	// this frame's
+	scene_frame_t mFrame;					// the frame being rendered
+	LightBench mLightBench;
+
+	// Render resolution, targets are allocated at the target size and drawn to from the bottom left
+	glm::mat4 mProj;
+	unsigned int mOutputWidth;
+	unsigned int mOutputHeight;
+	unsigned int mTargetWidth;
+	unsigned int mTargetHeight;
+	unsigned int mRenderWidth;
+	unsigned int mRenderHeight;
+	glm::vec2 mUvScale;					// render size over target size
+	glm::vec3 mRaysLight;				// light position for god rays: 0..1 across the image, window depth
+	glm::vec2 mRaysUvScale;				// like mUvScale, for the god rays targets
+	unsigned int mRaysWidth;			// god rays render size
+	unsigned int mRaysHeight;
+};
+
+#endif
@@ -0,0 +1,290 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "shadow_atlas.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+#include "gpu_profiler.h"
+#include "draw_queue.h"
+#include <algorithm>
+
+//////////////////////////////////
+/////// SHADOW_ATLAS.CPP /////////
+//////////////////////////////////
+
+const unsigned int SHADOW_PAGE_BLOCKS = ( SHADOW_MAX_RES / SHADOW_MIN_RES ) * ( SHADOW_MAX_RES / SHADOW_MIN_RES );
+const unsigned int SHADOW_PAGES_X = SHADOW_ATLAS_WIDTH / SHADOW_MAX_RES;
+
+// cube face directions and up vectors, in GL cubemap order +X -X +Y -Y +Z -Z
+const glm::vec3 SHADOW_FACE_DIRS[6] = {
+	glm::vec3( 1.0f, 0.0f, 0.0f ), glm::vec3( -1.0f, 0.0f, 0.0f ), glm::vec3( 0.0f, 1.0f, 0.0f ),
+	glm::vec3( 0.0f, -1.0f, 0.0f ), glm::vec3( 0.0f, 0.0f, 1.0f ), glm::vec3( 0.0f, 0.0f, -1.0f )
+};
+const glm::vec3 SHADOW_FACE_UPS[6] = {
+	glm::vec3( 0.0f, -1.0f, 0.0f ), glm::vec3( 0.0f, -1.0f, 0.0f ), glm::vec3( 0.0f, 0.0f, 1.0f ),
+	glm::vec3( 0.0f, 0.0f, -1.0f ), glm::vec3( 0.0f, -1.0f, 0.0f ), glm::vec3( 0.0f, -1.0f, 0.0f )
+};
+
+typedef struct {
+	shadow_light_t light;
+	float importance;
+	unsigned int resolution;	// per face, 0 = no tiles
+	shadow_tile_t faces[6];
+} shadow_slot_t;
+
+struct shadow_atlas_t {
+	bool ready;
+	GLuint texture;
+	GLuint fbo;
+	std::vector<shadow_slot_t> slots;
+	glm::mat3 faceRotations[6];		// world to face view, without the light's translation
+	std::string lastStats;
+};
+
+shadow_atlas_t gAtlas;							// used while no renderer installed its own
+thread_local shadow_atlas_t *tAtlas = NULL;		// the one shadowAtlasMakeCurrent() installed
+
+inline shadow_atlas_t &currentShadowAtlas(){
+	return tAtlas ? *tAtlas : gAtlas;
+}
+
+shadow_atlas_t *shadowAtlasCreate(){
+	return new shadow_atlas_t();
+}
+
+void shadowAtlasDestroy( shadow_atlas_t *atlas ){
+	if( tAtlas == atlas ) tAtlas = NULL;
+	delete atlas;
+}
+
+void shadowAtlasMakeCurrent( shadow_atlas_t *atlas ){
+	tAtlas = atlas;
+}
+
+bool initShadowAtlas(){
+	shadow_atlas_t &atlas = currentShadowAtlas();
+	glGenTextures( 1, &atlas.texture );
+	stateBindTexture( 0, GL_TEXTURE_2D, atlas.texture );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, SHADOW_ATLAS_WIDTH, SHADOW_ATLAS_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL );
+
+	// sampled as sampler2DShadow, linear filtering makes each lookup a 2x2 PCF
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+
+	glGenFramebuffers( 1, &atlas.fbo );
+	stateBindFramebuffer( GL_FRAMEBUFFER, atlas.fbo );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas.texture, 0 );
+	glDrawBuffer( GL_NONE );	// depth only
+	glReadBuffer( GL_NONE );
+	bool complete = glCheckFramebufferStatus( GL_FRAMEBUFFER ) == GL_FRAMEBUFFER_COMPLETE;
+	stateBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+	if( !complete ){
+		printf( "ERROR: Create shadow atlas framebuffer failed!\n" );
+		return false;
+	}
+
+	gpuMemoryTrack( GPU_MEM_TEXTURE, atlas.texture, "shadows", "atlas", textureBytes( GL_DEPTH_COMPONENT16, SHADOW_ATLAS_WIDTH, SHADOW_ATLAS_HEIGHT ) );
+
+	for( unsigned int f = 0; f < 6; f++ )
+		atlas.faceRotations[f] = glm::mat3( glm::lookAt( glm::vec3( 0.0f ), SHADOW_FACE_DIRS[f], SHADOW_FACE_UPS[f] ) );
+
+	atlas.ready = true;
+	printf( "SUCCESS: Shadow atlas %ux%u created...\n", SHADOW_ATLAS_WIDTH, SHADOW_ATLAS_HEIGHT );
+	return true;
+}
+
+void closeShadowAtlas(){
+	shadow_atlas_t &atlas = currentShadowAtlas();
+	stateForgetFramebuffer( atlas.fbo );
+	stateForgetTexture( atlas.texture );
+	gpuMemoryUntrack( GPU_MEM_TEXTURE, atlas.texture );
+	glDeleteFramebuffers( 1, &atlas.fbo );
+	glDeleteTextures( 1, &atlas.texture );
+	atlas.ready = false;
+}
+
+GLuint shadowAtlasTexture(){
+	return currentShadowAtlas().texture;
+}
+
+unsigned int nextPowerOfTwo( unsigned int v ){
+	unsigned int p = 1;
+	while( p < v ) p <<= 1;
+	return p;
+}
+
+// every other bit, for Z-order
+unsigned int compactBits( unsigned int v ){
+	v &= 0x55555555;
+	v = ( v | ( v >> 1 ) ) & 0x33333333;
+	v = ( v | ( v >> 2 ) ) & 0x0F0F0F0F;
+	v = ( v | ( v >> 4 ) ) & 0x00FF00FF;
+	v = ( v | ( v >> 8 ) ) & 0x0000FFFF;
+	return v;
+}
+
+bool largerTile( const shadow_slot_t *a, const shadow_slot_t *b ){
+	return a->resolution > b->resolution;
+}
+
+void planShadowAtlas( const std::vector<shadow_light_t> &lights, const glm::mat4 &view, const glm::mat4 &proj ){
+	shadow_atlas_t &atlas = currentShadowAtlas();
+	unsigned int count = std::min( (unsigned int)lights.size(), SHADOW_MAX_LIGHTS );
+	frustum_t frustum = makeFrustum( proj * view );
+	glm::vec3 eye = glm::vec3( glm::inverse( view )[3] );
+	unsigned int i, f;
+
+	// IMPORTANCE:
+	// How much of the screen the light's range can cover, 1 once the camera is inside it
+	atlas.slots.resize( count );
+	for( i = 0; i < count; i++ ){
+		shadow_slot_t &slot = atlas.slots[i];
+		slot.light = lights[i];
+		slot.importance = 0.0f;
+		slot.resolution = 0;
+
+		if( !sphereInFrustum( frustum, slot.light.position, slot.light.farPlane ) ) continue;
+
+		float distance = glm::length( eye - slot.light.position );
+		slot.importance = slot.light.farPlane / std::max( distance, slot.light.farPlane );
+		slot.resolution = nextPowerOfTwo( (unsigned int)( slot.importance * SHADOW_MAX_RES ) );
+		slot.resolution = std::min( std::max( slot.resolution, SHADOW_MIN_RES ), SHADOW_MAX_RES );
+	}
+
+	// BUDGET:
+	// Until six faces of every light fit, halve the light with the most texels for its
+	// importance, once everything is at SHADOW_MIN_RES drop the least important ones
+	unsigned int capacity = SHADOW_ATLAS_WIDTH * SHADOW_ATLAS_HEIGHT;
+	for( ;; ){
+		unsigned int used = 0;
+		for( i = 0; i < count; i++ )
+			used += 6 * atlas.slots[i].resolution * atlas.slots[i].resolution;
+		if( used <= capacity ) break;
+
+		int shrink = -1, drop = -1;
+		for( i = 0; i < count; i++ ){
+			const shadow_slot_t &slot = atlas.slots[i];
+			if( slot.resolution > SHADOW_MIN_RES && ( shrink < 0 ||
+				slot.resolution * atlas.slots[shrink].importance >= atlas.slots[shrink].resolution * slot.importance ) ) shrink = i;
+			if( slot.resolution > 0 && ( drop < 0 || slot.importance <= atlas.slots[drop].importance ) ) drop = i;
+		}
+		if( shrink >= 0 ) atlas.slots[shrink].resolution /= 2;
+		else atlas.slots[drop].resolution = 0;
+	}
+
+	// PACKING:
+	// Biggest tiles first, walking SHADOW_MIN_RES blocks in Z-order through each page. Sizes
+	// only go down, so the cursor always sits on a boundary of the current tile size.
+	std::vector<shadow_slot_t*> order;
+	for( i = 0; i < count; i++ )
+		order.push_back( &atlas.slots[i] );
+	std::stable_sort( order.begin(), order.end(), largerTile );
+
+	unsigned int cursor = 0;
+	for( i = 0; i < order.size() && order[i]->resolution > 0; i++ ){
+		unsigned int size = order[i]->resolution;
+		unsigned int blocks = ( size / SHADOW_MIN_RES ) * ( size / SHADOW_MIN_RES );
+		for( f = 0; f < 6; f++ ){
+			unsigned int page = cursor / SHADOW_PAGE_BLOCKS, local = cursor % SHADOW_PAGE_BLOCKS;
+			shadow_tile_t &tile = order[i]->faces[f];
+			tile.x = ( page % SHADOW_PAGES_X ) * SHADOW_MAX_RES + compactBits( local ) * SHADOW_MIN_RES;
+			tile.y = ( page / SHADOW_PAGES_X ) * SHADOW_MAX_RES + compactBits( local >> 1 ) * SHADOW_MIN_RES;
+			tile.size = size;
+			cursor += blocks;
+		}
+	}
+}
+
+void renderShadowAtlas( GLuint program, const shadow_draw_t &drawCasters ){
+	shadow_atlas_t &atlas = currentShadowAtlas();
+	GpuScope scope( "shadowCasters" );
+
+	stateUseProgram( program );
+	stateBindFramebuffer( GL_FRAMEBUFFER, atlas.fbo );
+	stateEnable( GL_SCISSOR_TEST );		// clears only touch the tile being drawn
+	GLint matrixLocation = glGetUniformLocation( program, "shadowMatrix" );
+
+	for( unsigned int i = 0; i < atlas.slots.size(); i++ ){
+		const shadow_slot_t &slot = atlas.slots[i];
+		if( slot.resolution == 0 ) continue;
+
+		const glm::vec3 &pos = slot.light.position;
+		glm::mat4 faceProj = glm::perspective( glm::radians( 90.0f ), 1.0f, SHADOW_NEAR, slot.light.farPlane );
+		glUniform1f( glGetUniformLocation( program, "far_plane" ), slot.light.farPlane );
+		glUniform3f( glGetUniformLocation( program, "lightPos" ), pos.x, pos.y, pos.z );
+
+		for( unsigned int f = 0; f < 6; f++ ){
+			const shadow_tile_t &tile = slot.faces[f];
+			stateViewport( tile.x, tile.y, tile.size, tile.size );
+			glScissor( tile.x, tile.y, tile.size, tile.size );
+			glClear( GL_DEPTH_BUFFER_BIT );
+
+			glm::mat4 shadowMatrix = faceProj * glm::lookAt( pos, pos + SHADOW_FACE_DIRS[f], SHADOW_FACE_UPS[f] );
+			stateUseProgram( program );		// the casters may have switched
+			glUniformMatrix4fv( matrixLocation, 1, GL_FALSE, glm::value_ptr( shadowMatrix ) );
+			drawCasters();
+		}
+	}
+
+	stateDisable( GL_SCISSOR_TEST );
+	printShadowAtlasStats();
+}
+
+void setShadowAtlasUniforms( GLuint program, unsigned int unit ){
+	shadow_atlas_t &atlas = currentShadowAtlas();
+	glm::vec4 lights[SHADOW_MAX_LIGHTS];
+	glm::vec3 colors[SHADOW_MAX_LIGHTS];
+	glm::vec4 tiles[SHADOW_MAX_LIGHTS * 6];
+	int count = 0;
+
+	// lights without tiles are out of view, they are left out of the shading too
+	for( unsigned int i = 0; i < atlas.slots.size(); i++ ){
+		const shadow_slot_t &slot = atlas.slots[i];
+		if( slot.resolution == 0 ) continue;
+
+		lights[count] = glm::vec4( slot.light.position, slot.light.farPlane );
+		colors[count] = slot.light.color;
+		for( unsigned int f = 0; f < 6; f++ )
+			tiles[count * 6 + f] = glm::vec4( (float)slot.faces[f].x / SHADOW_ATLAS_WIDTH, (float)slot.faces[f].y / SHADOW_ATLAS_HEIGHT,
+											  (float)slot.faces[f].size / SHADOW_ATLAS_WIDTH, (float)slot.faces[f].size / SHADOW_ATLAS_HEIGHT );
+		count++;
+	}
+
+	glUniform1i( glGetUniformLocation( program, "shadowAtlas" ), unit );
+	glUniform1i( glGetUniformLocation( program, "shadowLightCount" ), count );
+	glUniform2f( glGetUniformLocation( program, "shadowTexel" ), 1.0f / SHADOW_ATLAS_WIDTH, 1.0f / SHADOW_ATLAS_HEIGHT );
+	glUniformMatrix3fv( glGetUniformLocation( program, "shadowFaces" ), 6, GL_FALSE, glm::value_ptr( atlas.faceRotations[0] ) );
+	if( count ){
+		glUniform4fv( glGetUniformLocation( program, "shadowLights" ), count, glm::value_ptr( lights[0] ) );
+		glUniform3fv( glGetUniformLocation( program, "shadowLightColors" ), count, glm::value_ptr( colors[0] ) );
+		glUniform4fv( glGetUniformLocation( program, "shadowTiles" ), count * 6, glm::value_ptr( tiles[0] ) );
+	}
+}
+
+// print the face resolutions whenever they change
+void printShadowAtlasStats(){
+	shadow_atlas_t &atlas = currentShadowAtlas();
+	std::string stats = "SHADOW ATLAS:";
+	unsigned int used = 0;
+	char entry[32];
+
+	for( unsigned int i = 0; i < atlas.slots.size(); i++ ){
+		unsigned int res = atlas.slots[i].resolution;
+		snprintf( entry, sizeof( entry ), " %u", res );
+		stats += entry;
+		used += 6 * res * res;
+	}
+	snprintf( entry, sizeof( entry ), " per face, %.0f%% used", 100.0f * used / ( SHADOW_ATLAS_WIDTH * SHADOW_ATLAS_HEIGHT ) );
+	stats += entry;
+
+	if( stats != atlas.lastStats ){
+		printf( "%s\n", stats.c_str() );
+		atlas.lastStats = stats;
+	}
+}
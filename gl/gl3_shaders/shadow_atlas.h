@@ -0,0 +1,65 @@
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include "gl_utils.h"
+#include <functional>
+
+///////////////////////////////////
+////// SHADOW_ATLAS HEADER ////////
+///////////////////////////////////
+
+// Omnidirectional shadows for several point lights, sharing one 16-bit depth texture.
+// Every frame each light gets a face resolution from how much of the screen its range
+// covers, then the least important lights are halved until all six faces of every light
+// fit the atlas, which is the whole memory budget. Faces are square power of two tiles,
+// packed largest first along a Z-order curve through SHADOW_MAX_RES pages so they never
+// overlap or leave holes. Lights whose range is off screen get no tiles at all.
+//
+// Depth is distance to the light over its far plane, as fshadow.txt writes it.
+
+const unsigned int SHADOW_MAX_LIGHTS = 4;
+const unsigned int SHADOW_MIN_RES = 64;
+const unsigned int SHADOW_MAX_RES = 1024;
+const unsigned int SHADOW_ATLAS_WIDTH = 4096;		// multiples of SHADOW_MAX_RES,
+const unsigned int SHADOW_ATLAS_HEIGHT = 3072;		// 24 MB of DEPTH_COMPONENT16
+const float SHADOW_NEAR = 1.0f;
+
+typedef struct {
+	glm::vec3 position;
+	glm::vec3 color;
+	float farPlane;			// shadow and light range
+} shadow_light_t;
+
+typedef struct {
+	unsigned int x;			// texels
+	unsigned int y;
+	unsigned int size;
+} shadow_tile_t;
+
+typedef std::function<void()> shadow_draw_t;
+
+// The texture and framebuffer belong to one GL context. Each SceneRenderer creates an atlas
+// and installs it on the thread it renders from; with none installed calls use a default one.
+struct shadow_atlas_t;
+shadow_atlas_t *shadowAtlasCreate();				// initShadowAtlas() it in the context it renders with
+void shadowAtlasDestroy( shadow_atlas_t *atlas );	// after closeShadowAtlas()
+void shadowAtlasMakeCurrent( shadow_atlas_t *atlas );	// this thread only, NULL for the default
+
+bool initShadowAtlas();
+void closeShadowAtlas();
+GLuint shadowAtlasTexture();
+
+// Importance, budget and tile placement for this frame's lights, at most SHADOW_MAX_LIGHTS
+void planShadowAtlas( const std::vector<shadow_light_t> &lights, const glm::mat4 &view, const glm::mat4 &proj );
+
+// Draws every planned face. 'program' gets shadowMatrix, lightPos and far_plane, then
+// drawCasters submits the geometry.
+void renderShadowAtlas( GLuint program, const shadow_draw_t &drawCasters );
+
+// Light and tile uniforms for a program sampling the atlas on 'unit' (see fshader.txt),
+// binding the texture is left to the caller
+void setShadowAtlasUniforms( GLuint program, unsigned int unit );
+
+void printShadowAtlasStats();	// when the plan changes
+
+#endif
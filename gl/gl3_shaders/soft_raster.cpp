@@ -0,0 +1,485 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "soft_raster.h"
+#include "jobs.h"
+#include "cpu_profiler.h"
+#include <SDL2/SDL_image.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string>
+#include <math.h>
+#include <string.h>
+
+#if !defined( __SSE2__ ) && !defined( _M_X64 )
+#error "soft_raster.cpp needs SSE2"
+#endif
+
+//////////////////////////////////
+/////// SOFT_RASTER.CPP //////////
+//////////////////////////////////
+
+typedef struct {
+	glm::vec4 pos;				// clip space
+	float u, v;
+} soft_vertex_t;
+
+// Everything interpolated is a plane over the screen, value = dx * x + dy * y + c,
+// so a pixel costs two multiply-adds per attribute and no barycentrics.
+typedef struct {
+	float edge[3][3];			// A, B, C per edge, positive inside
+	bool topLeft[3];			// pixels exactly on these edges belong to this triangle
+	float z[3];					// window depth
+	float w[3];					// 1 / w
+	float u[3];					// u / w, divided by the 1 / w plane per pixel
+	float v[3];
+	int minX, minY, maxX, maxY;	// inclusive, on screen
+	unsigned int state;
+} soft_triangle_t;
+
+typedef struct {
+	bool ready;
+	unsigned int width, height;
+	unsigned int stride;		// pixels per row, rows and columns are whole tiles
+	unsigned int tilesX, tilesY;
+	std::vector<uint32_t> color;
+	std::vector<float> depth;
+	bool clearPending;
+	uint32_t clearColor;
+	std::vector<soft_state_t> states;			// per draw since the last finish
+	std::vector<soft_triangle_t> triangles;
+	std::vector< std::vector<uint32_t> > bins;	// triangle indices per tile, capacity kept
+	std::vector<soft_vertex_t> transformed;		// one draw's vertices
+	soft_raster_stats_t stats;					// the frame being drawn
+	soft_raster_stats_t lastStats;
+} soft_raster_t;
+
+soft_raster_t gSoft;
+
+uint32_t softPackColor( const glm::vec4 &color ){
+	uint32_t packed = 0;
+	for( int i = 0; i < 4; i++ )
+		packed |= (uint32_t)( glm::clamp( color[i], 0.0f, 1.0f ) * 255.0f + 0.5f ) << ( i * 8 );
+	return packed;
+}
+
+bool initSoftRaster( unsigned int width, unsigned int height ){
+	gSoft.width = width;
+	gSoft.height = height;
+	gSoft.tilesX = ( width + SOFT_TILE_SIZE - 1 ) / SOFT_TILE_SIZE;
+	gSoft.tilesY = ( height + SOFT_TILE_SIZE - 1 ) / SOFT_TILE_SIZE;
+	gSoft.stride = gSoft.tilesX * SOFT_TILE_SIZE;
+
+	size_t pixels = gSoft.stride * gSoft.tilesY * SOFT_TILE_SIZE;
+	gSoft.color.assign( pixels, 0 );
+	gSoft.depth.assign( pixels, 1.0f );
+	gSoft.bins.assign( gSoft.tilesX * gSoft.tilesY, std::vector<uint32_t>() );
+	gSoft.clearPending = false;
+	gSoft.clearColor = 0;
+	gSoft.states.clear();
+	gSoft.triangles.clear();
+	memset( &gSoft.stats, 0, sizeof( gSoft.stats ) );
+	gSoft.lastStats = gSoft.stats;
+
+	gSoft.ready = true;
+	printf( "SUCCESS: Software rasterizer ready, %ux%u in %u tiles of %u...\n", width, height,
+			gSoft.tilesX * gSoft.tilesY, SOFT_TILE_SIZE );
+	return true;
+}
+
+void closeSoftRaster(){
+	gSoft.color.clear();
+	gSoft.depth.clear();
+	gSoft.bins.clear();
+	gSoft.triangles.clear();
+	gSoft.states.clear();
+	gSoft.ready = false;
+}
+
+soft_state_t softDefaultState(){
+	soft_state_t state;
+	state.texture = NULL;
+	state.tint = glm::vec4( 1.0f );
+	state.filter = SOFT_FILTER_BILINEAR;
+	state.depthTest = true;
+	state.depthWrite = true;
+	state.cullBack = true;
+	state.blend = false;
+	return state;
+}
+
+bool softLoadTexture( const char *filename, soft_texture_t *texture ){
+	std::string imagePath = SDL_GetBasePath() + std::string( filename );
+
+	printf( "ATTEMPT: Loading software texture: %s\n", imagePath.c_str() );
+	SDL_Surface *image = IMG_Load( imagePath.c_str() );
+	if( image == nullptr ){
+		printf( "ERROR: Could not load texture - %s\n", SDL_GetError() );
+		return false;
+	}
+
+	SDL_Surface *rgba = SDL_ConvertSurfaceFormat( image, SDL_PIXELFORMAT_RGBA32, 0 );
+	SDL_FreeSurface( image );
+	if( rgba == nullptr ){
+		printf( "ERROR: Could not convert texture - %s\n", SDL_GetError() );
+		return false;
+	}
+
+	texture->width = rgba->w;
+	texture->height = rgba->h;
+	texture->texels.resize( rgba->w * rgba->h );
+	SDL_LockSurface( rgba );
+	for( int y = 0; y < rgba->h; y++ )
+		memcpy( &texture->texels[y * rgba->w], (const uint8_t*)rgba->pixels + y * rgba->pitch, rgba->w * sizeof( uint32_t ) );
+	SDL_UnlockSurface( rgba );
+	SDL_FreeSurface( rgba );
+
+	printf( "SUCCESS: Loaded software texture: %s\n", filename );
+	return true;
+}
+
+void softClear( const glm::vec4 &color ){
+	gSoft.clearPending = true;
+	gSoft.clearColor = softPackColor( color );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=- SETUP -=-=-=-=-=-=-
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+// attribute plane through the three screen positions, 'area' is twice the signed area
+void softPlane( const float x[3], const float y[3], const float value[3], float area, float plane[3] ){
+	float d1 = value[1] - value[0], d2 = value[2] - value[0];
+	plane[0] = ( d1 * ( y[2] - y[0] ) - d2 * ( y[1] - y[0] ) ) / area;
+	plane[1] = ( d2 * ( x[1] - x[0] ) - d1 * ( x[2] - x[0] ) ) / area;
+	plane[2] = value[0] - plane[0] * x[0] - plane[1] * y[0];
+}
+
+void softSetupTriangle( const soft_vertex_t &v0, const soft_vertex_t &v1, const soft_vertex_t &v2, unsigned int state ){
+	const soft_vertex_t *v[3] = { &v0, &v1, &v2 };
+	float x[3], y[3], z[3], iw[3], uw[3], vw[3];
+	soft_triangle_t t;
+	unsigned int i;
+
+	for( i = 0; i < 3; i++ ){
+		iw[i] = 1.0f / v[i]->pos.w;
+		x[i] = ( v[i]->pos.x * iw[i] * 0.5f + 0.5f ) * gSoft.width;
+		y[i] = ( 0.5f - v[i]->pos.y * iw[i] * 0.5f ) * gSoft.height;		// top row first
+		z[i] = v[i]->pos.z * iw[i] * 0.5f + 0.5f;
+		uw[i] = v[i]->u * iw[i];
+		vw[i] = v[i]->v * iw[i];
+	}
+
+	// y points down, so GL's counter-clockwise front faces come out clockwise (negative) here
+	float area = ( x[1] - x[0] ) * ( y[2] - y[0] ) - ( x[2] - x[0] ) * ( y[1] - y[0] );
+	if( area == 0.0f || ( area > 0.0f && gSoft.states[state].cullBack ) ){
+		gSoft.stats.culled++;
+		return;
+	}
+	if( area > 0.0f ){
+		std::swap( x[1], x[2] ); std::swap( y[1], y[2] ); std::swap( z[1], z[2] );
+		std::swap( iw[1], iw[2] ); std::swap( uw[1], uw[2] ); std::swap( vw[1], vw[2] );
+		area = -area;
+	}
+
+	t.minX = std::max( 0, (int)floorf( std::min( x[0], std::min( x[1], x[2] ) ) ) );
+	t.minY = std::max( 0, (int)floorf( std::min( y[0], std::min( y[1], y[2] ) ) ) );
+	t.maxX = std::min( (int)gSoft.width - 1, (int)ceilf( std::max( x[0], std::max( x[1], x[2] ) ) ) );
+	t.maxY = std::min( (int)gSoft.height - 1, (int)ceilf( std::max( y[0], std::max( y[1], y[2] ) ) ) );
+	if( t.minX > t.maxX || t.minY > t.maxY ){
+		gSoft.stats.culled++;
+		return;
+	}
+
+	// edge i runs between the other two vertices and is positive on vertex i's side
+	for( i = 0; i < 3; i++ ){
+		unsigned int a = ( i + 1 ) % 3, b = ( i + 2 ) % 3;
+		float A = y[b] - y[a], B = x[a] - x[b];
+		t.edge[i][0] = A;
+		t.edge[i][1] = B;
+		t.edge[i][2] = -A * x[a] - B * y[a];
+		t.topLeft[i] = A > 0.0f || ( A == 0.0f && B > 0.0f );
+	}
+	softPlane( x, y, z, area, t.z );
+	softPlane( x, y, iw, area, t.w );
+	softPlane( x, y, uw, area, t.u );
+	softPlane( x, y, vw, area, t.v );
+	t.state = state;
+
+	uint32_t index = gSoft.triangles.size();
+	gSoft.triangles.push_back( t );
+
+	// every tile the bounds touch, minus those lying wholly outside one of the edges
+	unsigned int tx0 = t.minX / SOFT_TILE_SIZE, tx1 = t.maxX / SOFT_TILE_SIZE;
+	unsigned int ty0 = t.minY / SOFT_TILE_SIZE, ty1 = t.maxY / SOFT_TILE_SIZE;
+	for( unsigned int ty = ty0; ty <= ty1; ty++ ){
+		for( unsigned int tx = tx0; tx <= tx1; tx++ ){
+			float left = (float)( tx * SOFT_TILE_SIZE ), top = (float)( ty * SOFT_TILE_SIZE );
+			bool outside = false;
+			for( i = 0; i < 3 && !outside; i++ ){
+				float cx = t.edge[i][0] > 0.0f ? left + SOFT_TILE_SIZE : left;
+				float cy = t.edge[i][1] > 0.0f ? top + SOFT_TILE_SIZE : top;
+				outside = t.edge[i][0] * cx + t.edge[i][1] * cy + t.edge[i][2] < 0.0f;
+			}
+			if( outside ) continue;
+			gSoft.bins[ty * gSoft.tilesX + tx].push_back( index );
+			gSoft.stats.binned++;
+		}
+	}
+}
+
+/**
+-=-=-=-=-=- softDrawIndexed -=-=-=-=-=-
+Transform, clip against the near plane (z >= -w), set up and bin
+**/
+void softDrawIndexed( const float *vertices, unsigned int stride, unsigned int uvOffset,
+					  const unsigned int *indices, unsigned int indexCount,
+					  const glm::mat4 &mvp, const soft_state_t &state ){
+	CPU_ZONE( "softDrawIndexed" );
+	if( !gSoft.ready || indexCount < 3 ) return;
+	Uint64 start = SDL_GetPerformanceCounter();
+	unsigned int i, j;
+
+	unsigned int vertexCount = 0;
+	for( i = 0; i < indexCount; i++ )
+		vertexCount = std::max( vertexCount, indices[i] + 1 );
+
+	gSoft.transformed.resize( vertexCount );
+	for( i = 0; i < vertexCount; i++ ){
+		const float *src = vertices + i * stride;
+		soft_vertex_t &dst = gSoft.transformed[i];
+		dst.pos = mvp * glm::vec4( src[0], src[1], src[2], 1.0f );
+		dst.u = src[uvOffset];
+		dst.v = src[uvOffset + 1];
+	}
+
+	unsigned int stateIndex = gSoft.states.size();
+	gSoft.states.push_back( state );
+
+	for( i = 0; i + 2 < indexCount; i += 3 ){
+		const soft_vertex_t *tri[3] = {
+			&gSoft.transformed[indices[i]], &gSoft.transformed[indices[i + 1]], &gSoft.transformed[indices[i + 2]]
+		};
+		gSoft.stats.triangles++;
+
+		unsigned int behind = 0;
+		for( j = 0; j < 3; j++ )
+			if( tri[j]->pos.z < -tri[j]->pos.w ) behind++;
+
+		if( behind == 0 ){
+			softSetupTriangle( *tri[0], *tri[1], *tri[2], stateIndex );
+			continue;
+		}
+		if( behind == 3 ){
+			gSoft.stats.culled++;
+			continue;
+		}
+
+		// one or two corners behind the near plane leave a triangle or a quad in front
+		soft_vertex_t poly[4];
+		unsigned int n = 0;
+		for( j = 0; j < 3; j++ ){
+			const soft_vertex_t &a = *tri[j], &b = *tri[( j + 1 ) % 3];
+			float da = a.pos.z + a.pos.w, db = b.pos.z + b.pos.w;
+			if( da >= 0.0f ) poly[n++] = a;
+			if( ( da >= 0.0f ) != ( db >= 0.0f ) ){
+				float s = da / ( da - db );
+				poly[n].pos = a.pos + ( b.pos - a.pos ) * s;
+				poly[n].u = a.u + ( b.u - a.u ) * s;
+				poly[n].v = a.v + ( b.v - a.v ) * s;
+				n++;
+			}
+		}
+		gSoft.stats.clipped++;
+		for( j = 1; j + 1 < n; j++ )
+			softSetupTriangle( poly[0], poly[j], poly[j + 1], stateIndex );
+	}
+
+	gSoft.stats.setupMs += (float)( 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency() );
+}
+
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+// -=-=-=-=- RASTER -=-=-=-=-=-=
+// -=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+
+inline uint32_t softTexel( const soft_texture_t &tex, int x, int y ){
+	// the demo's textures are powers of two, where wrapping is a mask
+	if( ( tex.width & ( tex.width - 1 ) ) == 0 && ( tex.height & ( tex.height - 1 ) ) == 0 )
+		return tex.texels[( y & ( tex.height - 1 ) ) * tex.width + ( x & ( tex.width - 1 ) )];
+
+	x %= (int)tex.width;
+	y %= (int)tex.height;
+	if( x < 0 ) x += tex.width;
+	if( y < 0 ) y += tex.height;
+	return tex.texels[y * tex.width + x];
+}
+
+// two channels at once, 'f' in 0..256
+inline uint32_t softLerp( uint32_t a, uint32_t b, uint32_t f ){
+	uint32_t rb = ( ( ( a & 0x00FF00FF ) * ( 256 - f ) + ( b & 0x00FF00FF ) * f ) >> 8 ) & 0x00FF00FF;
+	uint32_t ga = ( ( ( a >> 8 ) & 0x00FF00FF ) * ( 256 - f ) + ( ( b >> 8 ) & 0x00FF00FF ) * f ) & 0xFF00FF00;
+	return rb | ga;
+}
+
+uint32_t softSample( const soft_texture_t &tex, float u, float v, soft_filter_t filter ){
+	if( filter == SOFT_FILTER_NEAREST )
+		return softTexel( tex, (int)floorf( u * tex.width ), (int)floorf( v * tex.height ) );
+
+	float fx = u * tex.width - 0.5f, fy = v * tex.height - 0.5f;
+	float x0 = floorf( fx ), y0 = floorf( fy );
+	uint32_t wx = (uint32_t)( ( fx - x0 ) * 256.0f ), wy = (uint32_t)( ( fy - y0 ) * 256.0f );
+	int x = (int)x0, y = (int)y0;
+
+	uint32_t top = softLerp( softTexel( tex, x, y ), softTexel( tex, x + 1, y ), wx );
+	uint32_t bottom = softLerp( softTexel( tex, x, y + 1 ), softTexel( tex, x + 1, y + 1 ), wx );
+	return softLerp( top, bottom, wy );
+}
+
+// per channel product, 'tint' in 0..256
+inline uint32_t softModulate( uint32_t c, const uint32_t tint[4] ){
+	return ( ( ( c & 0xFF ) * tint[0] ) >> 8 ) | ( ( ( ( c >> 8 ) & 0xFF ) * tint[1] ) >> 8 << 8 ) |
+		   ( ( ( ( c >> 16 ) & 0xFF ) * tint[2] ) >> 8 << 16 ) | ( ( ( c >> 24 ) * tint[3] ) >> 8 << 24 );
+}
+
+// the pixels of one 4-wide span that passed the edge and depth tests
+void softShade( const soft_triangle_t &t, const soft_state_t &s, const uint32_t tint[4],
+				int x, int y, int mask, uint32_t *dst ){
+	float py = y + 0.5f;
+	float wRow = t.w[1] * py + t.w[2], uRow = t.u[1] * py + t.u[2], vRow = t.v[1] * py + t.v[2];
+
+	for( int lane = 0; lane < 4; lane++ ){
+		if( !( mask & ( 1 << lane ) ) ) continue;
+		float px = x + lane + 0.5f;
+		float w = 1.0f / ( t.w[0] * px + wRow );
+
+		uint32_t c = 0xFFFFFFFF;
+		if( s.texture ) c = softSample( *s.texture, ( t.u[0] * px + uRow ) * w, ( t.v[0] * px + vRow ) * w, s.filter );
+		c = softModulate( c, tint );
+
+		if( s.blend ) c = softLerp( dst[lane], c, ( c >> 24 ) + ( c >> 31 ) );	// 255 alpha is a full 256
+		dst[lane] = c;
+	}
+}
+
+inline __m128 softInside( __m128 e, bool topLeft ){
+	return topLeft ? _mm_cmpge_ps( e, _mm_setzero_ps() ) : _mm_cmpgt_ps( e, _mm_setzero_ps() );
+}
+
+void softRasterTile( unsigned int tile ){
+	const int tx = ( tile % gSoft.tilesX ) * SOFT_TILE_SIZE;
+	const int ty = ( tile / gSoft.tilesX ) * SOFT_TILE_SIZE;
+	const __m128 laneOffsets = _mm_set_ps( 3.5f, 2.5f, 1.5f, 0.5f );
+	const std::vector<uint32_t> &bin = gSoft.bins[tile];
+	int x, y;
+	unsigned int i;
+
+	if( gSoft.clearPending ){
+		for( y = ty; y < ty + (int)SOFT_TILE_SIZE; y++ ){
+			std::fill_n( &gSoft.color[y * gSoft.stride + tx], SOFT_TILE_SIZE, gSoft.clearColor );
+			std::fill_n( &gSoft.depth[y * gSoft.stride + tx], SOFT_TILE_SIZE, 1.0f );
+		}
+	}
+
+	for( unsigned int b = 0; b < bin.size(); b++ ){
+		const soft_triangle_t &t = gSoft.triangles[bin[b]];
+		const soft_state_t &s = gSoft.states[t.state];
+		uint32_t tint[4];
+		for( i = 0; i < 4; i++ )
+			tint[i] = (uint32_t)( glm::clamp( s.tint[i], 0.0f, 1.0f ) * 256.0f );
+
+		// spans start 4-aligned, the tile is whole multiples of 4 wide
+		int x0 = std::max( t.minX, tx ) & ~3;
+		int x1 = std::min( t.maxX, tx + (int)SOFT_TILE_SIZE - 1 );
+		int y0 = std::max( t.minY, ty );
+		int y1 = std::min( t.maxY, ty + (int)SOFT_TILE_SIZE - 1 );
+
+		__m128 edgeX[3], edgeStep[3];
+		for( i = 0; i < 3; i++ ){
+			edgeX[i] = _mm_set1_ps( t.edge[i][0] );
+			edgeStep[i] = _mm_set1_ps( t.edge[i][0] * 4.0f );
+		}
+		__m128 depthX = _mm_set1_ps( t.z[0] );
+		__m128 depthStep = _mm_set1_ps( t.z[0] * 4.0f );
+
+		for( y = y0; y <= y1; y++ ){
+			float py = y + 0.5f;
+			__m128 px = _mm_add_ps( _mm_set1_ps( (float)x0 ), laneOffsets );
+			__m128 e[3];
+			for( i = 0; i < 3; i++ )
+				e[i] = _mm_add_ps( _mm_mul_ps( edgeX[i], px ), _mm_set1_ps( t.edge[i][1] * py + t.edge[i][2] ) );
+			__m128 z = _mm_add_ps( _mm_mul_ps( depthX, px ), _mm_set1_ps( t.z[1] * py + t.z[2] ) );
+
+			uint32_t *colorRow = &gSoft.color[y * gSoft.stride];
+			float *depthRow = &gSoft.depth[y * gSoft.stride];
+
+			for( x = x0; x <= x1; x += 4 ){
+				__m128 inside = _mm_and_ps( _mm_and_ps( softInside( e[0], t.topLeft[0] ), softInside( e[1], t.topLeft[1] ) ),
+											softInside( e[2], t.topLeft[2] ) );
+				int mask = _mm_movemask_ps( inside );
+
+				if( mask ){
+					if( s.depthTest || s.depthWrite ){
+						__m128 depth = _mm_loadu_ps( depthRow + x );
+						if( s.depthTest ){
+							inside = _mm_and_ps( inside, _mm_cmplt_ps( z, depth ) );
+							mask = _mm_movemask_ps( inside );
+						}
+						if( mask && s.depthWrite )
+							_mm_storeu_ps( depthRow + x, _mm_or_ps( _mm_and_ps( inside, z ), _mm_andnot_ps( inside, depth ) ) );
+					}
+					if( mask ) softShade( t, s, tint, x, y, mask, colorRow + x );
+				}
+
+				for( i = 0; i < 3; i++ )
+					e[i] = _mm_add_ps( e[i], edgeStep[i] );
+				z = _mm_add_ps( z, depthStep );
+			}
+		}
+	}
+}
+
+/**
+-=-=-=-=-=-=- softFinish -=-=-=-=-=-=-
+One job per tile, then the frame's triangles are dropped
+**/
+void softFinish(){
+	CPU_ZONE( "softFinish" );
+	if( !gSoft.ready ) return;
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	parallelFor( gSoft.tilesX * gSoft.tilesY, 1, []( unsigned int begin, unsigned int end, unsigned int ){
+		for( unsigned int tile = begin; tile < end; tile++ )
+			softRasterTile( tile );
+	} );
+
+	for( unsigned int i = 0; i < gSoft.bins.size(); i++ )
+		gSoft.bins[i].clear();
+	gSoft.triangles.clear();
+	gSoft.states.clear();
+	gSoft.clearPending = false;
+
+	gSoft.stats.rasterMs = (float)( 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency() );
+	gSoft.lastStats = gSoft.stats;
+	memset( &gSoft.stats, 0, sizeof( gSoft.stats ) );
+}
+
+soft_framebuffer_t softFramebuffer(){
+	soft_framebuffer_t fb;
+	fb.pixels = gSoft.color.empty() ? NULL : &gSoft.color[0];
+	fb.width = gSoft.width;
+	fb.height = gSoft.height;
+	fb.pitch = gSoft.stride * sizeof( uint32_t );
+	return fb;
+}
+
+soft_raster_stats_t softRasterStats(){
+	return gSoft.lastStats;
+}
+
+void printSoftRasterStats(){
+	const soft_raster_stats_t &s = gSoft.lastStats;
+	printf( "SOFT RASTER: %u triangles, %u culled, %u clipped, %u tile entries, setup %.2f ms, raster %.2f ms\n",
+			s.triangles, s.culled, s.clipped, s.binned, s.setupMs, s.rasterMs );
+}
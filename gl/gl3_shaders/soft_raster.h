@@ -0,0 +1,80 @@
+#ifndef SOFT_RASTER_H
+#define SOFT_RASTER_H
+
+#include <SDL2/SDL.h>
+#include <glm/glm.hpp>
+#include <stdint.h>
+#include <vector>
+
+///////////////////////////////////
+/////// SOFT_RASTER HEADER ////////
+///////////////////////////////////
+
+// CPU rasterizer for machines without a GPU, covering what the demo scenes use: indexed
+// textured triangles, depth test, back face culling, alpha blending, nearest or bilinear
+// sampling with repeat wrapping. No lighting, a draw's texels are multiplied by its tint.
+//
+// softDrawIndexed() transforms, clips against the near plane, culls and sets up triangles
+// right away and bins them into SOFT_TILE_SIZE screen tiles. softFinish() then rasterizes
+// the tiles in parallel on the job threads - a tile belongs to one worker, so nothing is
+// locked, and its triangles are drawn in submission order, so blending comes out as on
+// the GPU. Edge functions and depth are evaluated four pixels at a time with SSE2.
+//
+// Needs initJobs() first. Textures must stay alive until the softFinish() after their draws.
+
+const unsigned int SOFT_TILE_SIZE = 64;			// pixels, a multiple of 4
+
+typedef enum {
+	SOFT_FILTER_NEAREST,
+	SOFT_FILTER_BILINEAR
+} soft_filter_t;
+
+typedef struct {
+	unsigned int width, height;
+	std::vector<uint32_t> texels;		// RGBA8, R in the low byte, top row first
+} soft_texture_t;
+
+typedef struct {
+	const soft_texture_t *texture;		// NULL draws the tint alone
+	glm::vec4 tint;
+	soft_filter_t filter;
+	bool depthTest;						// less than, against a depth cleared to 1
+	bool depthWrite;
+	bool cullBack;						// counter-clockwise is the front, as in GL
+	bool blend;							// src alpha, one minus src alpha
+} soft_state_t;
+
+typedef struct {
+	const uint32_t *pixels;				// RGBA8 like soft_texture_t
+	unsigned int width, height;
+	unsigned int pitch;					// bytes per row
+} soft_framebuffer_t;
+
+typedef struct {
+	unsigned int triangles;				// submitted since the last finish
+	unsigned int culled;				// back facing, degenerate or off screen
+	unsigned int clipped;				// cut by the near plane
+	unsigned int binned;				// triangle-in-tile entries
+	float setupMs;						// spent in softDrawIndexed
+	float rasterMs;						// spent in softFinish
+} soft_raster_stats_t;
+
+bool initSoftRaster( unsigned int width, unsigned int height );
+void closeSoftRaster();
+
+soft_state_t softDefaultState();		// opaque, depth tested, back faces culled, bilinear
+bool softLoadTexture( const char *filename, soft_texture_t *texture );	// relative to the executable
+
+void softClear( const glm::vec4 &color );	// color and depth, done by the next softFinish()
+
+// 'vertices' holds 'stride' floats per vertex, position xyz first, uv at 'uvOffset'
+void softDrawIndexed( const float *vertices, unsigned int stride, unsigned int uvOffset,
+					  const unsigned int *indices, unsigned int indexCount,
+					  const glm::mat4 &mvp, const soft_state_t &state );
+void softFinish();
+
+soft_framebuffer_t softFramebuffer();	// valid until the next softFinish()
+soft_raster_stats_t softRasterStats();	// of the last finished frame
+void printSoftRasterStats();
+
+#endif
@@ -0,0 +1,225 @@
+// these preprocessor instructions are needed by SDL2 and glew32 to compile successfully
+#define SDL_MAIN_HANDLED
+#define GLEW_STATIC
+
+#include "stream_ring.h"
+#include "gpu_memory.h"
+#include "cpu_profiler.h"
+
+//////////////////////////////////
+/////// STREAM_RING.CPP //////////
+//////////////////////////////////
+
+// bound only while the ring itself touches the buffer, so no other binding is disturbed
+const GLenum STREAM_TARGET = GL_COPY_WRITE_BUFFER;
+const size_t STREAM_PART_ALIGNMENT = 256;		// no GL alignment requirement is bigger
+
+struct stream_ring_t {
+	bool ready;
+	bool mapped;				// this frame's part is writable
+	GLuint buffer;
+	unsigned char *base;		// the persistent mapping of the whole ring
+	unsigned char *part;		// this frame's part, as mapped
+	unsigned int frame;			// which part
+	size_t cursor;				// into the part
+	GLsync fences[STREAM_RING_FRAMES];
+	size_t uniformAlignment;
+	stream_ring_stats_t stats;
+};
+
+stream_ring_t gRing;						// used while no renderer installed its own
+thread_local stream_ring_t *tRing = NULL;	// this thread's, from streamRingMakeCurrent()
+
+inline stream_ring_t &currentStreamRing(){
+	return tRing ? *tRing : gRing;
+}
+
+stream_ring_t *streamRingCreate(){
+	return new stream_ring_t();
+}
+
+void streamRingDestroy( stream_ring_t *ring ){
+	if( tRing == ring ) tRing = NULL;
+	delete ring;
+}
+
+void streamRingMakeCurrent( stream_ring_t *ring ){
+	tRing = ring;
+}
+
+bool initStreamRing( size_t frameBytes ){
+	stream_ring_t &ring = currentStreamRing();
+	GLint alignment = 0;
+	unsigned int i;
+
+	ring.ready = false;
+	ring.mapped = false;
+	ring.base = ring.part = NULL;
+	ring.frame = 0;
+	ring.cursor = 0;
+	for( i = 0; i < STREAM_RING_FRAMES; i++ )
+		ring.fences[i] = 0;
+
+	glGetIntegerv( GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment );
+	ring.uniformAlignment = alignment > 0 ? alignment : STREAM_PART_ALIGNMENT;
+
+	// parts start on an alignment boundary, so offsets aligned within a part are aligned in the buffer
+	frameBytes = ( frameBytes + STREAM_PART_ALIGNMENT - 1 ) / STREAM_PART_ALIGNMENT * STREAM_PART_ALIGNMENT;
+	size_t total = frameBytes * STREAM_RING_FRAMES;
+
+	ring.stats.persistent = false;
+	ring.stats.frameBytes = frameBytes;
+	ring.stats.used = ring.stats.peak = 0;
+	ring.stats.failed = 0;
+	ring.stats.waitMs = 0.0f;
+
+	glGenBuffers( 1, &ring.buffer );
+	glBindBuffer( STREAM_TARGET, ring.buffer );
+
+	if( GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage ){
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage( STREAM_TARGET, total, NULL, flags );
+		ring.base = (unsigned char*)glMapBufferRange( STREAM_TARGET, 0, total, flags );
+
+		// storage is immutable, a failed mapping needs a fresh buffer for the fallback
+		if( ring.base ) ring.stats.persistent = true;
+		else {
+			printf( "WARNING: Persistent mapping of the stream ring failed, mapping per frame...\n" );
+			glDeleteBuffers( 1, &ring.buffer );
+			glGenBuffers( 1, &ring.buffer );
+			glBindBuffer( STREAM_TARGET, ring.buffer );
+		}
+	}
+	if( !ring.stats.persistent )
+		glBufferData( STREAM_TARGET, total, NULL, GL_STREAM_DRAW );
+
+	glBindBuffer( STREAM_TARGET, 0 );
+	gpuMemoryTrack( GPU_MEM_BUFFER, ring.buffer, "streaming", "ring", total );
+
+	ring.ready = true;
+	printf( "SUCCESS: Stream ring of %u x %u KB created, %s...\n", STREAM_RING_FRAMES, (unsigned int)( frameBytes / 1024 ),
+			ring.stats.persistent ? "persistently mapped" : "mapped per frame" );
+	return true;
+}
+
+void closeStreamRing(){
+	stream_ring_t &ring = currentStreamRing();
+	if( !ring.ready ) return;
+
+	for( unsigned int i = 0; i < STREAM_RING_FRAMES; i++ )
+		if( ring.fences[i] ) glDeleteSync( ring.fences[i] );
+
+	if( ring.stats.persistent || ring.mapped ){
+		glBindBuffer( STREAM_TARGET, ring.buffer );
+		glUnmapBuffer( STREAM_TARGET );
+		glBindBuffer( STREAM_TARGET, 0 );
+	}
+	gpuMemoryUntrack( GPU_MEM_BUFFER, ring.buffer );
+	glDeleteBuffers( 1, &ring.buffer );
+	ring.ready = false;
+}
+
+void streamBeginFrame(){
+	stream_ring_t &ring = currentStreamRing();
+	CPU_ZONE( "streamBeginFrame" );
+	if( !ring.ready ) return;
+
+	ring.frame = ( ring.frame + 1 ) % STREAM_RING_FRAMES;
+	ring.cursor = 0;
+	ring.stats.waitMs = 0.0f;
+
+	// the part was last used STREAM_RING_FRAMES frames ago, usually long finished
+	GLsync &fence = ring.fences[ring.frame];
+	if( fence ){
+		Uint64 start = SDL_GetPerformanceCounter();
+		GLenum result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		while( result == GL_TIMEOUT_EXPIRED )
+			result = glClientWaitSync( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000 );	// 1 ms at a time
+		if( result == GL_WAIT_FAILED )
+			printf( "ERROR: Waiting for a stream ring fence failed!\n" );
+		else if( result == GL_CONDITION_SATISFIED )
+			ring.stats.waitMs = (float)( 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency() );
+
+		glDeleteSync( fence );
+		fence = 0;
+	}
+
+	size_t offset = ring.frame * ring.stats.frameBytes;
+	if( ring.stats.persistent )
+		ring.part = ring.base + offset;
+	else {
+		// the fence already guarantees the GPU is done here, don't let the driver check again
+		glBindBuffer( STREAM_TARGET, ring.buffer );
+		ring.part = (unsigned char*)glMapBufferRange( STREAM_TARGET, offset, ring.stats.frameBytes,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT );
+		glBindBuffer( STREAM_TARGET, 0 );
+		if( !ring.part ) printf( "ERROR: Mapping the stream ring failed!\n" );
+	}
+	ring.mapped = ring.part != NULL;
+}
+
+stream_alloc_t streamAlloc( size_t bytes, size_t alignment ){
+	stream_ring_t &ring = currentStreamRing();
+	stream_alloc_t alloc;
+	alloc.buffer = ring.buffer;
+	alloc.size = bytes;
+	alloc.offset = 0;
+	alloc.data = NULL;
+
+	if( !ring.mapped ){
+		ring.stats.failed++;
+		return alloc;
+	}
+
+	size_t start = ( ring.cursor + alignment - 1 ) / alignment * alignment;
+	if( start + bytes > ring.stats.frameBytes ){
+		ring.stats.failed++;
+		return alloc;
+	}
+
+	ring.cursor = start + bytes;
+	alloc.offset = ring.frame * ring.stats.frameBytes + start;
+	alloc.data = ring.part + start;
+	return alloc;
+}
+
+stream_alloc_t streamAllocUniform( size_t bytes ){
+	return streamAlloc( bytes, currentStreamRing().uniformAlignment );
+}
+
+void streamFlush(){
+	stream_ring_t &ring = currentStreamRing();
+	if( !ring.mapped ) return;
+
+	// coherent writes are visible to every command issued after them
+	if( !ring.stats.persistent ){
+		glBindBuffer( STREAM_TARGET, ring.buffer );
+		if( ring.cursor ) glFlushMappedBufferRange( STREAM_TARGET, 0, ring.cursor );
+		glUnmapBuffer( STREAM_TARGET );
+		glBindBuffer( STREAM_TARGET, 0 );
+	}
+	ring.mapped = false;
+	ring.part = NULL;
+
+	ring.stats.used = ring.cursor;
+	if( ring.cursor > ring.stats.peak ) ring.stats.peak = ring.cursor;
+}
+
+void streamEndFrame(){
+	stream_ring_t &ring = currentStreamRing();
+	if( !ring.ready ) return;
+	if( ring.mapped ) streamFlush();
+	ring.fences[ring.frame] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+stream_ring_stats_t streamRingStats(){
+	return currentStreamRing().stats;
+}
+
+void printStreamRingStats(){
+	stream_ring_t &ring = currentStreamRing();
+	const stream_ring_stats_t &s = ring.stats;
+	printf( "STREAM RING: %u / %u bytes used, peak %u, %u failed allocations, last fence wait %.3f ms (%s)\n",
+			(unsigned int)s.used, (unsigned int)s.frameBytes, (unsigned int)s.peak, s.failed, s.waitMs,
+			s.persistent ? "persistent" : "mapped per frame" );
+}
@@ -0,0 +1,65 @@
+#ifndef STREAM_RING_H
+#define STREAM_RING_H
+
+#include "gl_utils.h"
+
+///////////////////////////////////
+/////// STREAM_RING HEADER ////////
+///////////////////////////////////
+
+// One buffer for everything that changes every frame: vertices, instance data, uniform
+// blocks. It is split in STREAM_RING_FRAMES parts, each frame suballocates linearly from
+// its own part and fences it when its draws are submitted. A part is only written again
+// once that fence has passed, so CPU writes never wait on the driver and never need a copy.
+//
+// With GL 4.4 / ARB_buffer_storage the whole ring is mapped once, persistent and coherent.
+// On plain 3.3 each frame's part is mapped unsynchronized instead (the fences make that
+// safe) and unmapped by streamFlush(), which has to come before any draw reading it.
+//
+// The ring belongs to the thread owning the GL context, allocations are not locked.
+//
+//   streamBeginFrame();
+//   stream_alloc_t a = streamAlloc( bytes );
+//   if( a.data ) memcpy( a.data, ... );		// NULL when this frame's part is full
+//   streamFlush();
+//   ... bind a.buffer at a.offset, draw ...
+//   streamEndFrame();
+
+const unsigned int STREAM_RING_FRAMES = 3;		// frames the CPU may run ahead of the GPU
+
+typedef struct {
+	GLuint buffer;
+	GLintptr offset;		// bytes from the start of the buffer
+	GLsizeiptr size;
+	void *data;				// write-only
+} stream_alloc_t;
+
+typedef struct {
+	bool persistent;		// else mapped per frame
+	size_t frameBytes;		// per part
+	size_t used;			// by the last flushed frame
+	size_t peak;			// most any frame used
+	unsigned int failed;	// allocations that didn't fit, since init
+	float waitMs;			// last wait for a fence, 0 when the GPU was ahead
+} stream_ring_stats_t;
+
+// A ring per context: streamRingMakeCurrent() picks the one this thread's calls go to,
+// until then (or after NULL) they use a default ring.
+struct stream_ring_t;
+stream_ring_t *streamRingCreate();
+void streamRingDestroy( stream_ring_t *ring );		// after closeStreamRing()
+void streamRingMakeCurrent( stream_ring_t *ring );
+
+bool initStreamRing( size_t frameBytes );
+void closeStreamRing();
+
+void streamBeginFrame();		// waits until the GPU is done with this frame's part
+stream_alloc_t streamAlloc( size_t bytes, size_t alignment=16 );
+stream_alloc_t streamAllocUniform( size_t bytes );	// aligned for glBindBufferRange( GL_UNIFORM_BUFFER )
+void streamFlush();				// before the draws using this frame's allocations
+void streamEndFrame();			// after the last of them
+
+stream_ring_stats_t streamRingStats();
+void printStreamRingStats();
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <SDL2/SDL.h>
+
+///////////////////////////////////
+////// TRIPLE_BUFFER HEADER ///////
+///////////////////////////////////
+
+// Hands whole values from one writer thread to one reader thread without either waiting.
+// The writer fills back() and publish()es it, the reader acquire()s the newest published
+// value into front(). Each side owns one slot, the third is swapped through an atomic
+// index, so a slow reader only ever skips values and a slow writer only repeats them.
+
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() : mBack( 0 ), mFront( 1 ) {
+		SDL_AtomicSet( &mMiddle, 2 );
+	}
+	
+	// writer side
+	T &back() { return mSlots[mBack]; }
+	void publish() {
+		mBack = SDL_AtomicSet( &mMiddle, mBack | FRESH ) & INDEX;
+	}
+	
+	// reader side, returns false (and keeps the old front) if nothing new was published
+	bool acquire() {
+		if( !( SDL_AtomicGet( &mMiddle ) & FRESH ) ) return false;
+		mFront = SDL_AtomicSet( &mMiddle, mFront ) & INDEX;
+		return true;
+	}
+	const T &front() const { return mSlots[mFront]; }
+
+private:
+	enum { INDEX = 3, FRESH = 4 };
+	
+	T mSlots[3];
+	int mBack;				// writer's slot
+	int mFront;				// reader's slot
+	SDL_atomic_t mMiddle;	// slot in between, plus FRESH when the writer left a new value there
+};
+
+#endif
@@ -2,8 +2,14 @@
 
 #include <iostream>
 #include <string>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 #include "SDL2\SDL.h"
 #include "SDL2\SDL_image.h"
+#include "sprite_batch.h"
+#include "texture_atlas.h"
+#include "compositor.h"
 
 const int SCREEN_WIDTH = 800;
 const int SCREEN_HEIGHT = 600;
@@ -11,6 +17,15 @@ const int WINDOW_LEFT = 250;
 const int WINDOW_TOP = 100;
 const char *WINDOW_TITLE = "Frank's SDL2 Demo";
 
+const int BENCH_SPRITES = 100000;
+const int BENCH_FRAMES = 30;
+const int BENCH_CELL = 32;			// sprites are cut from hello.png in cells this big
+const int BENCH_LAYERS = 4;
+
+const int PANEL_COLUMNS = 4;		// the static dashboard behind the bouncing images
+const int PANEL_ROWS = 3;
+const int PANEL_MARGIN = 10;
+
 
 /**
 -=-=-=-=-=-=-=- LogError -=-=-=-=-=-
@@ -48,6 +63,106 @@ void renderTexture( SDL_Texture *tex, SDL_Renderer *ren, int x, int y ){
 	renderTexture( tex, ren, x, y, w, h );	
 }
 
+/**
+-=-=-=-=-=- runSpriteBenchmark -=-=-=-=-=-
+Draws the same BENCH_SPRITES rotated, tinted sprites first one SDL_RenderCopyEx at a
+time, then through a SpriteBatch, and prints the time per frame of each
+**/
+typedef struct {
+	SDL_Rect src;
+	SDL_FRect dst;
+	float angle;
+	SDL_Color tint;
+	int z;
+} bench_sprite_t;
+
+double benchmarkFrames( SDL_Renderer *ren, SDL_Texture *tex, const std::vector<bench_sprite_t> &sprites, SpriteBatch *batch ){
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	for( int frame = 0; frame < BENCH_FRAMES; frame++ ){
+		SDL_RenderClear( ren );
+		if( batch ){
+			batch->begin();
+			for( size_t i = 0; i < sprites.size(); i++ ){
+				const bench_sprite_t &s = sprites[i];
+				batch->draw( tex, &s.src, s.dst, s.angle, s.tint, s.z );
+			}
+			batch->end();
+		}
+		else {
+			for( size_t i = 0; i < sprites.size(); i++ ){
+				const bench_sprite_t &s = sprites[i];
+				SDL_Rect dst = { (int)s.dst.x, (int)s.dst.y, (int)s.dst.w, (int)s.dst.h };
+				SDL_SetTextureColorMod( tex, s.tint.r, s.tint.g, s.tint.b );
+				SDL_SetTextureAlphaMod( tex, s.tint.a );
+				SDL_RenderCopyEx( ren, tex, &s.src, &dst, s.angle, NULL, SDL_FLIP_NONE );
+			}
+			SDL_SetTextureColorMod( tex, 255, 255, 255 );
+			SDL_SetTextureAlphaMod( tex, 255 );
+		}
+		SDL_RenderPresent( ren );
+	}
+
+	return 1000.0 * ( SDL_GetPerformanceCounter() - start ) / SDL_GetPerformanceFrequency() / BENCH_FRAMES;
+}
+
+void runSpriteBenchmark( SDL_Renderer *ren, const atlas_region_t &image ){
+	SDL_Texture *tex = image.page;
+	int cellsX = image.rect.w / BENCH_CELL, cellsY = image.rect.h / BENCH_CELL;
+	if( cellsX < 1 ) cellsX = 1;
+	if( cellsY < 1 ) cellsY = 1;
+
+	std::vector<bench_sprite_t> sprites( BENCH_SPRITES );
+	srand( 1 );
+	for( int i = 0; i < BENCH_SPRITES; i++ ){
+		bench_sprite_t &s = sprites[i];
+		s.src.x = image.rect.x + ( rand() % cellsX ) * BENCH_CELL;
+		s.src.y = image.rect.y + ( rand() % cellsY ) * BENCH_CELL;
+		s.src.w = s.src.h = BENCH_CELL;
+		s.dst.x = (float)( rand() % ( SCREEN_WIDTH - BENCH_CELL ) );
+		s.dst.y = (float)( rand() % ( SCREEN_HEIGHT - BENCH_CELL ) );
+		s.dst.w = s.dst.h = (float)BENCH_CELL;
+		s.angle = (float)( rand() % 360 );
+		s.tint.r = 128 + rand() % 128;
+		s.tint.g = 128 + rand() % 128;
+		s.tint.b = 128 + rand() % 128;
+		s.tint.a = 255;
+		s.z = rand() % BENCH_LAYERS;
+	}
+
+	// the naive path draws in submission order, so it has no layers to honour
+	std::cout << "Benchmarking " << BENCH_SPRITES << " sprites over " << BENCH_FRAMES << " frames..." << std::endl;
+	double naiveMs = benchmarkFrames( ren, tex, sprites, NULL );
+	std::cout << "  SDL_RenderCopyEx per sprite: " << naiveMs << " ms/frame, " << BENCH_SPRITES << " calls" << std::endl;
+
+	SpriteBatch batch( ren );
+	double batchMs = benchmarkFrames( ren, tex, sprites, &batch );
+	sprite_batch_stats_t stats = batch.stats();
+	std::cout << "  SpriteBatch: " << batchMs << " ms/frame, " << stats.calls << " calls for "
+			  << stats.sprites << " sprites in " << BENCH_LAYERS << " layers" << std::endl;
+	std::cout << "  speedup: " << naiveMs / batchMs << "x" << std::endl;
+}
+
+/**
+-=-=-=-=-=- drawDashboard -=-=-=-=-=-
+Static panels, drawn once into the compositor's cache and then only copied
+**/
+void drawDashboard( SDL_Renderer *ren ){
+	int panelW = ( SCREEN_WIDTH - PANEL_MARGIN ) / PANEL_COLUMNS - PANEL_MARGIN;
+	int panelH = ( SCREEN_HEIGHT - PANEL_MARGIN ) / PANEL_ROWS - PANEL_MARGIN;
+	
+	for( int row = 0; row < PANEL_ROWS; row++ ){
+		for( int col = 0; col < PANEL_COLUMNS; col++ ){
+			SDL_Rect panel = { PANEL_MARGIN + col * ( panelW + PANEL_MARGIN ), PANEL_MARGIN + row * ( panelH + PANEL_MARGIN ), panelW, panelH };
+			SDL_Rect header = { panel.x, panel.y, panel.w, 16 };
+			SDL_SetRenderDrawColor( ren, 30, 34, 44, 255 );
+			SDL_RenderFillRect( ren, &panel );
+			SDL_SetRenderDrawColor( ren, 60, 90, 140, 255 );
+			SDL_RenderFillRect( ren, &header );
+		}
+	}
+}
+
 /**
 -=-=-=-=-=- MAIN -=-=-=-=-=-=-=-
 **/
@@ -57,6 +172,10 @@ int main(int argc, char** argv) {
 	
 	int blitX=15, blitY= 15, xdir=1, ydir=1;
 	
+	// --bench draws sprites as fast as possible instead of running the demo
+	bool bench = false;
+	for( int i = 1; i < argc; i++ )
+		if( strcmp( argv[i], "--bench" ) == 0 ) bench = true;
 	
 	// initialize SDL
 	if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_AUDIO) != 0) {
@@ -80,7 +199,8 @@ int main(int argc, char** argv) {
 	} logVerbose( std::cout, "Window created." );
 	
 	// create a renderer
-	SDL_Renderer *ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); // second param sets preferred device, here we use -1 to let SDL choose the best one for us
+	Uint32 renFlags = SDL_RENDERER_ACCELERATED | SDL_RENDERER_TARGETTEXTURE | ( bench ? 0 : SDL_RENDERER_PRESENTVSYNC );	// vsync would cap the benchmark
+	SDL_Renderer *ren = SDL_CreateRenderer(win, -1, renFlags); // second param sets preferred device, here we use -1 to let SDL choose the best one for us
 	if (ren == nullptr){
 		SDL_DestroyWindow(win);
 		std::cout << "SDL_CreateRenderer Error: " << SDL_GetError() << std::endl;
@@ -110,9 +230,25 @@ int main(int argc, char** argv) {
 //		return 1;
 //	}
 
-	// Use SDL_Image to directly load an image into a texture
-	std::string pngPath = SDL_GetBasePath() + (std::string)"hello.png";
-	SDL_Texture *tex = loadTexture( pngPath, ren );
+	// Use SDL_Image to load both images into one atlas, so the batch draws them with one call
+	std::string basePath = SDL_GetBasePath();
+	TextureAtlas atlas( ren );
+	atlas_region_t png = atlas.add( basePath + "hello.png" );
+	atlas_region_t bmp = atlas.add( basePath + "hello.bmp" );
+	if( png.page == NULL || bmp.page == NULL ){
+		atlas.clear();
+		SDL_DestroyRenderer(ren);
+		SDL_DestroyWindow(win);
+		IMG_Quit();
+		SDL_Quit();
+		return 1;
+	} std::cout << "Atlas built: " << atlas.pages() << " page(s), " << (int)( atlas.occupancy() * 100.0f ) << "% used" << std::endl;
+	SpriteBatch batch( ren );
+	
+	if( bench ){
+		runSpriteBenchmark( ren, png );
+		quit = true;
+	}
 	
 	
 //	//A sleepy rendering loop, wait for 3 seconds and render and present the screen each time
@@ -128,29 +264,67 @@ int main(int argc, char** argv) {
 //		SDL_Delay(1000);
 //	}
 
+	// the dashboard is cached, the images are drawn again wherever they moved
+	Compositor compositor( ren, SCREEN_WIDTH, SCREEN_HEIGHT );
+	compositor.addLayer( drawDashboard, true );
+	compositor.addLayer( [&]( SDL_Renderer * ){
+		batch.begin();
+		SDL_FRect mirror = { (float)( SCREEN_WIDTH - 400 - blitX ), (float)blitY, 400.0f, 400.0f };
+		batch.draw( bmp.page, &bmp.rect, mirror, 0.0f, SPRITE_WHITE, 0 );
+		SDL_FRect bounce = { (float)blitX, (float)blitY, 400.0f, 400.0f };
+		batch.draw( png.page, &png.rect, bounce, 0.0f, SPRITE_WHITE, 1 );
+		batch.end();
+	}, false );
+	SDL_Rect screen = { 0, 0, SCREEN_WIDTH, SCREEN_HEIGHT };
+	bool paused = false;	// space stops the images, the loop then sleeps until the next event
+
 	// render/event loop
 	logVerbose( std::cout, "Entering main loop..." );
 	while( !quit ){
-		while( SDL_PollEvent( &e )){
+		// with nothing moving and nothing to redraw, block instead of spinning
+		bool wait = paused && !compositor.dirty();
+		while( wait ? SDL_WaitEvent( &e ) : SDL_PollEvent( &e ) ){
+			wait = false;
 			if( e.type == SDL_QUIT )			quit = true;
-			if( e.type == SDL_KEYDOWN )			quit = true;
+			if( e.type == SDL_KEYDOWN ){
+				if( e.key.keysym.sym == SDLK_SPACE ) paused = !paused;
+				else quit = true;
+			}
 			if( e.type == SDL_MOUSEBUTTONDOWN )	quit = true;
+			if( e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED ) compositor.invalidate( screen );
+			if( e.type == SDL_RENDER_TARGETS_RESET )	compositor.invalidateAll();
 		}
 		
-		// update bouncing image
-		blitX += xdir;
-		blitY += ydir;
-		if( blitX < 0 || (blitX + 400 > SCREEN_WIDTH) ) xdir *= -1;
-		if( blitY < 0 || (blitY + 400 > SCREEN_HEIGHT) ) ydir *= -1;
+		// update bouncing image, both where it was and where it is now need redrawing
+		if( !paused ){
+			SDL_Rect before = { blitX, blitY, 400, 400 };
+			SDL_Rect mirrorBefore = { SCREEN_WIDTH - 400 - blitX, blitY, 400, 400 };
+			blitX += xdir;
+			blitY += ydir;
+			if( blitX < 0 || (blitX + 400 > SCREEN_WIDTH) ) xdir *= -1;
+			if( blitY < 0 || (blitY + 400 > SCREEN_HEIGHT) ) ydir *= -1;
+			
+			SDL_Rect after = { blitX, blitY, 400, 400 };
+			SDL_Rect mirrorAfter = { SCREEN_WIDTH - 400 - blitX, blitY, 400, 400 };
+			compositor.invalidate( before );
+			compositor.invalidate( after );
+			compositor.invalidate( mirrorBefore );
+			compositor.invalidate( mirrorAfter );
+		}
 		
-		// render
-		SDL_RenderClear( ren );
-		renderTexture( tex, ren, blitX, blitY );
-		SDL_RenderPresent( ren );
+		// render, only when something changed
+		compositor.compose();
 	} logVerbose( std::cout, "Loop ended... beginning clean-up..." );
 	
+	compositor_stats_t cstats = compositor.stats();
+	std::cout << "Compositor: " << cstats.composed << " frames composed, " << cstats.skipped << " idle, "
+			  << ( cstats.composed ? cstats.pixels / cstats.composed : 0 ) << " pixels per frame" << std::endl;
+	
 	// clean up and end	
-	SDL_DestroyTexture(tex);
+	compositor.clear();
+	batch.forgetTexture(png.page);
+	batch.forgetTexture(bmp.page);
+	atlas.clear();
 	SDL_DestroyRenderer(ren);
 	SDL_DestroyWindow(win);
 	IMG_Quit();
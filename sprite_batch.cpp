@@ -0,0 +1,172 @@
+#define SDL_MAIN_HANDLED
+
+#include <algorithm>
+#include <cmath>
+#include "sprite_batch.h"
+
+#define SPRITE_GEOMETRY SDL_VERSION_ATLEAST( 2, 0, 18 )
+
+const float SPRITE_DEG_TO_RAD = 3.14159265f / 180.0f;
+
+SpriteBatch::SpriteBatch( SDL_Renderer *ren ){
+	mRenderer = ren;
+	mDrawing = false;
+	mStats.sprites = mStats.calls = mStats.textures = 0;
+}
+
+/**
+-=-=-=-=-=- textureSize -=-=-=-=-=-
+SDL_QueryTexture once per texture, not once per sprite
+**/
+SDL_Point SpriteBatch::textureSize( SDL_Texture *tex ){
+	std::unordered_map<SDL_Texture*, SDL_Point>::iterator it = mSizes.find( tex );
+	if( it != mSizes.end() ) return it->second;
+
+	SDL_Point size = { 0, 0 };
+	SDL_QueryTexture( tex, NULL, NULL, &size.x, &size.y );
+	mSizes[tex] = size;
+	return size;
+}
+
+void SpriteBatch::forgetTexture( SDL_Texture *tex ){
+	mSizes.erase( tex );
+}
+
+void SpriteBatch::begin(){
+	mSprites.clear();
+	mTextureSlots.clear();
+	mDrawing = true;
+}
+
+void SpriteBatch::draw( SDL_Texture *tex, float x, float y, int z ){
+	SDL_Point size = textureSize( tex );
+	SDL_FRect dst = { x, y, (float)size.x, (float)size.y };
+	draw( tex, NULL, dst, 0.0f, SPRITE_WHITE, z );
+}
+
+void SpriteBatch::draw( SDL_Texture *tex, const SDL_Rect *src, const SDL_FRect &dst, float angle, SDL_Color tint, int z ){
+	if( !mDrawing || tex == NULL ) return;
+
+	Sprite s;
+	s.tex = tex;
+	s.dst = dst;
+	s.angle = angle;
+	s.tint = tint;
+
+	if( src ){
+		SDL_Point size = textureSize( tex );
+		if( size.x == 0 || size.y == 0 ) return;
+		s.uv.x = (float)src->x / size.x;
+		s.uv.y = (float)src->y / size.y;
+		s.uv.w = (float)src->w / size.x;
+		s.uv.h = (float)src->h / size.y;
+	}
+	else {
+		s.uv.x = s.uv.y = 0.0f;
+		s.uv.w = s.uv.h = 1.0f;
+	}
+
+	// key: layer, then texture, then submission order - unique, so a plain sort is stable
+	std::unordered_map<SDL_Texture*, uint16_t>::iterator it = mTextureSlots.find( tex );
+	uint16_t slot;
+	if( it == mTextureSlots.end() ){
+		slot = (uint16_t)mTextureSlots.size();
+		mTextureSlots[tex] = slot;
+	}
+	else slot = it->second;
+
+	int layer = std::min( std::max( z, -32768 ), 32767 ) + 32768;
+	mKeys.resize( mSprites.size() + 1 );
+	mKeys[mSprites.size()] = ( (uint64_t)layer << 48 ) | ( (uint64_t)slot << 32 ) | (uint64_t)mSprites.size();
+	mSprites.push_back( s );
+}
+
+/**
+-=-=-=-=-=-=-=- end -=-=-=-=-=-=-=-
+Sort, build every quad, then one call per run of the same texture
+**/
+void SpriteBatch::end(){
+	unsigned int count = mSprites.size();
+	unsigned int i, run;
+
+	mDrawing = false;
+	mStats.sprites = count;
+	mStats.calls = 0;
+	mStats.textures = mTextureSlots.size();
+	if( count == 0 ) return;
+
+	std::sort( mKeys.begin(), mKeys.begin() + count );
+
+#if SPRITE_GEOMETRY
+	mVertices.resize( count * 4 );
+
+	// the same two triangles for every quad, indices restart with each run's vertices
+	if( mIndices.size() < count * 6 ){
+		unsigned int first = mIndices.size() / 6;
+		mIndices.resize( count * 6 );
+		for( i = first; i < count; i++ ){
+			int *q = &mIndices[i * 6];
+			int v = i * 4;
+			q[0] = v; q[1] = v + 1; q[2] = v + 2;
+			q[3] = v; q[4] = v + 2; q[5] = v + 3;
+		}
+	}
+
+	for( i = 0; i < count; i++ ){
+		const Sprite &s = mSprites[mKeys[i] & 0xFFFFFFFF];
+		SDL_Vertex *v = &mVertices[i * 4];
+		float hw = s.dst.w * 0.5f, hh = s.dst.h * 0.5f;
+		float cx = s.dst.x + hw, cy = s.dst.y + hh;
+		float c = 1.0f, sn = 0.0f;
+		if( s.angle != 0.0f ){
+			c = cosf( s.angle * SPRITE_DEG_TO_RAD );
+			sn = sinf( s.angle * SPRITE_DEG_TO_RAD );
+		}
+
+		// corners clockwise from the top left, y points down so a positive angle turns clockwise
+		const float cornerX[4] = { -hw, hw, hw, -hw };
+		const float cornerY[4] = { -hh, -hh, hh, hh };
+		const float cornerU[4] = { s.uv.x, s.uv.x + s.uv.w, s.uv.x + s.uv.w, s.uv.x };
+		const float cornerV[4] = { s.uv.y, s.uv.y, s.uv.y + s.uv.h, s.uv.y + s.uv.h };
+		for( int k = 0; k < 4; k++ ){
+			v[k].position.x = cx + cornerX[k] * c - cornerY[k] * sn;
+			v[k].position.y = cy + cornerX[k] * sn + cornerY[k] * c;
+			v[k].color = s.tint;
+			v[k].tex_coord.x = cornerU[k];
+			v[k].tex_coord.y = cornerV[k];
+		}
+	}
+#endif
+
+	for( i = 0; i < count; i = run ){
+		SDL_Texture *tex = mSprites[mKeys[i] & 0xFFFFFFFF].tex;
+		for( run = i + 1; run < count && mSprites[mKeys[run] & 0xFFFFFFFF].tex == tex; run++ );
+		flush( i, run - i );
+	}
+}
+
+void SpriteBatch::flush( unsigned int first, unsigned int count ){
+	SDL_Texture *tex = mSprites[mKeys[first] & 0xFFFFFFFF].tex;
+
+#if SPRITE_GEOMETRY
+	SDL_RenderGeometry( mRenderer, tex, &mVertices[first * 4], count * 4, &mIndices[0], count * 6 );
+	mStats.calls++;
+#else
+	for( unsigned int i = first; i < first + count; i++ ){
+		const Sprite &s = mSprites[mKeys[i] & 0xFFFFFFFF];
+		SDL_Point size = textureSize( tex );
+		SDL_Rect src = { (int)( s.uv.x * size.x + 0.5f ), (int)( s.uv.y * size.y + 0.5f ), (int)( s.uv.w * size.x + 0.5f ), (int)( s.uv.h * size.y + 0.5f ) };
+		SDL_Rect dst = { (int)floorf( s.dst.x + 0.5f ), (int)floorf( s.dst.y + 0.5f ), (int)( s.dst.w + 0.5f ), (int)( s.dst.h + 0.5f ) };
+		SDL_SetTextureColorMod( tex, s.tint.r, s.tint.g, s.tint.b );
+		SDL_SetTextureAlphaMod( tex, s.tint.a );
+		SDL_RenderCopyEx( mRenderer, tex, &src, &dst, s.angle, NULL, SDL_FLIP_NONE );
+		mStats.calls++;
+	}
+	SDL_SetTextureColorMod( tex, 255, 255, 255 );
+	SDL_SetTextureAlphaMod( tex, 255 );
+#endif
+}
+
+sprite_batch_stats_t SpriteBatch::stats() const {
+	return mStats;
+}
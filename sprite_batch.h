@@ -0,0 +1,76 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include "SDL2\SDL.h"
+
+/**
+-=-=-=-=-=- SpriteBatch -=-=-=-=-=-
+Collects a frame's sprites and draws them with as few calls as possible. Between begin()
+and end() every draw() only records the sprite. end() sorts them by layer (z, lowest
+first), then by texture inside a layer, and turns each run of one texture into a single
+SDL_RenderGeometry call. Sprites cut from the same atlas texture therefore cost one call
+however many there are.
+
+Inside one layer sprites of different textures may be reordered, sprites of the same
+texture keep the order they were drawn in. Give overlapping sprites different z when
+their order matters.
+
+Texture sizes are looked up once and cached, call forgetTexture() before destroying one.
+SDL older than 2.0.18 has no SDL_RenderGeometry, there every sprite is its own
+SDL_RenderCopyEx.
+**/
+
+const SDL_Color SPRITE_WHITE = { 255, 255, 255, 255 };
+
+typedef struct {
+	unsigned int sprites;		// drawn by the last end()
+	unsigned int calls;			// render calls they took
+	unsigned int textures;		// distinct textures among them
+} sprite_batch_stats_t;
+
+class SpriteBatch {
+public:
+	SpriteBatch( SDL_Renderer *ren );
+
+	void begin();
+
+	// the whole texture at its own size, top left corner at x, y
+	void draw( SDL_Texture *tex, float x, float y, int z=0 );
+
+	// src (NULL for the whole texture) into dst, turned 'angle' degrees clockwise around
+	// dst's center and multiplied by tint
+	void draw( SDL_Texture *tex, const SDL_Rect *src, const SDL_FRect &dst, float angle=0.0f,
+			   SDL_Color tint=SPRITE_WHITE, int z=0 );
+
+	void end();
+
+	void forgetTexture( SDL_Texture *tex );
+	sprite_batch_stats_t stats() const;
+
+private:
+	struct Sprite {
+		SDL_Texture *tex;
+		SDL_FRect uv;			// 0..1 across the texture
+		SDL_FRect dst;
+		float angle;
+		SDL_Color tint;
+	};
+
+	SDL_Point textureSize( SDL_Texture *tex );
+	void flush( unsigned int first, unsigned int count );
+
+	SDL_Renderer *mRenderer;
+	std::unordered_map<SDL_Texture*, SDL_Point> mSizes;
+	std::unordered_map<SDL_Texture*, uint16_t> mTextureSlots;	// this batch's textures, for the sort key
+	std::vector<Sprite> mSprites;
+	std::vector<uint64_t> mKeys;			// z | texture slot | sprite index
+	std::vector<SDL_Vertex> mVertices;
+	std::vector<int> mIndices;
+	sprite_batch_stats_t mStats;
+	bool mDrawing;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#define SDL_MAIN_HANDLED
+
+#include <iostream>
+#include <cstring>
+#include "SDL2\SDL_image.h"
+#include "texture_atlas.h"
+
+/**
+-=-=-=-=-=- SkylinePacker -=-=-=-=-=-
+**/
+SkylinePacker::SkylinePacker( int width, int height ){
+	reset( width, height );
+}
+
+void SkylinePacker::reset( int width, int height ){
+	Node floor = { 0, 0, width };
+	mWidth = width;
+	mHeight = height;
+	mUsed = 0;
+	mSkyline.clear();
+	mSkyline.push_back( floor );
+}
+
+int SkylinePacker::fit( unsigned int node, int w, int h ) const {
+	int x = mSkyline[node].x;
+	int y = mSkyline[node].y;
+	int left = w;
+
+	if( x + w > mWidth ) return -1;
+
+	// the rectangle rests on the highest node it spans
+	for( unsigned int i = node; left > 0; i++ ){
+		if( mSkyline[i].y > y ) y = mSkyline[i].y;
+		if( y + h > mHeight ) return -1;
+		left -= mSkyline[i].width;
+	}
+	return y;
+}
+
+bool SkylinePacker::insert( int w, int h, SDL_Rect *out ){
+	int bestBottom = mHeight + 1, bestWidth = mWidth + 1;
+	int best = -1, bestY = 0;
+	unsigned int i;
+
+	if( w <= 0 || h <= 0 ) return false;
+
+	// lowest bottom edge wins, the narrower node breaks ties so wide gaps stay open
+	for( i = 0; i < mSkyline.size(); i++ ){
+		int y = fit( i, w, h );
+		if( y < 0 ) continue;
+		if( y + h < bestBottom || ( y + h == bestBottom && mSkyline[i].width < bestWidth ) ){
+			best = i;
+			bestY = y;
+			bestBottom = y + h;
+			bestWidth = mSkyline[i].width;
+		}
+	}
+	if( best < 0 ) return false;
+
+	Node top = { mSkyline[best].x, bestY + h, w };
+	mSkyline.insert( mSkyline.begin() + best, top );
+
+	// cut away what the new node now covers
+	for( i = best + 1; i < mSkyline.size(); ){
+		int covered = top.x + top.width - mSkyline[i].x;
+		if( covered <= 0 ) break;
+		if( covered < mSkyline[i].width ){
+			mSkyline[i].x += covered;
+			mSkyline[i].width -= covered;
+			break;
+		}
+		mSkyline.erase( mSkyline.begin() + i );
+	}
+
+	// neighbours at the same height become one node
+	for( i = 0; i + 1 < mSkyline.size(); ){
+		if( mSkyline[i].y == mSkyline[i + 1].y ){
+			mSkyline[i].width += mSkyline[i + 1].width;
+			mSkyline.erase( mSkyline.begin() + i + 1 );
+		}
+		else i++;
+	}
+
+	out->x = top.x;
+	out->y = bestY;
+	out->w = w;
+	out->h = h;
+	mUsed += (long)w * h;
+	return true;
+}
+
+float SkylinePacker::occupancy() const {
+	if( mWidth <= 0 || mHeight <= 0 ) return 0.0f;
+	return (float)mUsed / ( (float)mWidth * mHeight );
+}
+
+/**
+-=-=-=-=-=- TextureAtlas -=-=-=-=-=-
+**/
+TextureAtlas::TextureAtlas( SDL_Renderer *ren, int pageSize, int padding, int align ){
+	mRenderer = ren;
+	mPageSize = pageSize;
+	mPadding = padding;
+	mAlign = align > 0 ? align : 1;
+}
+
+TextureAtlas::~TextureAtlas(){
+	clear();
+}
+
+void TextureAtlas::clear(){
+	for( unsigned int i = 0; i < mPages.size(); i++ )
+		SDL_DestroyTexture( mPages[i].tex );
+	mPages.clear();
+}
+
+bool TextureAtlas::newPage(){
+	Page page;
+	page.tex = SDL_CreateTexture( mRenderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, mPageSize, mPageSize );
+	if( page.tex == nullptr ){
+		std::cout << "SDL_CreateTexture failed for an atlas page: " << SDL_GetError() << std::endl;
+		return false;
+	}
+	SDL_SetTextureBlendMode( page.tex, SDL_BLENDMODE_BLEND );
+	page.packer.reset( mPageSize, mPageSize );
+	mPages.push_back( page );
+	return true;
+}
+
+atlas_region_t TextureAtlas::add( const std::string &file ){
+	atlas_region_t region;
+	SDL_Surface *image = IMG_Load( file.c_str() );
+	if( image == nullptr ){
+		std::cout << "IMG_Load failed: " << file.c_str() << std::endl;
+		region.page = NULL;
+		return region;
+	}
+	region = add( image );
+	SDL_FreeSurface( image );
+	return region;
+}
+
+/**
+-=-=-=-=-=-=- add -=-=-=-=-=-=-
+Find a slot, then upload the image with its edge-repeating border in one update
+**/
+atlas_region_t TextureAtlas::add( SDL_Surface *image ){
+	atlas_region_t region;
+	SDL_Rect slot;
+	unsigned int p;
+	int x, y;
+
+	region.page = NULL;
+	if( image == nullptr ) return region;
+	if( image->w <= 0 || image->h <= 0 ){
+		std::cout << "Empty image, nothing to add to the atlas" << std::endl;	// the border needs an edge to repeat
+		return region;
+	}
+
+	int w = image->w, h = image->h;
+	int slotW = ( w + 2 * mPadding + mAlign - 1 ) / mAlign * mAlign;
+	int slotH = ( h + 2 * mPadding + mAlign - 1 ) / mAlign * mAlign;
+	if( slotW > mPageSize || slotH > mPageSize ){
+		std::cout << "Image of " << w << "x" << h << " is too big for a " << mPageSize << " atlas page" << std::endl;
+		return region;
+	}
+
+	// earlier pages first, they are the fullest
+	for( p = 0; p < mPages.size(); p++ )
+		if( mPages[p].packer.insert( slotW, slotH, &slot ) ) break;
+	if( p == mPages.size() ){
+		if( !newPage() ) return region;
+		mPages[p].packer.insert( slotW, slotH, &slot );
+	}
+
+	SDL_Surface *rgba = SDL_ConvertSurfaceFormat( image, SDL_PIXELFORMAT_RGBA32, 0 );
+	if( rgba == nullptr ){
+		std::cout << "SDL_ConvertSurfaceFormat failed: " << SDL_GetError() << std::endl;
+		return region;
+	}
+
+	// the image in the middle, its outer rows and columns repeated out to the slot's edge
+	mScratch.resize( slotW * slotH );
+	SDL_LockSurface( rgba );
+	for( y = 0; y < slotH; y++ ){
+		int srcY = y - mPadding;
+		if( srcY < 0 ) srcY = 0;
+		if( srcY >= h ) srcY = h - 1;
+		const Uint32 *src = (const Uint32*)( (const Uint8*)rgba->pixels + srcY * rgba->pitch );
+		Uint32 *dst = &mScratch[y * slotW];
+
+		for( x = 0; x < mPadding; x++ ) dst[x] = src[0];
+		memcpy( dst + mPadding, src, w * sizeof( Uint32 ) );
+		for( x = mPadding + w; x < slotW; x++ ) dst[x] = src[w - 1];
+	}
+	SDL_UnlockSurface( rgba );
+	SDL_FreeSurface( rgba );
+
+	SDL_UpdateTexture( mPages[p].tex, &slot, &mScratch[0], slotW * sizeof( Uint32 ) );
+
+	region.page = mPages[p].tex;
+	region.rect.x = slot.x + mPadding;
+	region.rect.y = slot.y + mPadding;
+	region.rect.w = w;
+	region.rect.h = h;
+	region.uv.x = (float)region.rect.x / mPageSize;
+	region.uv.y = (float)region.rect.y / mPageSize;
+	region.uv.w = (float)w / mPageSize;
+	region.uv.h = (float)h / mPageSize;
+	return region;
+}
+
+unsigned int TextureAtlas::pages() const {
+	return mPages.size();
+}
+
+float TextureAtlas::occupancy() const {
+	if( mPages.empty() ) return 0.0f;
+	float sum = 0.0f;
+	for( unsigned int i = 0; i < mPages.size(); i++ )
+		sum += mPages[i].packer.occupancy();
+	return sum / mPages.size();
+}
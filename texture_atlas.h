@@ -0,0 +1,83 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <vector>
+#include <string>
+#include "SDL2\SDL.h"
+
+/**
+-=-=-=-=-=- SkylinePacker -=-=-=-=-=-
+Packs rectangles into a fixed area one at a time, so it works just as well while images
+stream in as it does for a whole set offline. The top edge of everything packed so far is
+kept as a skyline, each rectangle goes where its bottom ends lowest. Knows nothing about
+pixels.
+**/
+class SkylinePacker {
+public:
+	SkylinePacker( int width=0, int height=0 );
+
+	void reset( int width, int height );
+	bool insert( int w, int h, SDL_Rect *out );		// false when it no longer fits
+	float occupancy() const;						// 0..1 of the area
+
+private:
+	struct Node {
+		int x, y, width;
+	};
+
+	int fit( unsigned int node, int w, int h ) const;	// y the rectangle would sit at, -1 if it can't
+
+	std::vector<Node> mSkyline;
+	int mWidth, mHeight;
+	long mUsed;
+};
+
+/**
+-=-=-=-=-=- TextureAtlas -=-=-=-=-=-
+Copies images into a few large page textures, so sprites drawn from them share a texture
+and batch into one call. A new page is started when an image no longer fits the others.
+
+Every image is surrounded by 'padding' pixels repeating its edge, so filtering at the
+border never picks up a neighbour. Slots are also rounded up to multiples of 'align'
+pixels: with align = 2^n the first n halvings of a mipmapped page still keep the images
+apart.
+**/
+const int ATLAS_PAGE_SIZE = 1024;
+const int ATLAS_PADDING = 2;
+const int ATLAS_ALIGN = 4;
+
+typedef struct {
+	SDL_Texture *page;		// NULL when the image couldn't be added
+	SDL_Rect rect;			// in page pixels, for SDL_RenderCopy's src
+	SDL_FRect uv;			// the same in 0..1
+} atlas_region_t;
+
+class TextureAtlas {
+public:
+	TextureAtlas( SDL_Renderer *ren, int pageSize=ATLAS_PAGE_SIZE, int padding=ATLAS_PADDING, int align=ATLAS_ALIGN );
+	~TextureAtlas();
+	TextureAtlas( const TextureAtlas & ) = delete;		// owns its page textures
+	TextureAtlas &operator=( const TextureAtlas & ) = delete;
+
+	atlas_region_t add( SDL_Surface *image );		// the image is copied, the caller still owns it
+	atlas_region_t add( const std::string &file );
+
+	void clear();									// frees the pages, before their renderer goes
+	unsigned int pages() const;
+	float occupancy() const;						// averaged over all pages
+
+private:
+	struct Page {
+		SDL_Texture *tex;
+		SkylinePacker packer;
+	};
+
+	bool newPage();
+
+	SDL_Renderer *mRenderer;
+	std::vector<Page> mPages;
+	std::vector<Uint32> mScratch;					// one padded image on its way to a page
+	int mPageSize, mPadding, mAlign;
+};
+
+#endif